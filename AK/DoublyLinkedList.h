@@ -172,6 +172,27 @@ public:
         return AK::find(begin(), end(), value);
     }
 
+    template<typename U>
+    void insert_before(Iterator it, U&& value)
+    {
+        if (it.is_end()) {
+            append(forward<U>(value));
+            return;
+        }
+        auto* node = new Node(forward<U>(value));
+        auto* next = it.m_node;
+        node->next = next;
+        node->prev = next->prev;
+        if (next->prev) {
+            VERIFY(next != m_head);
+            next->prev->next = node;
+        } else {
+            VERIFY(next == m_head);
+            m_head = node;
+        }
+        next->prev = node;
+    }
+
     void remove(Iterator it)
     {
         VERIFY(it.m_node);
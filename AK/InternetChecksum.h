@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Endian.h>
+#include <AK/Span.h>
+#include <AK/Types.h>
+
+// The kernel doesn't preserve SSE state for its own code, so only userspace gets to use it.
+#if defined(__SSE2__) && !defined(KERNEL)
+#    define AK_INTERNET_CHECKSUM_USE_SSE2
+#    include <emmintrin.h>
+#endif
+
+namespace AK {
+
+// The one's complement checksum used by IPv4, ICMP, TCP and UDP (RFC 1071).
+//
+// The data is summed in host byte order, a machine word at a time, which gives the same result
+// as summing big-endian 16-bit words once the final value is byte swapped (RFC 1071 section 2).
+class InternetChecksum {
+public:
+    InternetChecksum() = default;
+
+    void add(ReadonlyBytes bytes)
+    {
+        u16 sum = fold(sum_words(bytes.data(), bytes.size()));
+        // A chunk that starts at an odd offset has all of its bytes in the other half of their
+        // 16-bit words, which amounts to swapping the bytes of its sum.
+        if (m_odd_length)
+            sum = (u16)((sum << 8) | (sum >> 8));
+        m_sum += sum;
+        m_odd_length ^= bytes.size() & 1;
+    }
+
+    void add(const void* data, size_t size) { add(ReadonlyBytes { (const u8*)data, size }); }
+
+    // Returns the checksum in host byte order, ready to be stored in a NetworkOrdered<u16>.
+    u16 finish() const
+    {
+        return convert_between_host_and_network_endian((u16)~fold(m_sum));
+    }
+
+    static u16 compute(ReadonlyBytes bytes)
+    {
+        InternetChecksum checksum;
+        checksum.add(bytes);
+        return checksum.finish();
+    }
+
+    // Incrementally updates a checksum after a 16-bit field it covers has changed from
+    // old_value to new_value (RFC 1624, equation 3). All values are in host byte order.
+    static constexpr u16 update_u16(u16 checksum, u16 old_value, u16 new_value)
+    {
+        u32 sum = (u16)~checksum + (u16)~old_value + new_value;
+        sum = (sum & 0xffff) + (sum >> 16);
+        sum = (sum & 0xffff) + (sum >> 16);
+        return (u16)~sum;
+    }
+
+    static constexpr u16 update_u32(u16 checksum, u32 old_value, u32 new_value)
+    {
+        checksum = update_u16(checksum, old_value >> 16, new_value >> 16);
+        return update_u16(checksum, old_value & 0xffff, new_value & 0xffff);
+    }
+
+private:
+    static constexpr u16 fold(u64 sum)
+    {
+        sum = (sum & 0xffffffff) + (sum >> 32);
+        sum = (sum & 0xffffffff) + (sum >> 32);
+        sum = (sum & 0xffff) + (sum >> 16);
+        sum = (sum & 0xffff) + (sum >> 16);
+        sum = (sum & 0xffff) + (sum >> 16);
+        return (u16)sum;
+    }
+
+    // Sums the data as 32-bit words into a 64-bit accumulator, so that carries never have to be
+    // folded inside the loop. Since 2^16 is congruent to 1 modulo 0xffff, this folds down to the
+    // same value as summing 16-bit words.
+    static u64 sum_words(const u8* data, size_t size)
+    {
+        u64 sum = 0;
+
+#ifdef AK_INTERNET_CHECKSUM_USE_SSE2
+        if (size >= 64) {
+            auto zero = _mm_setzero_si128();
+            auto accumulator = _mm_setzero_si128();
+            for (; size >= 16; data += 16, size -= 16) {
+                auto words = _mm_loadu_si128((const __m128i*)data);
+                accumulator = _mm_add_epi64(accumulator, _mm_unpacklo_epi32(words, zero));
+                accumulator = _mm_add_epi64(accumulator, _mm_unpackhi_epi32(words, zero));
+            }
+            alignas(16) u64 lanes[2];
+            _mm_store_si128((__m128i*)lanes, accumulator);
+            sum = fold(lanes[0]) + (u64)fold(lanes[1]);
+        }
+#endif
+
+        for (; size >= 16; data += 16, size -= 16) {
+            u32 words[4];
+            __builtin_memcpy(words, data, sizeof(words));
+            sum += (u64)words[0] + words[1] + words[2] + words[3];
+        }
+        for (; size >= 4; data += 4, size -= 4) {
+            u32 word;
+            __builtin_memcpy(&word, data, sizeof(word));
+            sum += word;
+        }
+        if (size >= 2) {
+            u16 word;
+            __builtin_memcpy(&word, data, sizeof(word));
+            sum += word;
+            data += 2;
+            size -= 2;
+        }
+        if (size) {
+            // The last byte is padded with a zero byte to form a whole 16-bit word.
+            u16 word = 0;
+            __builtin_memcpy(&word, data, 1);
+            sum += word;
+        }
+        return sum;
+    }
+
+    u64 m_sum { 0 };
+    bool m_odd_length { false };
+};
+
+}
+
+using AK::InternetChecksum;
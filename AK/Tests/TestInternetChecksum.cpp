@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/TestSuite.h>
+
+#include <AK/InternetChecksum.h>
+#include <AK/Vector.h>
+
+// Straight from RFC 1071: sums big-endian 16-bit words one at a time.
+static u16 reference_checksum(ReadonlyBytes bytes)
+{
+    u32 sum = 0;
+    size_t i = 0;
+    for (; i + 1 < bytes.size(); i += 2)
+        sum += (bytes[i] << 8) | bytes[i + 1];
+    if (i < bytes.size())
+        sum += bytes[i] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum & 0xffff;
+}
+
+static Vector<u8> make_data(size_t size)
+{
+    Vector<u8> data;
+    u32 state = 0x12345678;
+    for (size_t i = 0; i < size; ++i) {
+        state = state * 1103515245 + 12345;
+        data.append(state >> 24);
+    }
+    return data;
+}
+
+TEST_CASE(rfc1071_example)
+{
+    // The example from RFC 1071 section 3.
+    u8 data[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+    EXPECT_EQ(InternetChecksum::compute({ data, sizeof(data) }), (u16)~0xddf2);
+}
+
+TEST_CASE(matches_reference)
+{
+    auto data = make_data(4096);
+    for (size_t size = 0; size <= 300; ++size) {
+        for (size_t offset = 0; offset < 4; ++offset)
+            EXPECT_EQ(InternetChecksum::compute({ data.data() + offset, size }), reference_checksum({ data.data() + offset, size }));
+    }
+    EXPECT_EQ(InternetChecksum::compute(data.span()), reference_checksum(data.span()));
+}
+
+TEST_CASE(all_ones)
+{
+    Vector<u8> data;
+    data.resize(1500);
+    for (auto& byte : data)
+        byte = 0xff;
+    EXPECT_EQ(InternetChecksum::compute(data.span()), reference_checksum(data.span()));
+}
+
+TEST_CASE(chunked)
+{
+    auto data = make_data(1000);
+    for (size_t split = 0; split <= data.size(); split += 7) {
+        InternetChecksum checksum;
+        checksum.add(data.span().slice(0, split));
+        checksum.add(data.span().slice(split));
+        EXPECT_EQ(checksum.finish(), reference_checksum(data.span()));
+    }
+
+    InternetChecksum checksum;
+    for (size_t offset = 0; offset < data.size(); offset += 3)
+        checksum.add(data.span().slice(offset, min<size_t>(3, data.size() - offset)));
+    EXPECT_EQ(checksum.finish(), reference_checksum(data.span()));
+}
+
+TEST_CASE(incremental_update)
+{
+    auto data = make_data(40);
+    auto checksum = InternetChecksum::compute(data.span());
+
+    u16 old_word = (data[10] << 8) | data[11];
+    u16 new_word = 0xbeef;
+    data[10] = 0xbe;
+    data[11] = 0xef;
+    EXPECT_EQ(InternetChecksum::update_u16(checksum, old_word, new_word), reference_checksum(data.span()));
+    checksum = reference_checksum(data.span());
+
+    u32 old_dword = (data[20] << 24) | (data[21] << 16) | (data[22] << 8) | data[23];
+    u32 new_dword = 0xcafebabe;
+    data[20] = 0xca;
+    data[21] = 0xfe;
+    data[22] = 0xba;
+    data[23] = 0xbe;
+    EXPECT_EQ(InternetChecksum::update_u32(checksum, old_dword, new_dword), reference_checksum(data.span()));
+}
+
+BENCHMARK_CASE(checksum_full_sized_frames)
+{
+    auto data = make_data(1500);
+    u16 result = 0;
+    for (size_t i = 0; i < 1'000'000; ++i)
+        result ^= InternetChecksum::compute(data.span());
+    EXPECT_EQ(result, 0);
+}
+
+BENCHMARK_CASE(checksum_full_sized_frames_reference)
+{
+    auto data = make_data(1500);
+    u16 result = 0;
+    for (size_t i = 0; i < 1'000'000; ++i)
+        result ^= reference_checksum(data.span());
+    EXPECT_EQ(result, 0);
+}
+
+TEST_MAIN(InternetChecksum)
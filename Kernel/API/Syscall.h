@@ -37,6 +37,8 @@ constexpr int syscall_vector = 0x82;
 
 extern "C" {
 struct pollfd;
+struct epoll_event;
+struct iovec;
 struct timeval;
 struct timespec;
 struct sockaddr;
@@ -193,7 +195,13 @@ namespace Kernel {
     S(anon_create)            \
     S(msyscall)               \
     S(readv)                  \
-    S(emuctl)
+    S(emuctl)                 \
+    S(epoll_create)           \
+    S(epoll_ctl)              \
+    S(epoll_wait)             \
+    S(sendfile)               \
+    S(preadv)                 \
+    S(pwritev)
 
 namespace Syscall {
 
@@ -278,6 +286,42 @@ struct SC_poll_params {
     const u32* sigmask;
 };
 
+struct SC_epoll_ctl_params {
+    int epfd;
+    int op;
+    int fd;
+    struct epoll_event* event;
+};
+
+struct SC_epoll_wait_params {
+    int epfd;
+    struct epoll_event* events;
+    int maxevents;
+    const struct timespec* timeout;
+    const u32* sigmask;
+};
+
+struct SC_preadv_params {
+    int fd;
+    const struct iovec* iov;
+    int iov_count;
+    ssize_t offset;
+};
+
+struct SC_pwritev_params {
+    int fd;
+    const struct iovec* iov;
+    int iov_count;
+    ssize_t offset;
+};
+
+struct SC_sendfile_params {
+    int out_fd;
+    int in_fd;
+    ssize_t* offset;
+    size_t count;
+};
+
 struct SC_clock_nanosleep_params {
     int clock_id;
     int flags;
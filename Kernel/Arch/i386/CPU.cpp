@@ -1137,6 +1137,7 @@ UNMAP_AFTER_INIT void Processor::early_initialize(u32 cpu)
     m_scheduler_initialized = false;
 
     m_message_queue = nullptr;
+    m_active_cr3 = read_cr3();
     m_idle_thread = nullptr;
     m_current_thread = nullptr;
     m_scheduler_data = nullptr;
@@ -1379,7 +1380,7 @@ extern "C" void enter_thread_context(Thread* from_thread, Thread* to_thread)
     tls_descriptor.set_limit(to_thread->thread_specific_region_size());
 
     if (from_tss.cr3 != to_tss.cr3)
-        write_cr3(to_tss.cr3);
+        Processor::switch_page_directory(to_tss.cr3);
 
     to_thread->set_cpu(processor.get_id());
     processor.restore_in_critical(to_thread->saved_critical());
@@ -1789,6 +1790,10 @@ void Processor::check_invoke_scheduler()
 
 void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 {
+    if (page_count > full_tlb_flush_threshold) {
+        flush_entire_tlb_local();
+        return;
+    }
     auto ptr = vaddr.as_ptr();
     while (page_count > 0) {
         // clang-format off
@@ -1802,12 +1807,12 @@ void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
     }
 }
 
-void Processor::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
+u32 Processor::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
-    if (s_smp_enabled && (!is_user_address(vaddr) || Process::current()->thread_count() > 1))
-        smp_broadcast_flush_tlb(page_directory, vaddr, page_count);
-    else
-        flush_tlb_local(vaddr, page_count);
+    if (s_smp_enabled)
+        return smp_flush_tlb(page_directory, vaddr, page_count);
+    flush_tlb_local(vaddr, page_count);
+    return 0;
 }
 
 static volatile ProcessorMessage* s_message_pool;
@@ -2045,6 +2050,31 @@ void Processor::smp_broadcast_message(ProcessorMessage& msg)
         APIC::the().broadcast_ipi();
 }
 
+u32 Processor::smp_multicast_message(u32 cpu_mask, ProcessorMessage& msg)
+{
+    auto& cur_proc = Processor::current();
+    VERIFY(!(cpu_mask & (1u << cur_proc.get_id())));
+
+    dbgln_if(SMP_DEBUG, "SMP[{}]: Multicast message {} to cpu mask {:x} proc: {}", cur_proc.get_id(), VirtualAddress(&msg), cpu_mask, VirtualAddress(&cur_proc));
+
+    atomic_store(&msg.refs, (u32)__builtin_popcount(cpu_mask), AK::MemoryOrder::memory_order_release);
+    VERIFY(msg.refs > 0);
+    u32 ipi_count = 0;
+    for_each(
+        [&](Processor& proc) -> IterationDecision {
+            auto cpu = proc.get_id();
+            if (cpu_mask & (1u << cpu)) {
+                // Processors that already had messages queued will pick this one up without another IPI
+                if (proc.smp_queue_message(msg)) {
+                    APIC::the().send_ipi(cpu);
+                    ipi_count++;
+                }
+            }
+            return IterationDecision::Continue;
+        });
+    return ipi_count;
+}
+
 void Processor::smp_broadcast_wait_sync(ProcessorMessage& msg)
 {
     auto& cur_proc = Processor::current();
@@ -2137,19 +2167,50 @@ void Processor::smp_unicast(u32 cpu, void (*callback)(), bool async)
     smp_unicast_message(cpu, msg, async);
 }
 
-void Processor::smp_broadcast_flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
+u32 Processor::smp_flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
+    ScopedCritical critical;
+    auto& cur_proc = Processor::current();
+    bool is_user = is_user_address(vaddr);
+    auto cr3 = page_directory->cr3();
+
+    // Our page table updates must be visible before we look at which page directory the
+    // other processors have loaded: a processor that switches to this page directory after
+    // we looked will not have any stale entries for it.
+    full_memory_barrier();
+
+    // Kernel mappings are shared by all page directories, but user mappings can only be
+    // cached by processors that are running this page directory right now. Loading cr3
+    // flushes all of our (non-global) TLB entries, so processors that ran it in the past
+    // don't need to be bothered.
+    u32 cpu_mask = 0;
+    for_each(
+        [&](Processor& proc) -> IterationDecision {
+            if (&proc != &cur_proc && (!is_user || proc.m_active_cr3.load(AK::MemoryOrder::memory_order_relaxed) == cr3))
+                cpu_mask |= 1u << proc.get_id();
+            return IterationDecision::Continue;
+        });
+
+    bool flush_local = !is_user || read_cr3() == cr3;
+    if (!cpu_mask) {
+        if (flush_local)
+            flush_tlb_local(vaddr, page_count);
+        return 0;
+    }
+
     auto& msg = smp_get_from_pool();
     msg.async = false;
     msg.type = ProcessorMessage::FlushTlb;
     msg.flush_tlb.page_directory = page_directory;
     msg.flush_tlb.ptr = vaddr.as_ptr();
     msg.flush_tlb.page_count = page_count;
-    smp_broadcast_message(msg);
+    auto ipi_count = smp_multicast_message(cpu_mask, msg);
     // While the other processors handle this request, we'll flush ours
-    flush_tlb_local(vaddr, page_count);
+    if (flush_local)
+        flush_tlb_local(vaddr, page_count);
     // Now wait until everybody is done as well
     smp_broadcast_wait_sync(msg);
+    return ipi_count;
 }
 
 void Processor::smp_broadcast_halt()
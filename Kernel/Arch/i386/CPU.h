@@ -40,6 +40,7 @@
 #define PAGE_SIZE 4096
 #define GENERIC_INTERRUPT_HANDLERS_COUNT (256 - IRQ_VECTOR_BASE)
 #define PAGE_MASK ((FlatPtr)0xfffff000u)
+#define HUGE_PAGE_SIZE 0x200000
 
 namespace Kernel {
 
@@ -685,6 +686,7 @@ class Processor {
     Thread* m_idle_thread;
 
     volatile ProcessorMessageEntry* m_message_queue; // atomic, LIFO
+    Atomic<FlatPtr> m_active_cr3;
 
     bool m_invoke_scheduler_async;
     bool m_scheduler_initialized;
@@ -705,6 +707,7 @@ class Processor {
     bool smp_queue_message(ProcessorMessage& msg);
     static void smp_unicast_message(u32 cpu, ProcessorMessage& msg, bool async);
     static void smp_broadcast_message(ProcessorMessage& msg);
+    static u32 smp_multicast_message(u32 cpu_mask, ProcessorMessage& msg);
     static void smp_broadcast_wait_sync(ProcessorMessage& msg);
     static void smp_broadcast_halt();
 
@@ -755,8 +758,18 @@ public:
         write_cr3(read_cr3());
     }
 
+    // Flushing more pages than this with invlpg is slower than reloading cr3.
+    static constexpr size_t full_tlb_flush_threshold = 32;
+
     static void flush_tlb_local(VirtualAddress vaddr, size_t page_count);
-    static void flush_tlb(const PageDirectory*, VirtualAddress, size_t);
+    static u32 flush_tlb(const PageDirectory*, VirtualAddress, size_t);
+
+    // Loads a new page directory and lets TLB shootdowns know this processor now uses it.
+    ALWAYS_INLINE static void switch_page_directory(FlatPtr cr3)
+    {
+        current().m_active_cr3.store(cr3, AK::MemoryOrder::memory_order_seq_cst);
+        write_cr3(cr3);
+    }
 
     Descriptor& get_gdt_entry(u16 selector);
     void flush_gdt();
@@ -812,6 +825,11 @@ public:
         return *m_mm_data;
     }
 
+    ALWAYS_INLINE bool has_mm_data() const
+    {
+        return m_mm_data != nullptr;
+    }
+
     ALWAYS_INLINE Thread* idle_thread() const
     {
         return m_idle_thread;
@@ -981,7 +999,7 @@ public:
     }
     static void smp_unicast(u32 cpu, void (*callback)(), bool async);
     static void smp_unicast(u32 cpu, void (*callback)(void*), void* data, void (*free_data)(void*), bool async);
-    static void smp_broadcast_flush_tlb(const PageDirectory*, VirtualAddress, size_t);
+    static u32 smp_flush_tlb(const PageDirectory*, VirtualAddress, size_t);
     static u32 smp_wake_n_idle_processors(u32 wake_count);
 
     template<typename Callback>
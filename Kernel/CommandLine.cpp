@@ -128,6 +128,15 @@ UNMAP_AFTER_INIT String CommandLine::root_device() const
     return lookup("root").value_or("/dev/hda");
 }
 
+UNMAP_AFTER_INIT size_t CommandLine::fault_around_pages() const
+{
+    // The window is aligned to its own size, so it has to be a power of two.
+    auto value = lookup("fault_around").value_or("16").to_uint().value_or(16);
+    if (value < 1 || value > 32 || (value & (value - 1)))
+        return 16;
+    return value;
+}
+
 UNMAP_AFTER_INIT AcpiFeatureLevel CommandLine::acpi_feature_level() const
 {
     auto value = kernel_command_line().lookup("acpi").value_or("on");
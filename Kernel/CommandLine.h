@@ -75,6 +75,7 @@ public:
     [[nodiscard]] String userspace_init() const;
     [[nodiscard]] Vector<String> userspace_init_args() const;
     [[nodiscard]] String root_device() const;
+    [[nodiscard]] size_t fault_around_pages() const;
 
 private:
     CommandLine(const String&);
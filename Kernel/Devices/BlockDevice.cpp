@@ -25,6 +25,7 @@
  */
 
 #include <Kernel/Devices/BlockDevice.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
@@ -36,6 +37,7 @@ AsyncBlockDeviceRequest::AsyncBlockDeviceRequest(Device& block_device, RequestTy
     , m_block_count(block_count)
     , m_buffer(buffer)
     , m_buffer_size(buffer_size)
+    , m_queued_at(TimeManagement::the().monotonic_time(TimePrecision::Precise))
 {
 }
 
@@ -48,6 +50,61 @@ BlockDevice::~BlockDevice()
 {
 }
 
+bool BlockDevice::queue_request(NonnullRefPtr<AsyncDeviceRequest> request)
+{
+    auto& block_request = static_cast<AsyncBlockDeviceRequest&>(*request);
+
+    ScopedSpinLock lock(m_requests_lock);
+    auto& statistics = m_request_queue_statistics;
+    statistics.max_depth = max(statistics.max_depth, ++statistics.depth);
+
+    if (m_requests.is_empty()) {
+        m_requests.append(move(request));
+        return true;
+    }
+
+    // Keep pending requests sorted in a single sweep across the disk (C-LOOK), starting
+    // at the request in flight: first everything at or after it in ascending order,
+    // then wrap around to the lowest block.
+    auto head = static_cast<const AsyncBlockDeviceRequest&>(*m_requests.first()).block_index();
+    auto sweep_position = [head](const AsyncBlockDeviceRequest& request) -> u64 {
+        return ((u64)(request.block_index() < head) << 32) | request.block_index();
+    };
+    auto new_position = sweep_position(block_request);
+    auto it = m_requests.begin();
+    for (++it; it != m_requests.end(); ++it) {
+        if (new_position < sweep_position(static_cast<const AsyncBlockDeviceRequest&>(**it)))
+            break;
+    }
+    m_requests.insert_before(it, move(request));
+    return false;
+}
+
+void BlockDevice::did_complete_request(const AsyncDeviceRequest& request)
+{
+    VERIFY(m_requests_lock.is_locked());
+    auto& block_request = static_cast<const AsyncBlockDeviceRequest&>(request);
+    auto latency = TimeManagement::the().monotonic_time(TimePrecision::Precise) - block_request.queued_at();
+    auto latency_us = (u64)max(latency.to_microseconds(), (i64)0);
+
+    auto& statistics = m_request_queue_statistics;
+    VERIFY(statistics.depth > 0);
+    --statistics.depth;
+    ++statistics.completed_request_count;
+    statistics.total_latency_us += latency_us;
+
+    size_t bucket = 0;
+    while (bucket < RequestQueueStatistics::latency_histogram_bucket_count - 1 && latency_us >= RequestQueueStatistics::latency_histogram_bucket_limit_us(bucket))
+        ++bucket;
+    ++statistics.latency_histogram[bucket];
+}
+
+BlockDevice::RequestQueueStatistics BlockDevice::request_queue_statistics() const
+{
+    ScopedSpinLock lock(m_requests_lock);
+    return m_request_queue_statistics;
+}
+
 bool BlockDevice::read_block(unsigned index, UserOrKernelBuffer& buffer)
 {
     auto read_request = make_request<AsyncBlockDeviceRequest>(AsyncBlockDeviceRequest::Read, index, 1, buffer, 512);
@@ -26,6 +26,8 @@
 
 #pragma once
 
+#include <AK/Array.h>
+#include <AK/Time.h>
 #include <Kernel/Devices/Device.h>
 
 namespace Kernel {
@@ -47,6 +49,7 @@ public:
     UserOrKernelBuffer& buffer() { return m_buffer; }
     const UserOrKernelBuffer& buffer() const { return m_buffer; }
     size_t buffer_size() const { return m_buffer_size; }
+    Time queued_at() const { return m_queued_at; }
 
     virtual void start() override;
     virtual const char* name() const override
@@ -68,6 +71,7 @@ private:
     const u32 m_block_count;
     UserOrKernelBuffer m_buffer;
     const size_t m_buffer_size;
+    const Time m_queued_at;
 };
 
 class BlockDevice : public Device {
@@ -82,6 +86,20 @@ public:
 
     virtual void start_request(AsyncBlockDeviceRequest&) = 0;
 
+    struct RequestQueueStatistics {
+        // Bucket i counts requests that completed in less than 2^(i + 6) microseconds,
+        // the last bucket counts everything slower than that.
+        static constexpr size_t latency_histogram_bucket_count = 16;
+        static u64 latency_histogram_bucket_limit_us(size_t bucket) { return 64ull << bucket; }
+
+        u32 depth { 0 };
+        u32 max_depth { 0 };
+        u64 completed_request_count { 0 };
+        u64 total_latency_us { 0 };
+        Array<u64, latency_histogram_bucket_count> latency_histogram {};
+    };
+    RequestQueueStatistics request_queue_statistics() const;
+
 protected:
     BlockDevice(unsigned major, unsigned minor, size_t block_size = PAGE_SIZE)
         : Device(major, minor)
@@ -89,10 +107,15 @@ protected:
     {
     }
 
+    // ^Device
+    virtual bool queue_request(NonnullRefPtr<AsyncDeviceRequest>) override;
+    virtual void did_complete_request(const AsyncDeviceRequest&) override;
+
 private:
     virtual bool is_block_device() const final { return true; }
 
     size_t m_block_size { 0 };
+    RequestQueueStatistics m_request_queue_statistics;
 };
 
 }
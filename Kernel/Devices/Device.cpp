@@ -80,21 +80,30 @@ String Device::absolute_path(const FileDescription&) const
     return absolute_path();
 }
 
+bool Device::queue_request(NonnullRefPtr<AsyncDeviceRequest> request)
+{
+    ScopedSpinLock lock(m_requests_lock);
+    bool was_empty = m_requests.is_empty();
+    m_requests.append(move(request));
+    return was_empty;
+}
+
 void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest& completed_request)
 {
-    AsyncDeviceRequest* next_request = nullptr;
+    RefPtr<AsyncDeviceRequest> next_request;
 
     {
         ScopedSpinLock lock(m_requests_lock);
         VERIFY(!m_requests.is_empty());
         VERIFY(m_requests.first().ptr() == &completed_request);
         m_requests.remove(m_requests.begin());
+        did_complete_request(completed_request);
         if (!m_requests.is_empty())
-            next_request = m_requests.first().ptr();
+            next_request = m_requests.first();
     }
 
     if (next_request)
-        next_request->start();
+        next_request->do_start({});
 
     evaluate_block_conditions();
 }
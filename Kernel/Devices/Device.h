@@ -72,13 +72,7 @@ public:
     NonnullRefPtr<AsyncRequestType> make_request(Args&&... args)
     {
         auto request = adopt(*new AsyncRequestType(*this, forward<Args>(args)...));
-        bool was_empty;
-        {
-            ScopedSpinLock lock(m_requests_lock);
-            was_empty = m_requests.is_empty();
-            m_requests.append(request);
-        }
-        if (was_empty)
+        if (queue_request(request))
             request->do_start({});
         return request;
     }
@@ -88,6 +82,12 @@ protected:
     void set_uid(uid_t uid) { m_uid = uid; }
     void set_gid(gid_t gid) { m_gid = gid; }
 
+    // Adds a request to the queue and returns whether it should be started right away.
+    // The first request in m_requests is always the one in flight.
+    virtual bool queue_request(NonnullRefPtr<AsyncDeviceRequest>);
+    // Called with m_requests_lock held, after a completed request has been removed from the queue.
+    virtual void did_complete_request(const AsyncDeviceRequest&) { }
+
     static HashMap<u32, Device*>& all_devices();
 
 private:
@@ -96,7 +96,8 @@ private:
     uid_t m_uid { 0 };
     gid_t m_gid { 0 };
 
-    SpinLock<u8> m_requests_lock;
+protected:
+    mutable SpinLock<u8> m_requests_lock;
     DoublyLinkedList<RefPtr<AsyncDeviceRequest>> m_requests;
 };
 
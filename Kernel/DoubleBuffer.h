@@ -53,6 +53,7 @@ public:
     bool is_empty() const { return m_empty; }
 
     size_t space_for_writing() const { return m_space_for_writing; }
+    size_t capacity() const { return m_capacity; }
 
     void set_unblock_callback(Function<void()> callback)
     {
@@ -25,9 +25,12 @@
  */
 
 #include <AK/IntrusiveList.h>
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/QuickSort.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/Process.h>
+#include <Kernel/VM/MemoryManager.h>
 
 namespace Kernel {
 
@@ -36,41 +39,59 @@ struct CacheEntry {
     BlockBasedFS::BlockIndex block_index { 0 };
     u8* data { nullptr };
     bool has_data { false };
+    bool is_in_use { false };
+    bool is_dirty { false };
+};
+
+// The cache grows in segments of roughly this many bytes of block data.
+static constexpr size_t disk_cache_segment_size = 1 * MiB;
+
+struct DiskCacheSegment {
+    NonnullOwnPtr<KBuffer> cached_block_data;
+    NonnullOwnPtr<KBuffer> entries;
+    size_t entry_count { 0 };
+
+    CacheEntry& entry(size_t index) { return ((CacheEntry*)entries->data())[index]; }
 };
 
 class DiskCache {
 public:
     explicit DiskCache(BlockBasedFS& fs)
         : m_fs(fs)
-        , m_cached_block_data(KBuffer::create_with_size(m_entry_count * m_fs.block_size()))
-        , m_entries(KBuffer::create_with_size(m_entry_count * sizeof(CacheEntry)))
+        , m_entries_per_segment(max(disk_cache_segment_size / fs.block_size(), (size_t)64))
     {
-        for (size_t i = 0; i < m_entry_count; ++i) {
-            entries()[i].data = m_cached_block_data.data() + i * m_fs.block_size();
-            m_clean_list.append(entries()[i]);
-        }
+        bool did_grow = grow();
+        VERIFY(did_grow);
     }
 
-    ~DiskCache() = default;
+    ~DiskCache()
+    {
+        m_clean_list.clear();
+        m_dirty_list.clear();
+    }
 
     bool is_dirty() const { return m_dirty; }
     void set_dirty(bool b) { m_dirty = b; }
 
     void mark_all_clean()
     {
-        while (auto* entry = m_dirty_list.first())
+        while (auto* entry = m_dirty_list.first()) {
+            entry->is_dirty = false;
             m_clean_list.prepend(*entry);
+        }
         m_dirty = false;
     }
 
     void mark_dirty(CacheEntry& entry)
     {
+        entry.is_dirty = true;
         m_dirty_list.prepend(entry);
         m_dirty = true;
     }
 
     void mark_clean(CacheEntry& entry)
     {
+        entry.is_dirty = false;
         m_clean_list.prepend(entry);
     }
 
@@ -79,9 +100,19 @@ public:
         if (auto it = m_hash.find(block_index); it != m_hash.end()) {
             auto& entry = const_cast<CacheEntry&>(*it->value);
             VERIFY(entry.block_index == block_index);
+            ++m_statistics.hits;
+            // Keep the clean list in LRU order so that eviction picks the coldest block.
+            if (!entry.is_dirty)
+                m_clean_list.prepend(entry);
             return entry;
         }
 
+        // Unused entries sit at the tail of the clean list. If the tail holds a live block,
+        // the cache is full and we'd rather grow it than evict while memory is plentiful.
+        auto* candidate = m_clean_list.last();
+        if (!candidate || candidate->is_in_use)
+            const_cast<DiskCache&>(*this).try_grow();
+
         if (m_clean_list.is_empty()) {
             // Not a single clean entry! Flush writes and try again.
             // NOTE: We want to make sure we only call FileBackedFS flush here,
@@ -90,21 +121,32 @@ public:
             return get(block_index);
         }
 
+        ++m_statistics.misses;
+
         VERIFY(m_clean_list.last());
         auto& new_entry = *m_clean_list.last();
         m_clean_list.prepend(new_entry);
 
-        m_hash.remove(new_entry.block_index);
+        if (new_entry.is_in_use) {
+            m_hash.remove(new_entry.block_index);
+            ++m_statistics.evictions;
+        }
         m_hash.set(block_index, &new_entry);
 
         new_entry.block_index = block_index;
         new_entry.has_data = false;
+        new_entry.is_in_use = true;
 
         return new_entry;
     }
 
-    const CacheEntry* entries() const { return (const CacheEntry*)m_entries.data(); }
-    CacheEntry* entries() { return (CacheEntry*)m_entries.data(); }
+    CacheEntry* find(BlockBasedFS::BlockIndex block_index) const
+    {
+        auto it = m_hash.find(block_index);
+        if (it == m_hash.end())
+            return nullptr;
+        return it->value;
+    }
 
     template<typename Callback>
     void for_each_dirty_entry(Callback callback)
@@ -113,14 +155,100 @@ public:
             callback(entry);
     }
 
+    // Give back segments while the system is short on memory. Only whole segments
+    // without dirty entries can be released, so this is best called right after a flush.
+    void shrink_if_under_memory_pressure()
+    {
+        while (m_segments.size() > 1 && is_under_memory_pressure()) {
+            if (!release_last_segment())
+                break;
+        }
+    }
+
+    BlockBasedFS::CacheStatistics statistics() const
+    {
+        auto statistics = m_statistics;
+        statistics.entry_count = m_entry_count;
+        statistics.segment_count = m_segments.size();
+        return statistics;
+    }
+
 private:
+    static size_t total_memory_pages() { return MM.user_physical_pages(); }
+    static size_t free_memory_pages() { return MM.user_physical_pages() - MM.user_physical_pages_used(); }
+
+    static bool is_under_memory_pressure()
+    {
+        return free_memory_pages() < total_memory_pages() / 16;
+    }
+
+    size_t segment_size_in_pages() const
+    {
+        return page_round_up(m_entries_per_segment * m_fs.block_size()) / PAGE_SIZE;
+    }
+
+    void try_grow()
+    {
+        // Never let the cache take more than a quarter of memory, and stop growing
+        // well before the system starts running low.
+        auto segment_pages = segment_size_in_pages();
+        if ((m_segments.size() + 1) * segment_pages > total_memory_pages() / 4)
+            return;
+        if (free_memory_pages() < total_memory_pages() / 8 + segment_pages)
+            return;
+        grow();
+    }
+
+    bool grow()
+    {
+        auto cached_block_data = KBuffer::try_create_with_size(m_entries_per_segment * m_fs.block_size(), Region::Access::Read | Region::Access::Write, "Disk cache");
+        if (!cached_block_data)
+            return false;
+        auto entries = KBuffer::try_create_with_size(m_entries_per_segment * sizeof(CacheEntry), Region::Access::Read | Region::Access::Write, "Disk cache entries");
+        if (!entries)
+            return false;
+
+        auto segment = adopt_own(*new DiskCacheSegment { cached_block_data.release_nonnull(), entries.release_nonnull(), m_entries_per_segment });
+        for (size_t i = 0; i < segment->entry_count; ++i) {
+            auto& entry = *new (&segment->entry(i)) CacheEntry;
+            entry.data = segment->cached_block_data->data() + i * m_fs.block_size();
+            m_clean_list.append(entry);
+        }
+        m_entry_count += segment->entry_count;
+        m_segments.append(move(segment));
+        ++m_statistics.grow_count;
+        dbgln_if(BBFS_DEBUG, "{}: Disk cache grew to {} entries", m_fs.class_name(), m_entry_count);
+        return true;
+    }
+
+    bool release_last_segment()
+    {
+        auto& segment = m_segments.last();
+        for (size_t i = 0; i < segment.entry_count; ++i) {
+            if (segment.entry(i).is_dirty)
+                return false;
+        }
+        for (size_t i = 0; i < segment.entry_count; ++i) {
+            auto& entry = segment.entry(i);
+            if (entry.is_in_use)
+                m_hash.remove(entry.block_index);
+            m_clean_list.remove(entry);
+        }
+        m_entry_count -= segment.entry_count;
+        m_segments.take_last();
+        ++m_statistics.shrink_count;
+        dbgln_if(BBFS_DEBUG, "{}: Disk cache shrank to {} entries", m_fs.class_name(), m_entry_count);
+        return true;
+    }
+
     BlockBasedFS& m_fs;
-    size_t m_entry_count { 10000 };
+    size_t m_entries_per_segment { 0 };
+    size_t m_entry_count { 0 };
+    NonnullOwnPtrVector<DiskCacheSegment> m_segments;
     mutable HashMap<BlockBasedFS::BlockIndex, CacheEntry*> m_hash;
     mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_clean_list;
     mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_dirty_list;
-    KBuffer m_cached_block_data;
-    KBuffer m_entries;
+    mutable BlockBasedFS::CacheStatistics m_statistics;
     bool m_dirty { false };
 };
 
@@ -268,6 +396,11 @@ KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernel
         return EINVAL;
     if (count == 1)
         return read_block(index, &buffer, block_size(), 0, allow_cache);
+    if (allow_cache) {
+        auto result = prefetch_blocks(index, count);
+        if (result.is_error())
+            return result;
+    }
     auto out = buffer;
     for (unsigned i = 0; i < count; ++i) {
         auto result = read_block(BlockIndex { index.value() + i }, &out, block_size(), 0, allow_cache);
@@ -279,6 +412,91 @@ KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernel
     return KSuccess;
 }
 
+// Storage devices may complete only part of a large request, so keep going until all of it is transferred.
+KResult BlockBasedFS::read_from_device(BlockIndex index, UserOrKernelBuffer& buffer, size_t size) const
+{
+    file_description().seek(index.value() * block_size(), SEEK_SET);
+    size_t nread = 0;
+    while (nread < size) {
+        auto remaining_buffer = buffer.offset(nread);
+        auto result = file_description().read(remaining_buffer, size - nread);
+        if (result.is_error())
+            return result.error();
+        if (!result.value())
+            return EIO;
+        nread += result.value();
+    }
+    return KSuccess;
+}
+
+KResult BlockBasedFS::write_to_device(BlockIndex index, const UserOrKernelBuffer& buffer, size_t size)
+{
+    file_description().seek(index.value() * block_size(), SEEK_SET);
+    size_t nwritten = 0;
+    while (nwritten < size) {
+        auto result = file_description().write(buffer.offset(nwritten), size - nwritten);
+        if (result.is_error())
+            return result.error();
+        if (!result.value())
+            return EIO;
+        nwritten += result.value();
+    }
+    return KSuccess;
+}
+
+KBuffer* BlockBasedFS::cluster_buffer(OwnPtr<KBuffer>& buffer) const
+{
+    if (!buffer)
+        buffer = KBuffer::try_create_with_size(max_cluster_size, Region::Access::Read | Region::Access::Write, "BlockBasedFS cluster");
+    return buffer.ptr();
+}
+
+KResult BlockBasedFS::prefetch_blocks(BlockIndex index, unsigned count) const
+{
+    LOCKER(m_lock);
+    VERIFY(m_logical_block_size);
+
+    auto is_cached = [&](unsigned i) {
+        auto* entry = cache().find(BlockIndex { index.value() + i });
+        return entry && entry->has_data;
+    };
+
+    // Without a cluster buffer, read_block() will simply fetch the blocks one at a time.
+    auto* cluster = cluster_buffer(m_read_cluster_buffer);
+    if (!cluster)
+        return KSuccess;
+
+    size_t max_blocks_per_request = max_cluster_size / block_size();
+    unsigned i = 0;
+    while (i < count) {
+        if (is_cached(i)) {
+            ++i;
+            continue;
+        }
+
+        // Read the whole run of missing blocks with a single device request.
+        unsigned run_length = 1;
+        while (i + run_length < count && run_length < max_blocks_per_request && !is_cached(i + run_length))
+            ++run_length;
+
+        dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::prefetch_blocks {}, count={}", index.value() + i, run_length);
+        auto cluster_data_buffer = UserOrKernelBuffer::for_kernel_buffer(cluster->data());
+        auto result = read_from_device(BlockIndex { index.value() + i }, cluster_data_buffer, run_length * block_size());
+        if (result.is_error())
+            return result;
+
+        for (unsigned j = 0; j < run_length; ++j) {
+            auto& entry = cache().get(BlockIndex { index.value() + i + j });
+            if (entry.has_data)
+                continue;
+            memcpy(entry.data, cluster->data() + j * block_size(), block_size());
+            entry.has_data = true;
+        }
+        i += run_length;
+    }
+    return KSuccess;
+}
+
 void BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
 {
     LOCKER(m_lock);
@@ -304,19 +522,46 @@ void BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
 void BlockBasedFS::flush_writes_impl()
 {
     LOCKER(m_lock);
-    if (!cache().is_dirty())
+    if (!cache().is_dirty()) {
+        cache().shrink_if_under_memory_pressure();
         return;
-    u32 count = 0;
+    }
+    Vector<CacheEntry*, 32> dirty_entries;
     cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        u32 base_offset = entry.block_index.value() * block_size();
-        file_description().seek(base_offset, SEEK_SET);
-        // FIXME: Should this error path be surfaced somehow?
-        auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-        ++count;
+        dirty_entries.append(&entry);
     });
+    quick_sort(dirty_entries, [](auto* a, auto* b) { return a->block_index < b->block_index; });
+
+    // Coalesce runs of adjacent dirty blocks into single device requests.
+    size_t max_blocks_per_request = max_cluster_size / block_size();
+    u32 request_count = 0;
+    for (size_t i = 0; i < dirty_entries.size();) {
+        size_t run_length = 1;
+        while (i + run_length < dirty_entries.size() && run_length < max_blocks_per_request
+            && dirty_entries[i + run_length]->block_index.value() == dirty_entries[i]->block_index.value() + run_length)
+            ++run_length;
+
+        u8* data = dirty_entries[i]->data;
+        if (run_length > 1) {
+            auto* cluster = cluster_buffer(m_write_cluster_buffer);
+            if (!cluster)
+                run_length = 1;
+        }
+        if (run_length > 1) {
+            data = m_write_cluster_buffer->data();
+            for (size_t j = 0; j < run_length; ++j)
+                memcpy(data + j * block_size(), dirty_entries[i + j]->data, block_size());
+        }
+
+        // FIXME: Should this error path be surfaced somehow?
+        auto data_buffer = UserOrKernelBuffer::for_kernel_buffer(data);
+        [[maybe_unused]] auto rc = write_to_device(dirty_entries[i]->block_index, data_buffer, run_length * block_size());
+        ++request_count;
+        i += run_length;
+    }
     cache().mark_all_clean();
-    dbgln("{}: Flushed {} blocks to disk", class_name(), count);
+    cache().shrink_if_under_memory_pressure();
+    dbgln("{}: Flushed {} blocks to disk in {} requests", class_name(), dirty_entries.size(), request_count);
 }
 
 void BlockBasedFS::flush_writes()
@@ -324,6 +569,14 @@ void BlockBasedFS::flush_writes()
     flush_writes_impl();
 }
 
+BlockBasedFS::CacheStatistics BlockBasedFS::cache_statistics() const
+{
+    LOCKER(m_lock);
+    if (!m_cache)
+        return {};
+    return m_cache->statistics();
+}
+
 DiskCache& BlockBasedFS::cache() const
 {
     if (!m_cache)
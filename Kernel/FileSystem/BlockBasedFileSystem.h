@@ -36,6 +36,19 @@ public:
 
     virtual ~BlockBasedFS() override;
 
+    virtual bool is_block_based() const override { return true; }
+
+    struct CacheStatistics {
+        size_t entry_count { 0 };
+        size_t segment_count { 0 };
+        size_t hits { 0 };
+        size_t misses { 0 };
+        size_t evictions { 0 };
+        size_t grow_count { 0 };
+        size_t shrink_count { 0 };
+    };
+    CacheStatistics cache_statistics() const;
+
     size_t logical_block_size() const { return m_logical_block_size; };
 
     virtual void flush_writes() override;
@@ -53,16 +66,26 @@ protected:
     bool raw_read_blocks(BlockIndex index, size_t count, UserOrKernelBuffer&);
     bool raw_write_blocks(BlockIndex index, size_t count, const UserOrKernelBuffer&);
 
+    KResult prefetch_blocks(BlockIndex, unsigned count) const;
+
     KResult write_block(BlockIndex, const UserOrKernelBuffer&, size_t count, size_t offset = 0, bool allow_cache = true);
     KResult write_blocks(BlockIndex, unsigned count, const UserOrKernelBuffer&, bool allow_cache = true);
 
     size_t m_logical_block_size { 512 };
 
 private:
+    // Multi-block device requests are staged through buffers of this size.
+    static constexpr size_t max_cluster_size = 64 * KiB;
+
     DiskCache& cache() const;
+    KBuffer* cluster_buffer(OwnPtr<KBuffer>&) const;
+    KResult read_from_device(BlockIndex, UserOrKernelBuffer&, size_t size) const;
+    KResult write_to_device(BlockIndex, const UserOrKernelBuffer&, size_t size);
     void flush_specific_block_if_needed(BlockIndex index);
 
     mutable OwnPtr<DiskCache> m_cache;
+    mutable OwnPtr<KBuffer> m_read_cluster_buffer;
+    mutable OwnPtr<KBuffer> m_write_cluster_buffer;
 };
 
 }
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/EventPoll.h>
+#include <Kernel/FileSystem/FileDescription.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+static BlockFlags block_flags_for_events(u32 events)
+{
+    BlockFlags block_flags = BlockFlags::Exception; // always want EPOLLERR, EPOLLHUP
+    if (events & EPOLLIN)
+        block_flags |= BlockFlags::Read;
+    if (events & EPOLLOUT)
+        block_flags |= BlockFlags::Write;
+    if (events & EPOLLPRI)
+        block_flags |= BlockFlags::ReadPriority;
+    return block_flags;
+}
+
+static u32 events_for_unblocked_flags(BlockFlags unblocked_flags)
+{
+    u32 events = 0;
+    if (has_flag(unblocked_flags, BlockFlags::ReadHangUp))
+        events |= EPOLLRDHUP;
+    if (has_flag(unblocked_flags, BlockFlags::WriteError))
+        events |= EPOLLERR;
+    if (has_flag(unblocked_flags, BlockFlags::WriteHangUp))
+        events |= EPOLLHUP;
+    if (has_flag(unblocked_flags, BlockFlags::Read))
+        events |= EPOLLIN;
+    if (has_flag(unblocked_flags, BlockFlags::ReadPriority))
+        events |= EPOLLPRI;
+    if (has_flag(unblocked_flags, BlockFlags::Write))
+        events |= EPOLLOUT;
+    return events;
+}
+
+EventPoll::Entry::Entry(EventPoll& event_poll, int fd, FileDescription& description, const epoll_event& event)
+    : m_event_poll(event_poll)
+    , m_fd(fd)
+    , m_file(&description.file())
+    , m_description(description)
+{
+    set_interest(event);
+}
+
+void EventPoll::Entry::set_interest(const epoll_event& event)
+{
+    m_events = event.events;
+    m_data = event.data.u64;
+    m_block_flags = block_flags_for_events(event.events);
+}
+
+void EventPoll::Entry::register_with_file()
+{
+    ScopedSpinLock lock(m_file_lock);
+    if (m_file)
+        m_file->block_condition().add_blocker(*this, nullptr);
+}
+
+void EventPoll::Entry::reregister_with_file()
+{
+    ScopedSpinLock lock(m_file_lock);
+    if (!m_file)
+        return;
+    m_file->block_condition().remove_blocker(*this, nullptr);
+    m_file->block_condition().add_blocker(*this, nullptr);
+}
+
+void EventPoll::Entry::unregister_from_file()
+{
+    ScopedSpinLock lock(m_file_lock);
+    if (!m_file)
+        return;
+    m_file->block_condition().remove_blocker(*this, nullptr);
+    m_file = nullptr;
+}
+
+void EventPoll::Entry::description_will_close(Badge<FileDescription>)
+{
+    // Holding m_file_lock keeps the EventPoll from finishing its destructor
+    // while we're still talking to it.
+    ScopedSpinLock lock(m_file_lock);
+    if (!m_file)
+        return;
+    m_file->block_condition().remove_blocker(*this, nullptr);
+    m_file = nullptr;
+    m_event_poll.did_close(*this);
+}
+
+bool EventPoll::Entry::unblock(bool, void*)
+{
+    // We're called with the file's block condition lock held, so all we do
+    // here is queue ourselves. Returning false keeps us registered.
+    m_event_poll.did_notify(*this);
+    return false;
+}
+
+NonnullRefPtr<EventPoll> EventPoll::create()
+{
+    return adopt(*new EventPoll);
+}
+
+EventPoll::EventPoll()
+{
+}
+
+EventPoll::~EventPoll()
+{
+    for (auto& it : m_entries)
+        it.value->unregister_from_file();
+}
+
+void EventPoll::did_notify(Entry& entry)
+{
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        if (entry.is_queued || !entry.is_armed || !entry.is_registered)
+            return;
+        entry.is_queued = true;
+        m_ready_entries.append(entry);
+    }
+    evaluate_block_conditions();
+}
+
+void EventPoll::did_close(Entry& entry)
+{
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        // Queue even disarmed entries, collect_ready_events() is where they're removed.
+        if (entry.is_queued || !entry.is_registered)
+            return;
+        entry.is_queued = true;
+        m_ready_entries.append(entry);
+    }
+    evaluate_block_conditions();
+}
+
+void EventPoll::queue_ready_entries(NonnullRefPtrVector<Entry>& entries)
+{
+    if (entries.is_empty())
+        return;
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        for (auto& entry : entries) {
+            if (entry.is_queued || !entry.is_registered)
+                continue;
+            entry.is_queued = true;
+            m_ready_entries.append(entry);
+        }
+    }
+    evaluate_block_conditions();
+}
+
+void EventPoll::unregister_entry(Entry& entry)
+{
+    VERIFY(m_lock.is_locked());
+    entry.unregister_from_file();
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        entry.is_registered = false;
+    }
+    m_entries.remove(entry.fd());
+}
+
+KResult EventPoll::add(int fd, FileDescription& description, const epoll_event& event)
+{
+    LOCKER(m_lock);
+    if (auto it = m_entries.find(fd); it != m_entries.end()) {
+        // A stale entry for a closed (and possibly reused) fd number can simply be replaced.
+        if (it->value->is_for(description))
+            return EEXIST;
+        unregister_entry(*it->value);
+    }
+
+    auto entry = adopt(*new Entry(*this, fd, description, event));
+    m_entries.set(fd, entry);
+    description.did_add_to_event_poll({}, entry);
+    // Adding the blocker immediately evaluates the current state, which queues the entry if the file is ready.
+    entry->register_with_file();
+    dbgln_if(EPOLL_DEBUG, "EventPoll({}): Added fd {} with events {:#x}", this, fd, event.events);
+    return KSuccess;
+}
+
+KResult EventPoll::modify(int fd, FileDescription& description, const epoll_event& event)
+{
+    LOCKER(m_lock);
+    auto it = m_entries.find(fd);
+    if (it == m_entries.end() || !it->value->is_for(description))
+        return ENOENT;
+
+    auto& entry = *it->value;
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        entry.set_interest(event);
+        entry.is_armed = true;
+    }
+    // Re-evaluate the new interest set, this also re-arms EPOLLONESHOT entries.
+    entry.reregister_with_file();
+    dbgln_if(EPOLL_DEBUG, "EventPoll({}): Modified fd {} to events {:#x}", this, fd, event.events);
+    return KSuccess;
+}
+
+KResult EventPoll::remove(int fd)
+{
+    LOCKER(m_lock);
+    auto it = m_entries.find(fd);
+    if (it == m_entries.end())
+        return ENOENT;
+    // Keep the entry alive until it's been removed from the block condition.
+    NonnullRefPtr<Entry> entry = *it->value;
+    unregister_entry(*entry);
+    dbgln_if(EPOLL_DEBUG, "EventPoll({}): Removed fd {}", this, fd);
+    return KSuccess;
+}
+
+size_t EventPoll::collect_ready_events(Vector<epoll_event>& ready_events, size_t max_events)
+{
+    LOCKER(m_lock);
+    NonnullRefPtrVector<Entry> candidates;
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        candidates = move(m_ready_entries);
+        for (auto& entry : candidates)
+            entry.is_queued = false;
+    }
+
+    NonnullRefPtrVector<Entry> requeue;
+    for (auto& entry : candidates) {
+        if (ready_events.size() >= max_events) {
+            // We ran out of room, leave the rest for the next call.
+            requeue.append(entry);
+            continue;
+        }
+
+        auto description = entry.description();
+        if (!description) {
+            // The descriptor was closed without removing it from the interest set.
+            if (entry.is_registered)
+                unregister_entry(entry);
+            continue;
+        }
+
+        auto unblocked_flags = description->should_unblock(entry.block_flags());
+        if (unblocked_flags == BlockFlags::None)
+            continue;
+
+        epoll_event event {};
+        event.events = events_for_unblocked_flags(unblocked_flags);
+        event.data.u64 = entry.data();
+        ready_events.append(event);
+
+        if (entry.events() & EPOLLONESHOT) {
+            ScopedSpinLock lock(m_ready_lock);
+            entry.is_armed = false;
+        } else if (!(entry.events() & EPOLLET)) {
+            requeue.append(entry);
+        }
+    }
+
+    queue_ready_entries(requeue);
+    return ready_events.size();
+}
+
+bool EventPoll::can_read(const FileDescription&, size_t) const
+{
+    ScopedSpinLock lock(m_ready_lock);
+    return !m_ready_entries.is_empty();
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Badge.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullRefPtrVector.h>
+#include <AK/WeakPtr.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Lock.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/UnixTypes.h>
+
+namespace Kernel {
+
+// EventPoll is the kernel side of epoll_create(). It keeps a persistent
+// interest set of file descriptions and registers one long-lived blocker
+// with each of them, so that waiting for readiness doesn't have to walk and
+// re-register every descriptor on each call like select() and poll() do.
+//
+// Notifications only queue an entry on the ready list; the actual readiness
+// is re-evaluated by collect_ready_events(). Level-triggered entries that are
+// still ready stay queued, edge-triggered entries have to be notified again.
+//
+// Entries don't keep their file description alive. When a description that
+// is still in an interest set closes, it unregisters its entries from the
+// file and queues them so that the next collect_ready_events() drops them.
+class EventPoll final : public File {
+public:
+    static NonnullRefPtr<EventPoll> create();
+    virtual ~EventPoll() override;
+
+    KResult add(int fd, FileDescription&, const epoll_event&);
+    KResult modify(int fd, FileDescription&, const epoll_event&);
+    KResult remove(int fd);
+
+    size_t collect_ready_events(Vector<epoll_event>&, size_t max_events);
+
+    virtual bool can_read(const FileDescription&, size_t) const override;
+    virtual bool can_write(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> read(FileDescription&, size_t, UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual String absolute_path(const FileDescription&) const override { return "epoll"; }
+    virtual const char* class_name() const override { return "EventPoll"; }
+    virtual bool is_event_poll() const override { return true; }
+
+    class Entry final
+        : public RefCounted<Entry>
+        , public Thread::FileBlocker {
+    public:
+        Entry(EventPoll&, int fd, FileDescription&, const epoll_event&);
+
+        virtual const char* state_string() const override { return "EventPoll"; }
+        virtual void not_blocking(bool) override { VERIFY_NOT_REACHED(); }
+        virtual bool unblock(bool, void*) override;
+
+        void set_interest(const epoll_event&);
+        void register_with_file();
+        void reregister_with_file();
+        void unregister_from_file();
+        void description_will_close(Badge<FileDescription>);
+        bool is_registered_with_file() const
+        {
+            ScopedSpinLock lock(m_file_lock);
+            return m_file != nullptr;
+        }
+
+        int fd() const { return m_fd; }
+        bool is_for(const FileDescription& description) const { return m_description.unsafe_ptr() == &description; }
+        RefPtr<FileDescription> description() const { return m_description.strong_ref(); }
+        u32 events() const { return m_events; }
+        u64 data() const { return m_data; }
+        BlockFlags block_flags() const { return m_block_flags; }
+
+        // These are protected by EventPoll::m_ready_lock.
+        bool is_queued { false };
+        bool is_armed { true };
+        bool is_registered { true };
+
+    private:
+        EventPoll& m_event_poll;
+        int m_fd { -1 };
+        // Cleared once we've been removed from the file's block condition, which
+        // happens at the latest when the description closes. Protected by m_file_lock.
+        File* m_file { nullptr };
+        mutable SpinLock<u8> m_file_lock;
+        WeakPtr<FileDescription> m_description;
+        u32 m_events { 0 };
+        u64 m_data { 0 };
+        BlockFlags m_block_flags { BlockFlags::None };
+    };
+
+private:
+    EventPoll();
+
+    void did_notify(Entry&);
+    void did_close(Entry&);
+    void queue_ready_entries(NonnullRefPtrVector<Entry>&);
+    void unregister_entry(Entry&);
+
+    Lock m_lock { "EventPoll" };
+    HashMap<int, NonnullRefPtr<Entry>> m_entries;
+
+    mutable SpinLock<u8> m_ready_lock;
+    NonnullRefPtrVector<Entry> m_ready_entries;
+};
+
+}
@@ -767,6 +767,14 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FS: Reading up to {} bytes, {} bytes into inode {} to {}", count, offset, index(), buffer.user_or_kernel_ptr());
 
+    if (allow_cache) {
+        // Fetch the requested blocks in as few device requests as possible. Reading ahead
+        // of sequential access is left to the InodePageCache, which sits on top of us.
+        int err = prefetch_block_range(first_block_logical_index, last_block_logical_index + 1);
+        if (err < 0)
+            return err;
+    }
+
     for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; ++bi) {
         auto block_index = m_block_list[bi];
         VERIFY(block_index.value());
@@ -785,6 +793,22 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
     return nread;
 }
 
+int Ext2FSInode::prefetch_block_range(size_t first_block_logical_index, size_t end_block_logical_index) const
+{
+    // Issue one request per run of physically contiguous blocks instead of one per block.
+    size_t bi = first_block_logical_index;
+    while (bi < end_block_logical_index) {
+        size_t run_length = 1;
+        while (bi + run_length < end_block_logical_index && m_block_list[bi + run_length].value() == m_block_list[bi].value() + run_length)
+            ++run_length;
+        auto result = fs().prefetch_blocks(m_block_list[bi], run_length);
+        if (result.is_error())
+            return result;
+        bi += run_length;
+    }
+    return 0;
+}
+
 KResult Ext2FSInode::resize(u64 new_size)
 {
     u64 old_size = size();
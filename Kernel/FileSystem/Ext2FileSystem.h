@@ -81,6 +81,7 @@ private:
     KResult write_directory(const Vector<Ext2FSDirectoryEntry>&);
     bool populate_lookup_cache() const;
     KResult resize(u64);
+    int prefetch_block_range(size_t first_block_logical_index, size_t end_block_logical_index) const;
     KResult flush_block_list();
     Vector<BlockBasedFS::BlockIndex> compute_block_list() const;
     Vector<BlockBasedFS::BlockIndex> compute_block_list_with_meta_blocks() const;
@@ -77,6 +77,14 @@ FileDescription::FileDescription(File& file)
 
 FileDescription::~FileDescription()
 {
+    NonnullRefPtrVector<EventPoll::Entry> event_poll_entries;
+    {
+        ScopedSpinLock lock(m_event_poll_entries_lock);
+        event_poll_entries = move(m_event_poll_entries);
+    }
+    for (auto& entry : event_poll_entries)
+        entry.description_will_close({});
+
     m_file->detach(*this);
     if (is_fifo())
         static_cast<FIFO*>(m_file.ptr())->detach(m_fifo_direction);
@@ -96,6 +104,14 @@ KResult FileDescription::attach()
     return m_file->attach(*this);
 }
 
+void FileDescription::did_add_to_event_poll(Badge<EventPoll>, EventPoll::Entry& entry)
+{
+    ScopedSpinLock lock(m_event_poll_entries_lock);
+    // Drop the entries that have since been removed from their interest set.
+    m_event_poll_entries.remove_all_matching([](auto& other) { return !other->is_registered_with_file(); });
+    m_event_poll_entries.append(entry);
+}
+
 Thread::FileBlocker::BlockFlags FileDescription::should_unblock(Thread::FileBlocker::BlockFlags block_flags) const
 {
     using BlockFlags = Thread::FileBlocker::BlockFlags;
@@ -193,6 +209,32 @@ KResultOr<size_t> FileDescription::write(const UserOrKernelBuffer& data, size_t
     return nwritten_or_error;
 }
 
+KResultOr<size_t> FileDescription::read(UserOrKernelBuffer& buffer, u64 offset, size_t count)
+{
+    LOCKER(m_lock);
+    if (!m_file->is_seekable())
+        return ESPIPE;
+    if (Checked<off_t>::addition_would_overflow(offset, count))
+        return EOVERFLOW;
+    auto nread_or_error = m_file->read(*this, offset, buffer, count);
+    if (!nread_or_error.is_error())
+        evaluate_block_conditions();
+    return nread_or_error;
+}
+
+KResultOr<size_t> FileDescription::write(u64 offset, const UserOrKernelBuffer& data, size_t size)
+{
+    LOCKER(m_lock);
+    if (!m_file->is_seekable())
+        return ESPIPE;
+    if (Checked<off_t>::addition_would_overflow(offset, size))
+        return EOVERFLOW;
+    auto nwritten_or_error = m_file->write(*this, offset, data, size);
+    if (!nwritten_or_error.is_error())
+        evaluate_block_conditions();
+    return nwritten_or_error;
+}
+
 bool FileDescription::can_write() const
 {
     return m_file->can_write(*this, offset());
@@ -28,12 +28,16 @@
 
 #include <AK/Badge.h>
 #include <AK/ByteBuffer.h>
+#include <AK/NonnullRefPtrVector.h>
 #include <AK/RefCounted.h>
+#include <AK/Weakable.h>
+#include <Kernel/FileSystem/EventPoll.h>
 #include <Kernel/FileSystem/FIFO.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/InodeMetadata.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/KBuffer.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/VirtualAddress.h>
 
 namespace Kernel {
@@ -43,7 +47,9 @@ public:
     virtual ~FileDescriptionData() = default;
 };
 
-class FileDescription : public RefCounted<FileDescription> {
+class FileDescription
+    : public RefCounted<FileDescription>
+    , public Weakable<FileDescription> {
     MAKE_SLAB_ALLOCATED(FileDescription)
 public:
     static KResultOr<NonnullRefPtr<FileDescription>> create(Custody&);
@@ -69,6 +75,10 @@ public:
     off_t seek(off_t, int whence);
     KResultOr<size_t> read(UserOrKernelBuffer&, size_t);
     KResultOr<size_t> write(const UserOrKernelBuffer& data, size_t);
+
+    // Positional variants, these don't use or update the current offset.
+    KResultOr<size_t> read(UserOrKernelBuffer&, u64 offset, size_t);
+    KResultOr<size_t> write(u64 offset, const UserOrKernelBuffer& data, size_t);
     KResult stat(::stat&);
 
     KResult chmod(mode_t);
@@ -139,6 +149,8 @@ public:
 
     FileBlockCondition& block_condition();
 
+    void did_add_to_event_poll(Badge<EventPoll>, EventPoll::Entry&);
+
 private:
     friend class VFS;
     explicit FileDescription(File&);
@@ -169,6 +181,10 @@ private:
     FIFO::Direction m_fifo_direction { FIFO::Direction::Neither };
 
     Lock m_lock { "FileDescription" };
+
+    // The epoll interest set entries watching us, so we can unregister them when we go away.
+    SpinLock<u8> m_event_poll_entries_lock;
+    NonnullRefPtrVector<EventPoll::Entry> m_event_poll_entries;
 };
 
 }
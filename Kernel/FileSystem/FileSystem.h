@@ -83,6 +83,7 @@ public:
     size_t block_size() const { return m_block_size; }
 
     virtual bool is_file_backed() const { return false; }
+    virtual bool is_block_based() const { return false; }
 
     // Converts file types that are used internally by the filesystem to DT_* types
     virtual u8 internal_file_type_to_directory_entry_type(const DirectoryEntryView& entry) const { return entry.file_type; }
@@ -31,6 +31,7 @@
 #include <Kernel/API/InodeWatcherEvent.h>
 #include <Kernel/FileSystem/Custody.h>
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/FileSystem/InodePageCache.h>
 #include <Kernel/FileSystem/InodeWatcher.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/KBufferBuilder.h>
@@ -272,6 +273,16 @@ RefPtr<SharedInodeVMObject> Inode::shared_vmobject() const
     return m_shared_vmobject.strong_ref();
 }
 
+InodePageCache* Inode::page_cache()
+{
+    LOCKER(m_lock);
+    // Only regular files on disk-backed file systems are cached. Synthetic file systems
+    // generate their contents on the fly, and the rest already live in memory.
+    if (!m_page_cache && fs().is_block_based() && metadata().is_regular_file())
+        m_page_cache = make<InodePageCache>(*this);
+    return m_page_cache.ptr();
+}
+
 bool Inode::is_shared_vmobject(const SharedInodeVMObject& other) const
 {
     LOCKER(m_lock);
@@ -29,6 +29,7 @@
 #include <AK/Function.h>
 #include <AK/HashTable.h>
 #include <AK/InlineLinkedList.h>
+#include <AK/OwnPtr.h>
 #include <AK/RefCounted.h>
 #include <AK/String.h>
 #include <AK/WeakPtr.h>
@@ -110,6 +111,9 @@ public:
     RefPtr<SharedInodeVMObject> shared_vmobject() const;
     bool is_shared_vmobject(const SharedInodeVMObject&) const;
 
+    InodePageCache* page_cache();
+    bool has_page_cache() const { return m_page_cache; }
+
     static InlineLinkedList<Inode>& all_with_lock();
     static void sync();
 
@@ -140,6 +144,7 @@ private:
     FS& m_fs;
     InodeIndex m_index { 0 };
     WeakPtr<SharedInodeVMObject> m_shared_vmobject;
+    OwnPtr<InodePageCache> m_page_cache;
     RefPtr<LocalSocket> m_socket;
     HashTable<InodeWatcher*> m_watchers;
     bool m_metadata_dirty { false };
@@ -28,6 +28,7 @@
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/InodeFile.h>
+#include <Kernel/FileSystem/InodePageCache.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/Process.h>
 #include <Kernel/VM/PrivateInodeVMObject.h>
@@ -51,7 +52,11 @@ KResultOr<size_t> InodeFile::read(FileDescription& description, size_t offset, U
     if (Checked<off_t>::addition_would_overflow(offset, count))
         return EOVERFLOW;
 
-    ssize_t nread = m_inode->read_bytes(offset, count, buffer, &description);
+    ssize_t nread;
+    if (auto* page_cache = m_inode->page_cache(); page_cache && !description.is_direct())
+        nread = page_cache->read_bytes(offset, count, buffer);
+    else
+        nread = m_inode->read_bytes(offset, count, buffer, &description);
     if (nread > 0) {
         Thread::current()->did_file_read(nread);
         evaluate_block_conditions();
@@ -68,6 +73,8 @@ KResultOr<size_t> InodeFile::write(FileDescription& description, size_t offset,
 
     ssize_t nwritten = m_inode->write_bytes(offset, count, data, &description);
     if (nwritten > 0) {
+        if (auto* page_cache = m_inode->page_cache())
+            page_cache->did_write_bytes(offset, nwritten);
         m_inode->set_mtime(kgettimeofday().to_truncated_seconds());
         Thread::current()->did_file_write(nwritten);
         evaluate_block_conditions();
@@ -132,6 +139,8 @@ KResult InodeFile::truncate(u64 size)
     auto truncate_result = m_inode->truncate(size);
     if (truncate_result.is_error())
         return truncate_result;
+    if (auto* page_cache = m_inode->page_cache())
+        page_cache->did_truncate(size);
     int mtime_result = m_inode->set_mtime(kgettimeofday().to_truncated_seconds());
     if (mtime_result < 0)
         return KResult((ErrnoCode)-mtime_result);
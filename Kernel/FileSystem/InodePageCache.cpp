@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/FileSystem/InodePageCache.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+static Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> s_total_cached_page_count;
+
+size_t InodePageCache::total_cached_page_count()
+{
+    return s_total_cached_page_count;
+}
+
+static size_t max_cached_page_count()
+{
+    // Don't let file data take more than a quarter of memory. Pages that can't be
+    // cached are simply read straight from the file system instead.
+    return MM.user_physical_pages() / 4;
+}
+
+static bool page_cache_is_full()
+{
+    return s_total_cached_page_count >= max_cached_page_count();
+}
+
+size_t InodePageCache::shrink(size_t page_count)
+{
+    NonnullRefPtrVector<Inode> inodes;
+    {
+        ScopedSpinLock all_inodes_lock(Inode::all_inodes_lock());
+        for (auto& inode : Inode::all_with_lock()) {
+            if (inode.has_page_cache())
+                inodes.append(inode);
+        }
+    }
+
+    // The first pass only takes chunks nobody has touched since the last time we came
+    // around, and marks the rest. If that wasn't enough, the second pass takes those too.
+    size_t released_page_count = 0;
+    for (int pass = 0; pass < 2 && released_page_count < page_count; ++pass) {
+        for (auto& inode : inodes) {
+            released_page_count += inode.page_cache()->release_unmapped_pages(page_count - released_page_count, SpareRecentlyUsed::Yes);
+            if (released_page_count >= page_count)
+                break;
+        }
+    }
+    dbgln_if(PAGE_CACHE_DEBUG, "InodePageCache: Shrinking released {} of {} pages", released_page_count, page_count);
+    return released_page_count;
+}
+
+void InodePageCache::make_room()
+{
+    if (page_cache_is_full())
+        shrink(max_cached_page_count() / 8);
+}
+
+InodePageCache::InodePageCache(Inode& inode)
+    : m_inode(inode)
+{
+}
+
+InodePageCache::~InodePageCache()
+{
+    s_total_cached_page_count -= m_cached_page_count;
+}
+
+InodePageCache::Chunk* InodePageCache::ensure_chunk(size_t chunk_index)
+{
+    if (auto it = m_chunks.find(chunk_index); it != m_chunks.end())
+        return it->value.ptr();
+
+    // Only the address space is set aside here. Pages are allocated by allocate_pages() right
+    // before they are populated, since a zero fault on a kernel write can't fail gracefully.
+    auto region = MM.allocate_kernel_region(pages_per_chunk * PAGE_SIZE, "Inode page cache", Region::Access::Read | Region::Access::Write, AllocationStrategy::None);
+    if (!region)
+        return nullptr;
+    auto chunk = adopt_own(*new Chunk { region.release_nonnull(), Bitmap(pages_per_chunk, false) });
+    auto* chunk_ptr = chunk.ptr();
+    m_chunks.set(chunk_index, move(chunk));
+    return chunk_ptr;
+}
+
+bool InodePageCache::is_populated(size_t page_index) const
+{
+    auto it = m_chunks.find(page_index / pages_per_chunk);
+    if (it == m_chunks.end())
+        return false;
+    return it->value->populated.get(page_index % pages_per_chunk);
+}
+
+u8* InodePageCache::page_data(size_t page_index)
+{
+    auto& chunk = *m_chunks.find(page_index / pages_per_chunk)->value;
+    chunk.recently_used = true;
+    return chunk.region->vaddr().offset((page_index % pages_per_chunk) * PAGE_SIZE).as_ptr();
+}
+
+size_t InodePageCache::allocate_pages(Chunk& chunk, size_t first_index, size_t end_index)
+{
+    auto& physical_pages = chunk.region->vmobject().physical_pages();
+    size_t index = first_index;
+    for (; index < end_index; ++index) {
+        // Pages that were forgotten earlier still have their memory, so just reuse it.
+        if (!physical_pages[index]->is_shared_zero_page())
+            continue;
+        auto page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+        if (!page)
+            break;
+        physical_pages[index] = move(page);
+    }
+    if (index == first_index || !chunk.region->remap_vmobject_page_range(first_index, index - first_index))
+        return 0;
+    return index - first_index;
+}
+
+bool InodePageCache::is_mapped(const Chunk& chunk, size_t index) const
+{
+    // The chunk's VMObject holds one reference, anything else is a shared mapping.
+    auto& page = chunk.region->vmobject().physical_pages()[index];
+    return !page->is_shared_zero_page() && page->ref_count() > 1;
+}
+
+KResult InodePageCache::read_pages(size_t first_page, size_t end_page)
+{
+    size_t run_size = (end_page - first_page) * PAGE_SIZE;
+    auto* data = page_data(first_page);
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(data);
+    auto nread = m_inode.read_bytes(first_page * PAGE_SIZE, run_size, buffer, nullptr);
+    if (nread < 0)
+        return KResult((ErrnoCode)-nread);
+    if ((size_t)nread < run_size) {
+        // Zero the tail past the end of the file, it may be mapped into userspace.
+        memset(data + nread, 0, run_size - nread);
+    }
+    return KSuccess;
+}
+
+void InodePageCache::forget_page(size_t page_index)
+{
+    auto it = m_chunks.find(page_index / pages_per_chunk);
+    if (it == m_chunks.end() || !it->value->populated.get(page_index % pages_per_chunk))
+        return;
+    it->value->populated.set(page_index % pages_per_chunk, false);
+    --m_cached_page_count;
+    --s_total_cached_page_count;
+}
+
+bool InodePageCache::populate(size_t first_page, size_t end_page)
+{
+    VERIFY(m_lock.is_locked());
+    size_t page_index = first_page;
+    while (page_index < end_page) {
+        if (is_populated(page_index)) {
+            ++page_index;
+            continue;
+        }
+        if (page_cache_is_full())
+            return false;
+
+        // Read the whole run of missing pages within this chunk with a single call.
+        auto* chunk = ensure_chunk(page_index / pages_per_chunk);
+        if (!chunk)
+            return false;
+        size_t chunk_end = (page_index / pages_per_chunk + 1) * pages_per_chunk;
+        size_t run_end = page_index + 1;
+        while (run_end < min(end_page, chunk_end) && !is_populated(run_end))
+            ++run_end;
+
+        size_t first_index = page_index % pages_per_chunk;
+        size_t allocated_count = allocate_pages(*chunk, first_index, first_index + (run_end - page_index));
+        if (!allocated_count)
+            return false;
+        run_end = page_index + allocated_count;
+
+        if (read_pages(page_index, run_end).is_error())
+            return false;
+
+        for (size_t i = page_index; i < run_end; ++i)
+            chunk->populated.set(i % pages_per_chunk, true);
+        m_cached_page_count += run_end - page_index;
+        s_total_cached_page_count += run_end - page_index;
+        page_index = run_end;
+    }
+    return true;
+}
+
+ssize_t InodePageCache::read_bytes(off_t offset, size_t count, UserOrKernelBuffer& buffer)
+{
+    VERIFY(offset >= 0);
+    make_room();
+    LOCKER(m_lock);
+
+    size_t file_size = m_inode.size();
+    if ((size_t)offset >= file_size)
+        return 0;
+    count = min(count, file_size - offset);
+    if (!count)
+        return 0;
+
+    size_t first_page = offset / PAGE_SIZE;
+    size_t end_page = (offset + count - 1) / PAGE_SIZE + 1;
+    size_t file_page_count = page_round_up(file_size) / PAGE_SIZE;
+
+    // Grow the readahead window while the file is being read sequentially.
+    if (first_page == m_next_sequential_page || first_page + 1 == m_next_sequential_page)
+        m_readahead_pages = m_readahead_pages ? min(m_readahead_pages * 2, max_readahead_pages) : min_readahead_pages;
+    else
+        m_readahead_pages = 0;
+    m_next_sequential_page = end_page;
+
+    if (!populate(first_page, end_page))
+        return m_inode.read_bytes(offset, count, buffer, nullptr);
+
+    if (m_readahead_pages) {
+        auto readahead_end = min(end_page + m_readahead_pages, file_page_count);
+        dbgln_if(PAGE_CACHE_DEBUG, "InodePageCache: Readahead of pages {}-{} for inode {}", end_page, readahead_end, m_inode.identifier());
+        populate(end_page, readahead_end);
+    }
+
+    size_t nread = 0;
+    while (nread < count) {
+        size_t offset_in_page = (offset + nread) % PAGE_SIZE;
+        size_t chunk_size = min(PAGE_SIZE - offset_in_page, count - nread);
+        if (!buffer.write(page_data((offset + nread) / PAGE_SIZE) + offset_in_page, nread, chunk_size))
+            return -EFAULT;
+        nread += chunk_size;
+    }
+    return nread;
+}
+
+void InodePageCache::did_write_bytes(off_t offset, size_t count)
+{
+    VERIFY(offset >= 0);
+    if (!count)
+        return;
+    LOCKER(m_lock);
+
+    // Refresh the cached pages from the file rather than from the caller's buffer, which may
+    // have changed since it was written out. Shared mappings keep seeing the same pages.
+    size_t first_page = offset / PAGE_SIZE;
+    size_t end_page = (offset + count - 1) / PAGE_SIZE + 1;
+    size_t page_index = first_page;
+    while (page_index < end_page) {
+        if (!is_populated(page_index)) {
+            ++page_index;
+            continue;
+        }
+        size_t chunk_end = (page_index / pages_per_chunk + 1) * pages_per_chunk;
+        size_t run_end = page_index + 1;
+        while (run_end < min(end_page, chunk_end) && is_populated(run_end))
+            ++run_end;
+        if (read_pages(page_index, run_end).is_error()) {
+            for (size_t i = page_index; i < run_end; ++i)
+                forget_page(i);
+        }
+        page_index = run_end;
+    }
+}
+
+void InodePageCache::did_truncate(u64 new_size)
+{
+    LOCKER(m_lock);
+
+    size_t file_page_count = page_round_up(new_size) / PAGE_SIZE;
+    Vector<size_t> chunks_to_remove;
+    for (auto& it : m_chunks) {
+        auto& chunk = *it.value;
+        bool has_mapped_page = false;
+        for (size_t i = 0; i < pages_per_chunk; ++i) {
+            size_t page_index = it.key * pages_per_chunk + i;
+            if (is_mapped(chunk, i))
+                has_mapped_page = true;
+            if (page_index < file_page_count || !chunk.populated.get(i))
+                continue;
+            if (is_mapped(chunk, i)) {
+                // A shared mapping still uses this page, so it has to stay in the cache. It reads
+                // as zeroes now, which is also what the file contains if it grows back over it.
+                memset(page_data(page_index), 0, PAGE_SIZE);
+                continue;
+            }
+            forget_page(page_index);
+        }
+        if (it.key * pages_per_chunk >= file_page_count && !has_mapped_page)
+            chunks_to_remove.append(it.key);
+    }
+    for (auto chunk_index : chunks_to_remove)
+        m_chunks.remove(chunk_index);
+
+    if (auto offset_in_page = new_size % PAGE_SIZE; offset_in_page && is_populated(new_size / PAGE_SIZE))
+        memset(page_data(new_size / PAGE_SIZE) + offset_in_page, 0, PAGE_SIZE - offset_in_page);
+}
+
+Vector<RefPtr<PhysicalPage>> InodePageCache::pages_for_shared_mapping(size_t first_page, size_t end_page)
+{
+    LOCKER(m_lock);
+
+    VERIFY(first_page <= end_page);
+    Vector<RefPtr<PhysicalPage>> pages;
+    pages.resize(end_page - first_page);
+
+    size_t file_size = m_inode.size();
+    size_t file_page_count = page_round_up(file_size) / PAGE_SIZE;
+    end_page = min(end_page, file_page_count);
+    if (first_page >= end_page)
+        return pages;
+
+    // A partial failure still leaves us with whatever got populated.
+    populate(first_page, end_page);
+    for (size_t page_index = first_page; page_index < end_page; ++page_index) {
+        if (!is_populated(page_index))
+            continue;
+        auto& chunk = *m_chunks.get(page_index / pages_per_chunk).value();
+        pages[page_index - first_page] = chunk.region->vmobject().physical_pages()[page_index % pages_per_chunk];
+    }
+    return pages;
+}
+
+size_t InodePageCache::release_unmapped_pages(size_t max_page_count, SpareRecentlyUsed spare_recently_used)
+{
+    LOCKER(m_lock);
+
+    // A chunk can only go away once none of its pages are mapped by a shared
+    // mapping anymore, otherwise read() and the mapping would drift apart.
+    Vector<size_t> chunks_to_remove;
+    size_t released_page_count = 0;
+    for (auto& it : m_chunks) {
+        if (released_page_count >= max_page_count)
+            break;
+        auto& chunk = *it.value;
+        if (spare_recently_used == SpareRecentlyUsed::Yes && chunk.recently_used) {
+            chunk.recently_used = false;
+            continue;
+        }
+        bool has_mapped_page = false;
+        for (size_t i = 0; i < pages_per_chunk; ++i) {
+            if (is_mapped(chunk, i)) {
+                has_mapped_page = true;
+                break;
+            }
+        }
+        if (has_mapped_page)
+            continue;
+        chunks_to_remove.append(it.key);
+        released_page_count += chunk.populated.count_slow(true);
+    }
+    for (auto chunk_index : chunks_to_remove)
+        m_chunks.remove(chunk_index);
+
+    m_cached_page_count -= released_page_count;
+    s_total_cached_page_count -= released_page_count;
+    return released_page_count;
+}
+
+}
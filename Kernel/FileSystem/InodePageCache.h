@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Bitmap.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <Kernel/Forward.h>
+#include <Kernel/Lock.h>
+#include <Kernel/UnixTypes.h>
+#include <Kernel/UserOrKernelBuffer.h>
+#include <Kernel/VM/PhysicalPage.h>
+
+namespace Kernel {
+
+// The page cache holds the contents of a regular file in physical pages that are
+// shared between read()/write() and MAP_SHARED mappings of the file, so that
+// hot file data lives in memory exactly once.
+class InodePageCache {
+    AK_MAKE_NONCOPYABLE(InodePageCache);
+    AK_MAKE_NONMOVABLE(InodePageCache);
+
+public:
+    explicit InodePageCache(Inode&);
+    ~InodePageCache();
+
+    ssize_t read_bytes(off_t, size_t count, UserOrKernelBuffer&);
+
+    // Re-reads the cached pages in the range from the file after it has been written to.
+    void did_write_bytes(off_t, size_t count);
+    void did_truncate(u64 new_size);
+
+    // Returns the cache pages for [first_page, end_page), reading any missing ones in as few calls as
+    // possible. Entries past the end of the file, or that could not be read, are null.
+    Vector<RefPtr<PhysicalPage>> pages_for_shared_mapping(size_t first_page, size_t end_page);
+
+    enum class SpareRecentlyUsed {
+        No,
+        Yes,
+    };
+    size_t release_unmapped_pages(size_t max_page_count = NumericLimits<size_t>::max(), SpareRecentlyUsed = SpareRecentlyUsed::No);
+    size_t cached_page_count() const { return m_cached_page_count; }
+
+    static size_t total_cached_page_count();
+    // Releases up to page_count pages from all caches, preferring chunks that haven't been used lately.
+    static size_t shrink(size_t page_count);
+
+private:
+    static constexpr size_t pages_per_chunk = 16;
+    static constexpr size_t min_readahead_pages = 4;
+    static constexpr size_t max_readahead_pages = 32;
+
+    struct Chunk {
+        NonnullOwnPtr<Region> region;
+        Bitmap populated;
+        bool recently_used { true };
+    };
+
+    static void make_room();
+
+    Chunk* ensure_chunk(size_t chunk_index);
+    size_t allocate_pages(Chunk&, size_t first_index, size_t end_index);
+    bool is_mapped(const Chunk&, size_t index) const;
+    KResult read_pages(size_t first_page, size_t end_page);
+    bool populate(size_t first_page, size_t end_page);
+    bool is_populated(size_t page_index) const;
+    u8* page_data(size_t page_index);
+    void forget_page(size_t page_index);
+
+    Inode& m_inode;
+    Lock m_lock { "InodePageCache" };
+    HashMap<size_t, NonnullOwnPtr<Chunk>> m_chunks;
+    size_t m_cached_page_count { 0 };
+    size_t m_next_sequential_page { 0 };
+    size_t m_readahead_pages { 0 };
+};
+
+}
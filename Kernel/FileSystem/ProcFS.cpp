@@ -37,9 +37,11 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/Devices/KeyboardDevice.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/Custody.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FileSystem/InodePageCache.h>
 #include <Kernel/FileSystem/ProcFS.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/Heap/kmalloc.h>
@@ -50,6 +52,7 @@
 #include <Kernel/Module.h>
 #include <Kernel/Net/LocalSocket.h>
 #include <Kernel/Net/NetworkAdapter.h>
+#include <Kernel/Net/PacketBuffer.h>
 #include <Kernel/Net/Routing.h>
 #include <Kernel/Net/TCPSocket.h>
 #include <Kernel/Net/UDPSocket.h>
@@ -110,6 +113,7 @@ enum ProcFileType {
     FI_Root_net_tcp,
     FI_Root_net_udp,
     FI_Root_net_local,
+    FI_Root_net_packet_buffers,
 
     FI_PID,
 
@@ -438,6 +442,24 @@ static bool procfs$devices(InodeIdentifier, KBufferBuilder& builder)
             obj.add("type", "character");
         else
             VERIFY_NOT_REACHED();
+
+        if (device.is_block_device()) {
+            using Statistics = BlockDevice::RequestQueueStatistics;
+            auto statistics = static_cast<const BlockDevice&>(device).request_queue_statistics();
+            auto queue_object = obj.add_object("request_queue");
+            queue_object.add("depth", statistics.depth);
+            queue_object.add("max_depth", statistics.max_depth);
+            queue_object.add("completed_requests", statistics.completed_request_count);
+            queue_object.add("total_latency_us", statistics.total_latency_us);
+            auto histogram_array = queue_object.add_array("latency_histogram");
+            for (size_t bucket = 0; bucket < Statistics::latency_histogram_bucket_count; ++bucket) {
+                auto bucket_object = histogram_array.add_object();
+                // The last bucket has no upper bound.
+                if (bucket < Statistics::latency_histogram_bucket_count - 1)
+                    bucket_object.add("below_us", Statistics::latency_histogram_bucket_limit_us(bucket));
+                bucket_object.add("count", statistics.latency_histogram[bucket]);
+            }
+        }
     });
     array.finish();
     return true;
@@ -513,6 +535,7 @@ static bool procfs$net_adapters(InodeIdentifier, KBufferBuilder& builder)
         obj.add("bytes_in", adapter.bytes_in());
         obj.add("packets_out", adapter.packets_out());
         obj.add("bytes_out", adapter.bytes_out());
+        obj.add("packets_dropped", adapter.packets_dropped());
         obj.add("link_up", adapter.link_up());
         obj.add("mtu", adapter.mtu());
     });
@@ -549,6 +572,19 @@ static bool procfs$net_tcp(InodeIdentifier, KBufferBuilder& builder)
         obj.add("bytes_in", socket.bytes_in());
         obj.add("packets_out", socket.packets_out());
         obj.add("bytes_out", socket.bytes_out());
+        obj.add("maximum_segment_size", socket.maximum_segment_size());
+        obj.add("peer_window", socket.peer_window());
+        obj.add("congestion_window", socket.congestion_window());
+        obj.add("slow_start_threshold", socket.slow_start_threshold());
+        obj.add("sack_enabled", socket.is_sack_enabled());
+        obj.add("smoothed_rtt_us", socket.smoothed_rtt_us());
+        obj.add("rtt_variance_us", socket.rtt_variance_us());
+        obj.add("retransmission_timeout_us", socket.retransmission_timeout_us());
+        obj.add("retransmissions", socket.retransmissions());
+        obj.add("fast_retransmissions", socket.fast_retransmissions());
+        obj.add("retransmission_timeouts", socket.retransmission_timeouts());
+        obj.add("window_probes", socket.window_probes());
+        obj.add("out_of_order_segments", socket.out_of_order_segments_received());
     });
     array.finish();
     return true;
@@ -568,6 +604,22 @@ static bool procfs$net_udp(InodeIdentifier, KBufferBuilder& builder)
     return true;
 }
 
+static bool procfs$net_packet_buffers(InodeIdentifier, KBufferBuilder& builder)
+{
+    auto statistics = PacketBufferPool::the().statistics();
+    JsonObjectSerializer<KBufferBuilder> json { builder };
+    json.add("buffer_size", statistics.buffer_size);
+    json.add("total_buffers", statistics.total_buffers);
+    json.add("free_buffers", statistics.free_buffers);
+    json.add("buffers_in_use", statistics.total_buffers - statistics.free_buffers);
+    json.add("peak_buffers_in_use", statistics.peak_buffers_in_use);
+    json.add("allocations", statistics.allocations);
+    json.add("allocation_failures", statistics.allocation_failures);
+    json.add("heap_allocations", statistics.heap_allocations);
+    json.finish();
+    return true;
+}
+
 static bool procfs$net_local(InodeIdentifier, KBufferBuilder& builder)
 {
     JsonArraySerializer array { builder };
@@ -695,6 +747,18 @@ static bool procfs$df(InodeIdentifier, KBufferBuilder& builder)
             fs_object.add("source", static_cast<const FileBackedFS&>(fs).file_description().absolute_path());
         else
             fs_object.add("source", "none");
+
+        if (fs.is_block_based()) {
+            auto statistics = static_cast<const BlockBasedFS&>(fs).cache_statistics();
+            auto cache_object = fs_object.add_object("cache");
+            cache_object.add("entries", statistics.entry_count);
+            cache_object.add("segments", statistics.segment_count);
+            cache_object.add("hits", statistics.hits);
+            cache_object.add("misses", statistics.misses);
+            cache_object.add("evictions", statistics.evictions);
+            cache_object.add("grow_count", statistics.grow_count);
+            cache_object.add("shrink_count", statistics.shrink_count);
+        }
     });
     array.finish();
     return true;
@@ -739,6 +803,7 @@ static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
 
     auto super_physical_total = MM.super_physical_pages();
     auto super_physical_used = MM.super_physical_pages_used();
+    auto zeroed_page_pool_count = MM.zeroed_page_pool_count();
     mm_lock.unlock();
 
     JsonObjectSerializer<KBufferBuilder> json { builder };
@@ -749,8 +814,28 @@ static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
     json.add("user_physical_available", user_physical_pages_total - user_physical_pages_used);
     json.add("user_physical_committed", user_physical_pages_committed);
     json.add("user_physical_uncommitted", user_physical_pages_uncommitted);
+    json.add("page_cache_pages", InodePageCache::total_cached_page_count());
     json.add("super_physical_allocated", super_physical_used);
     json.add("super_physical_available", super_physical_total - super_physical_used);
+    json.add("zeroed_page_pool_pages", zeroed_page_pool_count);
+    json.add("zeroed_page_pool_hits", MM.zeroed_page_pool_hits());
+    json.add("zeroed_page_pool_misses", MM.zeroed_page_pool_misses());
+    {
+        auto histogram_array = json.add_array("zero_fault_latency_histogram");
+        for (size_t bucket = 0; bucket < MemoryManager::zero_fault_latency_bucket_count; ++bucket)
+            histogram_array.add(MM.zero_fault_latency_bucket(bucket));
+    }
+    json.add("tlb_flush_ipis", MM.tlb_flush_ipis());
+    json.add("full_tlb_flushes", MM.full_tlb_flushes());
+    json.add("batched_tlb_flushes", MM.batched_tlb_flushes());
+    {
+        auto syscalls_object = json.add_object("syscall_tlb_flush_ipis");
+        for (size_t i = 0; i < Syscall::Function::__Count; ++i) {
+            auto function = static_cast<Syscall::Function>(i);
+            if (auto ipi_count = MM.syscall_tlb_flush_ipis(function))
+                syscalls_object.add(Syscall::to_string(function), ipi_count);
+        }
+    }
     json.add("kmalloc_call_count", stats.kmalloc_call_count);
     json.add("kfree_call_count", stats.kfree_call_count);
     slab_alloc_stats([&json](size_t slab_size, size_t num_allocated, size_t num_free) {
@@ -758,6 +843,24 @@ static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
         json.add(String::formatted("{}_num_allocated", prefix), num_allocated);
         json.add(String::formatted("{}_num_free", prefix), num_free);
     });
+    {
+        auto caches_array = json.add_array("kmalloc_processor_caches");
+        Processor::for_each(
+            [&](Processor& proc) -> IterationDecision {
+                kmalloc_processor_cache_stats cache_stats;
+                if (!get_kmalloc_processor_cache_stats(proc.get_id(), cache_stats))
+                    return IterationDecision::Continue;
+                auto obj = caches_array.add_object();
+                obj.add("processor", proc.get_id());
+                obj.add("kmalloc_call_count", cache_stats.kmalloc_call_count);
+                obj.add("kmalloc_hits", cache_stats.kmalloc_hits);
+                obj.add("kmalloc_misses", cache_stats.kmalloc_misses);
+                obj.add("kfree_call_count", cache_stats.kfree_call_count);
+                obj.add("kfree_hits", cache_stats.kfree_hits);
+                obj.add("kfree_misses", cache_stats.kfree_misses);
+                return IterationDecision::Continue;
+            });
+    }
     json.finish();
     return true;
 }
@@ -832,6 +935,7 @@ static bool procfs$all(InodeIdentifier, KBufferBuilder& builder)
             thread_object.add("inode_faults", thread.inode_faults());
             thread_object.add("zero_faults", thread.zero_faults());
             thread_object.add("cow_faults", thread.cow_faults());
+            thread_object.add("tlb_flush_ipis", thread.tlb_flush_ipis());
             thread_object.add("file_read_bytes", thread.file_read_bytes());
             thread_object.add("file_write_bytes", thread.file_write_bytes());
             thread_object.add("unix_socket_read_bytes", thread.unix_socket_read_bytes());
@@ -1309,6 +1413,7 @@ KResult ProcFSInode::traverse_as_directory(Function<bool(const FS::DirectoryEntr
         callback({ "tcp", to_identifier(fsid(), PDI_Root_net, 0, FI_Root_net_tcp), 0 });
         callback({ "udp", to_identifier(fsid(), PDI_Root_net, 0, FI_Root_net_udp), 0 });
         callback({ "local", to_identifier(fsid(), PDI_Root_net, 0, FI_Root_net_local), 0 });
+        callback({ "packet_buffers", to_identifier(fsid(), PDI_Root_net, 0, FI_Root_net_packet_buffers), 0 });
         break;
 
     case FI_PID: {
@@ -1411,6 +1516,8 @@ RefPtr<Inode> ProcFSInode::lookup(StringView name)
             return fs().get_inode(to_identifier(fsid(), PDI_Root, 0, FI_Root_net_udp));
         if (name == "local")
             return fs().get_inode(to_identifier(fsid(), PDI_Root, 0, FI_Root_net_local));
+        if (name == "packet_buffers")
+            return fs().get_inode(to_identifier(fsid(), PDI_Root, 0, FI_Root_net_packet_buffers));
         return {};
     }
 
@@ -1722,6 +1829,7 @@ ProcFS::ProcFS()
     m_entries[FI_Root_net_tcp] = { "tcp", FI_Root_net_tcp, false, procfs$net_tcp };
     m_entries[FI_Root_net_udp] = { "udp", FI_Root_net_udp, false, procfs$net_udp };
     m_entries[FI_Root_net_local] = { "local", FI_Root_net_local, false, procfs$net_local };
+    m_entries[FI_Root_net_packet_buffers] = { "packet_buffers", FI_Root_net_packet_buffers, false, procfs$net_packet_buffers };
 
     m_entries[FI_PID_vm] = { "vm", FI_PID_vm, false, procfs$pid_vm };
     m_entries[FI_PID_stacks] = { "stacks", FI_PID_stacks, false };
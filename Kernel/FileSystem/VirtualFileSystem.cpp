@@ -33,6 +33,7 @@
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
+#include <Kernel/FileSystem/InodePageCache.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Process.h>
@@ -343,6 +344,8 @@ KResultOr<NonnullRefPtr<FileDescription>> VFS::open(StringView path, int options
         KResult result = inode.truncate(0);
         if (result.is_error())
             return result;
+        if (auto* page_cache = inode.page_cache())
+            page_cache->did_truncate(0);
         inode.set_mtime(kgettimeofday().to_truncated_seconds());
     }
     auto description = FileDescription::create(custody);
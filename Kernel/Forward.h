@@ -41,6 +41,7 @@ class FutexQueue;
 class IPv4Socket;
 class Inode;
 class InodeIdentifier;
+class InodePageCache;
 class SharedInodeVMObject;
 class InodeWatcher;
 class KBuffer;
@@ -69,6 +70,7 @@ class RecursiveSpinLock;
 template<typename LockType>
 class ScopedSpinLock;
 class TCPSocket;
+class TLBFlushBatch;
 class TTY;
 class Thread;
 class UDPSocket;
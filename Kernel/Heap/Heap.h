@@ -66,6 +66,22 @@ public:
         return needed_chunks * CHUNK_SIZE + (needed_chunks + 7) / 8;
     }
 
+    static size_t chunks_needed_for(size_t size)
+    {
+        return (sizeof(AllocationHeader) + size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+
+    static size_t usable_size_for_chunks(size_t chunks)
+    {
+        return chunks * CHUNK_SIZE - sizeof(AllocationHeader);
+    }
+
+    static size_t allocation_size_in_chunks(const void* ptr)
+    {
+        const auto* a = (const AllocationHeader*)((((const u8*)ptr) - sizeof(AllocationHeader)));
+        return a->allocation_size_in_chunks;
+    }
+
     void* allocate(size_t size)
     {
         // We need space for the AllocationHeader at the head of the block.
@@ -47,6 +47,11 @@
 #define POOL_SIZE (2 * MiB)
 #define ETERNAL_RANGE_SIZE (2 * MiB)
 
+// Allocations of up to this many chunks are served from per-processor caches
+#define PROCESSOR_CACHE_CLASS_COUNT 4
+#define PROCESSOR_CACHE_MAGAZINE_SIZE 32
+#define PROCESSOR_CACHE_MAX_PROCESSORS 32
+
 static RecursiveSpinLock s_lock; // needs to be recursive because of dump_backtrace()
 
 static void kmalloc_allocate_backup_memory();
@@ -197,6 +202,99 @@ bool g_dump_kmalloc_stacks;
 static u8* s_next_eternal_ptr;
 READONLY_AFTER_INIT static u8* s_end_of_eternal_range;
 
+// Every processor keeps a magazine of recently freed blocks for each of
+// the small allocation sizes, which kmalloc() and kfree() can use without
+// taking s_lock. The global heap is only touched when a magazine runs
+// empty (refill) or full (flush), and then for half a magazine at a time.
+// A magazine must only be accessed by its own processor inside a critical
+// section, which also keeps interrupt handlers on that processor out.
+struct KmallocMagazine {
+    size_t count;
+    void* blocks[PROCESSOR_CACHE_MAGAZINE_SIZE];
+};
+
+struct KmallocProcessorCache {
+    KmallocMagazine magazines[PROCESSOR_CACHE_CLASS_COUNT];
+    kmalloc_processor_cache_stats stats;
+};
+
+static KmallocProcessorCache s_processor_caches[PROCESSOR_CACHE_MAX_PROCESSORS];
+
+using KmallocHeap = KmallocGlobalHeap::HeapType::HeapType;
+
+static inline bool can_use_processor_cache()
+{
+    // Keep everything on the slow path while we need the kmalloc backtraces
+    return !g_dump_kmalloc_stacks && Processor::is_initialized() && Processor::id() < PROCESSOR_CACHE_MAX_PROCESSORS;
+}
+
+static void refill_magazine(KmallocMagazine& magazine, size_t chunks)
+{
+    ScopedSpinLock lock(s_lock);
+    // NOTE: Expanding the heap may recursively call kmalloc() and kfree()
+    //       on this processor, so the magazine must be consistent after
+    //       every step, and it may already be fuller than we expect.
+    auto block_size = KmallocHeap::usable_size_for_chunks(chunks);
+    while (magazine.count < PROCESSOR_CACHE_MAGAZINE_SIZE / 2) {
+        void* ptr = g_kmalloc_global->m_heap.allocate(block_size);
+        if (!ptr)
+            break;
+        magazine.blocks[magazine.count++] = ptr;
+    }
+}
+
+static void flush_magazine(KmallocMagazine& magazine)
+{
+    ScopedSpinLock lock(s_lock);
+    while (magazine.count > PROCESSOR_CACHE_MAGAZINE_SIZE / 2)
+        g_kmalloc_global->m_heap.deallocate(magazine.blocks[--magazine.count]);
+}
+
+static void* kmalloc_from_processor_cache(size_t size)
+{
+    auto chunks = KmallocHeap::chunks_needed_for(size);
+    if (chunks > PROCESSOR_CACHE_CLASS_COUNT)
+        return nullptr;
+
+    ScopedCritical critical;
+    auto& cache = s_processor_caches[Processor::id()];
+    auto& magazine = cache.magazines[chunks - 1];
+    ++cache.stats.kmalloc_call_count;
+    if (magazine.count == 0) {
+        ++cache.stats.kmalloc_misses;
+        refill_magazine(magazine, chunks);
+        if (magazine.count == 0)
+            PANIC("kmalloc: Out of memory (requested size: {})", size);
+    } else {
+        ++cache.stats.kmalloc_hits;
+    }
+    void* ptr = magazine.blocks[--magazine.count];
+    __builtin_memset(ptr, KMALLOC_SCRUB_BYTE, KmallocHeap::usable_size_for_chunks(chunks));
+    return ptr;
+}
+
+static bool kfree_to_processor_cache(void* ptr)
+{
+    auto chunks = KmallocHeap::allocation_size_in_chunks(ptr);
+    if (chunks > PROCESSOR_CACHE_CLASS_COUNT)
+        return false;
+
+    ScopedCritical critical;
+    auto& cache = s_processor_caches[Processor::id()];
+    auto& magazine = cache.magazines[chunks - 1];
+    ++cache.stats.kfree_call_count;
+    if (magazine.count == PROCESSOR_CACHE_MAGAZINE_SIZE) {
+        ++cache.stats.kfree_misses;
+        flush_magazine(magazine);
+    } else {
+        ++cache.stats.kfree_hits;
+    }
+    // Leave the allocation header alone, we need it when handing out the block again
+    __builtin_memset(ptr, KFREE_SCRUB_BYTE, KmallocHeap::usable_size_for_chunks(chunks));
+    magazine.blocks[magazine.count++] = ptr;
+    return true;
+}
+
 static void kmalloc_allocate_backup_memory()
 {
     g_kmalloc_global->allocate_backup_memory();
@@ -234,6 +332,11 @@ void* kmalloc_eternal(size_t size)
 
 void* kmalloc(size_t size)
 {
+    if (can_use_processor_cache()) {
+        if (void* ptr = kmalloc_from_processor_cache(size))
+            return ptr;
+    }
+
     ScopedSpinLock lock(s_lock);
     ++g_kmalloc_call_count;
 
@@ -255,6 +358,9 @@ void kfree(void* ptr)
     if (!ptr)
         return;
 
+    if (can_use_processor_cache() && kfree_to_processor_cache(ptr))
+        return;
+
     ScopedSpinLock lock(s_lock);
     ++g_kfree_call_count;
 
@@ -280,9 +386,28 @@ void* operator new[](size_t size)
 void get_kmalloc_stats(kmalloc_stats& stats)
 {
     ScopedSpinLock lock(s_lock);
-    stats.bytes_allocated = g_kmalloc_global->m_heap.allocated_bytes();
-    stats.bytes_free = g_kmalloc_global->m_heap.free_bytes() + g_kmalloc_global->backup_memory_bytes();
+    // Blocks sitting in the processor caches are free as far as the users
+    // of kmalloc are concerned, even though the global heap disagrees.
+    size_t bytes_cached = 0;
+    size_t kmalloc_call_count = g_kmalloc_call_count;
+    size_t kfree_call_count = g_kfree_call_count;
+    for (auto& cache : s_processor_caches) {
+        for (size_t i = 0; i < PROCESSOR_CACHE_CLASS_COUNT; i++)
+            bytes_cached += cache.magazines[i].count * (i + 1) * CHUNK_SIZE;
+        kmalloc_call_count += cache.stats.kmalloc_call_count;
+        kfree_call_count += cache.stats.kfree_call_count;
+    }
+    stats.bytes_allocated = g_kmalloc_global->m_heap.allocated_bytes() - bytes_cached;
+    stats.bytes_free = g_kmalloc_global->m_heap.free_bytes() + g_kmalloc_global->backup_memory_bytes() + bytes_cached;
     stats.bytes_eternal = g_kmalloc_bytes_eternal;
-    stats.kmalloc_call_count = g_kmalloc_call_count;
-    stats.kfree_call_count = g_kfree_call_count;
+    stats.kmalloc_call_count = kmalloc_call_count;
+    stats.kfree_call_count = kfree_call_count;
+}
+
+bool get_kmalloc_processor_cache_stats(u32 cpu, kmalloc_processor_cache_stats& stats)
+{
+    if (cpu >= PROCESSOR_CACHE_MAX_PROCESSORS)
+        return false;
+    stats = s_processor_caches[cpu].stats;
+    return true;
 }
@@ -48,6 +48,16 @@ struct kmalloc_stats {
 };
 void get_kmalloc_stats(kmalloc_stats&);
 
+struct kmalloc_processor_cache_stats {
+    size_t kmalloc_call_count;
+    size_t kmalloc_hits;
+    size_t kmalloc_misses;
+    size_t kfree_call_count;
+    size_t kfree_hits;
+    size_t kfree_misses;
+};
+bool get_kmalloc_processor_cache_stats(u32 cpu, kmalloc_processor_cache_stats&);
+
 extern bool g_dump_kmalloc_stacks;
 
 inline void* operator new(size_t, void* p) { return p; }
@@ -137,6 +137,12 @@ namespace Kernel {
 #define INTERRUPT_TXD_LOW (1 << 15)
 #define INTERRUPT_SRPD (1 << 16)
 
+static constexpr u32 receive_interrupts = INTERRUPT_RXT0 | INTERRUPT_RXO | INTERRUPT_RXDMT0;
+
+// Upper bound on the interrupt rate enforced by the card, so that a busy link doesn't turn
+// into one interrupt per frame.
+static constexpr u32 max_interrupts_per_second = 8000;
+
 // https://www.intel.com/content/dam/doc/manual/pci-pci-x-family-gbe-controllers-software-dev-manual.pdf Section 5.2
 static bool is_valid_device_id(u16 device_id)
 {
@@ -219,13 +225,13 @@ UNMAP_AFTER_INIT E1000NetworkAdapter::E1000NetworkAdapter(PCI::Address address,
     u32 flags = in32(REG_CTRL);
     out32(REG_CTRL, flags | ECTRL_SLU);
 
-    out32(REG_INTERRUPT_RATE, 6000); // Interrupt rate of 1.536 milliseconds
+    // The ITR register holds the minimum interval between interrupts, in units of 256ns.
+    out32(REG_INTERRUPT_RATE, 1'000'000'000 / (max_interrupts_per_second * 256));
 
     initialize_rx_descriptors();
     initialize_tx_descriptors();
 
-    out32(REG_INTERRUPT_MASK_SET, 0x1f6dc);
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0);
+    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | receive_interrupts);
     in32(REG_INTERRUPT_CAUSE_READ);
 
     enable_irq();
@@ -237,26 +243,39 @@ UNMAP_AFTER_INIT E1000NetworkAdapter::~E1000NetworkAdapter()
 
 void E1000NetworkAdapter::handle_irq(const RegisterState&)
 {
-    out32(REG_INTERRUPT_MASK_CLEAR, 0xffffffff);
-
     u32 status = in32(REG_INTERRUPT_CAUSE_READ);
 
     m_entropy_source.add_random_event(status);
 
-    if (status & 4) {
+    if (status & INTERRUPT_LSC) {
         u32 flags = in32(REG_CTRL);
         out32(REG_CTRL, flags | ECTRL_SLU);
     }
-    if (status & 0x80) {
-        receive();
+    if (status & receive_interrupts) {
+        // Stop taking receive interrupts and let the NetworkTask drain the ring instead, for
+        // as long as frames keep arriving. poll_receive() unmasks them once the ring is empty.
+        out32(REG_INTERRUPT_MASK_CLEAR, receive_interrupts);
+        schedule_receive_poll();
     }
-    if (status & 0x10) {
-        // Threshold OK?
+    if (status & INTERRUPT_TXDW) {
+        // Only unmasked while a sender is waiting for a free transmit descriptor.
+        out32(REG_INTERRUPT_MASK_CLEAR, INTERRUPT_TXDW);
+        m_wait_queue.wake_all();
     }
+}
 
-    m_wait_queue.wake_all();
-
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0 | INTERRUPT_RXO);
+size_t E1000NetworkAdapter::poll_receive(size_t budget)
+{
+    size_t received = receive(budget);
+    if (received == budget) {
+        // There may be more where that came from; keep polling.
+        schedule_receive_poll();
+        return received;
+    }
+    // Any frame that arrived after the ring was drained has latched a cause bit, so unmasking
+    // raises the interrupt right away instead of losing the frame.
+    out32(REG_INTERRUPT_MASK_SET, receive_interrupts);
+    return received;
 }
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::detect_eeprom()
@@ -318,11 +337,11 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_rx_descriptors()
     auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
     for (size_t i = 0; i < number_of_rx_descriptors; ++i) {
         auto& descriptor = rx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 RX buffer", Region::Access::Read | Region::Access::Write);
-        VERIFY(region);
-        m_rx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_rx_buffers_regions[i].physical_page(0)->paddr().get();
+        auto buffer = PacketBufferPool::the().try_allocate();
+        VERIFY(buffer);
+        descriptor.addr = buffer->physical_address().get();
         descriptor.status = 0;
+        m_rx_buffers.append(buffer.release_nonnull());
     }
 
     out32(REG_RXDESCLO, m_rx_descriptors_region->physical_page(0)->paddr().get());
@@ -331,18 +350,18 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_rx_descriptors()
     out32(REG_RXDESCHEAD, 0);
     out32(REG_RXDESCTAIL, number_of_rx_descriptors - 1);
 
-    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_8192);
+    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_2048);
 }
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_tx_descriptors()
 {
     auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
+    m_tx_buffers_region = MM.allocate_contiguous_kernel_region(number_of_tx_descriptors * tx_buffer_size, "E1000 TX buffers", Region::Access::Read | Region::Access::Write);
+    VERIFY(m_tx_buffers_region);
+    auto tx_buffers_base = m_tx_buffers_region->physical_page(0)->paddr();
     for (size_t i = 0; i < number_of_tx_descriptors; ++i) {
         auto& descriptor = tx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 TX buffer", Region::Access::Read | Region::Access::Write);
-        VERIFY(region);
-        m_tx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_tx_buffers_regions[i].physical_page(0)->paddr().get();
+        descriptor.addr = tx_buffers_base.offset(i * tx_buffer_size).get();
         descriptor.cmd = 0;
     }
 
@@ -413,53 +432,114 @@ u32 E1000NetworkAdapter::in32(u16 address)
     return m_io_base.offset(address).in<u32>();
 }
 
+void E1000NetworkAdapter::reclaim_tx_descriptors()
+{
+    VERIFY(m_tx_lock.is_locked());
+    auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
+    while (m_tx_free < number_of_tx_descriptors) {
+        auto& descriptor = tx_descriptors[m_tx_clean];
+        if (!(descriptor.status & TSTA_DD))
+            break;
+        descriptor.status = 0;
+        m_tx_clean = (m_tx_clean + 1) % number_of_tx_descriptors;
+        ++m_tx_free;
+    }
+}
+
+void E1000NetworkAdapter::flush_tx_descriptors()
+{
+    VERIFY(m_tx_lock.is_locked());
+    if (!m_tx_flush_pending)
+        return;
+    m_tx_flush_pending = false;
+    out32(REG_TXDESCTAIL, m_tx_tail);
+}
+
+void E1000NetworkAdapter::flush_transmit_queue()
+{
+    ScopedSpinLock lock(m_tx_lock);
+    flush_tx_descriptors();
+}
+
 void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
 {
-    disable_irq();
-    size_t tx_current = in32(REG_TXDESCTAIL) % number_of_tx_descriptors;
+    ScopedSpinLock lock(m_tx_lock);
+    queue_tx_descriptor(payload, lock);
+    flush_tx_descriptors();
+}
+
+void E1000NetworkAdapter::queue_raw(ReadonlyBytes payload)
+{
+    ScopedSpinLock lock(m_tx_lock);
+    queue_tx_descriptor(payload, lock);
+}
+
+void E1000NetworkAdapter::queue_tx_descriptor(ReadonlyBytes payload, ScopedSpinLock<SpinLock<u8>>& lock)
+{
     dbgln_if(E1000_DEBUG, "E1000: Sending packet ({} bytes)", payload.size());
-    auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
-    auto& descriptor = tx_descriptors[tx_current];
-    VERIFY(payload.size() <= 8192);
-    auto* vptr = (void*)m_tx_buffers_regions[tx_current].vaddr().as_ptr();
-    memcpy(vptr, payload.data(), payload.size());
-    descriptor.length = payload.size();
-    descriptor.status = 0;
-    descriptor.cmd = CMD_EOP | CMD_IFCS | CMD_RS;
-    dbgln_if(E1000_DEBUG, "E1000: Using tx descriptor {} (head is at {})", tx_current, in32(REG_TXDESCHEAD));
-    tx_current = (tx_current + 1) % number_of_tx_descriptors;
-    cli();
-    enable_irq();
-    out32(REG_TXDESCTAIL, tx_current);
+    VERIFY(payload.size() <= tx_buffer_size);
+
     for (;;) {
-        if (descriptor.status) {
-            sti();
+        reclaim_tx_descriptors();
+        if (m_tx_free > 0)
             break;
-        }
+        // The ring is full. Make sure the card knows about everything we've queued, and wait for
+        // it to finish sending something.
+        flush_tx_descriptors();
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_TXDW);
+        lock.unlock();
         m_wait_queue.wait_forever("E1000NetworkAdapter");
+        lock.lock();
     }
-    dbgln_if(E1000_DEBUG, "E1000: Sent packet, status is now {:#02x}!", (u8)descriptor.status);
+
+    auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
+    auto& descriptor = tx_descriptors[m_tx_tail];
+    memcpy(m_tx_buffers_region->vaddr().offset(m_tx_tail * tx_buffer_size).as_ptr(), payload.data(), payload.size());
+    descriptor.length = payload.size();
+    descriptor.status = 0;
+    descriptor.cmd = CMD_EOP | CMD_IFCS | CMD_RS;
+    dbgln_if(E1000_DEBUG, "E1000: Using tx descriptor {} (head is at {})", m_tx_tail, in32(REG_TXDESCHEAD));
+    m_tx_tail = (m_tx_tail + 1) % number_of_tx_descriptors;
+    --m_tx_free;
+
+    // The card only picks the frame up once the tail register has been written.
+    m_tx_flush_pending = true;
 }
 
-void E1000NetworkAdapter::receive()
+size_t E1000NetworkAdapter::receive(size_t budget)
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
-    u32 rx_current;
-    for (;;) {
-        rx_current = in32(REG_RXDESCTAIL) % number_of_rx_descriptors;
-        if (rx_current == (in32(REG_RXDESCHEAD) % number_of_rx_descriptors))
-            return;
-        rx_current = (rx_current + 1) % number_of_rx_descriptors;
-        if (!(rx_descriptors[rx_current].status & 1))
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    u32 rx_tail = in32(REG_RXDESCTAIL) % number_of_rx_descriptors;
+    size_t received = 0;
+    while (received < budget) {
+        u32 rx_current = (rx_tail + 1) % number_of_rx_descriptors;
+        auto& descriptor = rx_descriptors[rx_current];
+        if (!(descriptor.status & 1))
             break;
-        auto* buffer = m_rx_buffers_regions[rx_current].vaddr().as_ptr();
-        u16 length = rx_descriptors[rx_current].length;
-        VERIFY(length <= 8192);
-        dbgln_if(E1000_DEBUG, "E1000: Received 1 packet @ {:p} ({} bytes)", buffer, length);
-        did_receive({ buffer, length });
-        rx_descriptors[rx_current].status = 0;
-        out32(REG_RXDESCTAIL, rx_current);
+        u16 length = descriptor.length;
+        VERIFY(length <= PacketBufferPool::buffer_size);
+        dbgln_if(E1000_DEBUG, "E1000: Received 1 packet @ {:p} ({} bytes)", m_rx_buffers[rx_current]->data(), length);
+
+        // Hand the buffer the card wrote into up the stack as-is and give the card a fresh one.
+        // If the pool has run dry, fall back to copying the frame and keep the current buffer.
+        if (auto replacement = PacketBufferPool::the().try_allocate()) {
+            auto received_buffer = replacement.release_nonnull();
+            swap(received_buffer, m_rx_buffers[rx_current]);
+            descriptor.addr = m_rx_buffers[rx_current]->physical_address().get();
+            received_buffer->set_size(length);
+            did_receive_buffer(move(received_buffer));
+        } else {
+            did_receive({ m_rx_buffers[rx_current]->data(), length });
+        }
+        descriptor.status = 0;
+        rx_tail = rx_current;
+        ++received;
     }
+
+    // Give all the descriptors we're done with back to the card at once.
+    if (received)
+        out32(REG_RXDESCTAIL, rx_tail);
+    return received;
 }
 
 }
@@ -26,7 +26,7 @@
 
 #pragma once
 
-#include <AK/NonnullOwnPtrVector.h>
+#include <AK/Atomic.h>
 #include <AK/OwnPtr.h>
 #include <Kernel/IO.h>
 #include <Kernel/Interrupts/IRQHandler.h>
@@ -46,6 +46,8 @@ public:
     virtual ~E1000NetworkAdapter() override;
 
     virtual void send_raw(ReadonlyBytes) override;
+    virtual void queue_raw(ReadonlyBytes) override;
+    virtual void flush_transmit_queue() override;
     virtual bool link_up() override;
 
     virtual const char* purpose() const override { return class_name(); }
@@ -90,23 +92,34 @@ private:
     u16 in16(u16 address);
     u32 in32(u16 address);
 
-    void receive();
+    virtual size_t poll_receive(size_t budget) override;
+    size_t receive(size_t budget);
+
+    void reclaim_tx_descriptors();
+    void flush_tx_descriptors();
+    void queue_tx_descriptor(ReadonlyBytes, ScopedSpinLock<SpinLock<u8>>&);
 
     IOAddress m_io_base;
     VirtualAddress m_mmio_base;
     OwnPtr<Region> m_rx_descriptors_region;
     OwnPtr<Region> m_tx_descriptors_region;
-    NonnullOwnPtrVector<Region> m_rx_buffers_regions;
-    NonnullOwnPtrVector<Region> m_tx_buffers_regions;
+    Vector<NonnullRefPtr<PacketBuffer>> m_rx_buffers;
+    OwnPtr<Region> m_tx_buffers_region;
     OwnPtr<Region> m_mmio_region;
     u8 m_interrupt_line { 0 };
     bool m_has_eeprom { false };
     bool m_use_mmio { false };
     EntropySource m_entropy_source;
 
-    static const size_t number_of_rx_descriptors = 32;
-    static const size_t number_of_tx_descriptors = 8;
+    static const size_t number_of_rx_descriptors = 128;
+    static const size_t number_of_tx_descriptors = 64;
+    static const size_t tx_buffer_size = 2048;
 
+    SpinLock<u8> m_tx_lock;
+    size_t m_tx_tail { 0 };
+    size_t m_tx_clean { 0 };
+    size_t m_tx_free { number_of_tx_descriptors };
+    bool m_tx_flush_pending { false };
     WaitQueue m_wait_queue;
 };
 }
@@ -28,7 +28,9 @@
 
 #include <AK/Assertions.h>
 #include <AK/Endian.h>
+#include <AK/InternetChecksum.h>
 #include <AK/IPv4Address.h>
+#include <AK/Span.h>
 #include <AK/String.h>
 #include <AK/Types.h>
 
@@ -102,6 +104,7 @@ public:
     }
 
     u16 payload_size() const { return m_length - sizeof(IPv4Packet); }
+    ReadonlyBytes bytes() const { return { (const u8*)this, sizeof(IPv4Packet) + payload_size() }; }
 
     NetworkOrdered<u16> compute_checksum() const
     {
@@ -127,17 +130,26 @@ const LogStream& operator<<(const LogStream& stream, const IPv4Packet& packet);
 
 inline NetworkOrdered<u16> internet_checksum(const void* ptr, size_t count)
 {
-    u32 checksum = 0;
-    auto* w = (const u16*)ptr;
-    while (count > 1) {
-        checksum += AK::convert_between_host_and_network_endian(*w++);
-        if (checksum & 0x80000000)
-            checksum = (checksum & 0xffff) | (checksum >> 16);
-        count -= 2;
-    }
-    while (checksum >> 16)
-        checksum = (checksum & 0xffff) + (checksum >> 16);
-    return ~checksum & 0xffff;
+    return InternetChecksum::compute({ (const u8*)ptr, count });
+}
+
+// The checksum used by TCP and UDP, which covers an IPv4 pseudo header followed by the
+// transport header and payload.
+inline u16 compute_ipv4_pseudo_header_checksum(const IPv4Address& source, const IPv4Address& destination, IPv4Protocol protocol, ReadonlyBytes packet)
+{
+    struct [[gnu::packed]] PseudoHeader {
+        IPv4Address source;
+        IPv4Address destination;
+        u8 zero;
+        u8 protocol;
+        NetworkOrdered<u16> length;
+    };
+    PseudoHeader pseudo_header { source, destination, 0, (u8)protocol, (u16)packet.size() };
+
+    InternetChecksum checksum;
+    checksum.add(&pseudo_header, sizeof(pseudo_header));
+    checksum.add(packet);
+    return checksum.finish();
 }
 
 }
@@ -67,6 +67,7 @@ KResultOr<NonnullRefPtr<Socket>> IPv4Socket::create(int type, int protocol)
 
 IPv4Socket::IPv4Socket(int type, int protocol)
     : Socket(AF_INET, type, protocol)
+    , m_receive_buffer(type == SOCK_STREAM ? 256 * KiB : 64 * KiB)
 {
     dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}) created with type={}, protocol={}", this, type, protocol);
     m_buffer_mode = type == SOCK_STREAM ? BufferMode::Bytes : BufferMode::Packets;
@@ -190,9 +191,9 @@ int IPv4Socket::allocate_local_port_if_needed()
     return port;
 }
 
-KResultOr<size_t> IPv4Socket::sendto(FileDescription&, const UserOrKernelBuffer& data, size_t data_length, [[maybe_unused]] int flags, Userspace<const sockaddr*> addr, socklen_t addr_length)
+KResultOr<size_t> IPv4Socket::sendto(FileDescription& description, const UserOrKernelBuffer& data, size_t data_length, [[maybe_unused]] int flags, Userspace<const sockaddr*> addr, socklen_t addr_length)
 {
-    LOCKER(lock());
+    Locker locker(lock());
 
     if (addr && addr_length != sizeof(sockaddr_in))
         return EINVAL;
@@ -231,10 +232,48 @@ KResultOr<size_t> IPv4Socket::sendto(FileDescription&, const UserOrKernelBuffer&
         return data_length;
     }
 
-    auto nsent_or_error = protocol_send(data, data_length);
-    if (!nsent_or_error.is_error())
-        Thread::current()->did_ipv4_socket_write(nsent_or_error.value());
-    return nsent_or_error;
+    if (type() != SOCK_STREAM) {
+        auto nsent_or_error = protocol_send(data, data_length);
+        if (!nsent_or_error.is_error())
+            Thread::current()->did_ipv4_socket_write(nsent_or_error.value());
+        return nsent_or_error;
+    }
+
+    // A stream socket only takes as much as fits into its send buffer, so a blocking
+    // send has to wait for the peer to acknowledge data until all of it has been queued.
+    size_t total_sent = 0;
+    while (total_sent < data_length) {
+        auto nsent_or_error = protocol_send(data.offset(total_sent), data_length - total_sent);
+        if (!nsent_or_error.is_error()) {
+            total_sent += nsent_or_error.value();
+            if (!description.is_blocking())
+                break;
+            continue;
+        }
+        if (nsent_or_error.error().error() != -EAGAIN || !description.is_blocking()) {
+            if (total_sent)
+                break;
+            return nsent_or_error.error();
+        }
+
+        locker.unlock();
+        auto unblocked_flags = BlockFlags::None;
+        auto res = Thread::current()->block<Thread::WriteBlocker>({}, description, unblocked_flags);
+        locker.lock();
+
+        if (!has_flag(unblocked_flags, BlockFlags::Write)) {
+            if (total_sent)
+                break;
+            if (res.was_interrupted())
+                return EINTR;
+
+            // Unblocked due to timeout.
+            return EAGAIN;
+        }
+    }
+    if (total_sent)
+        Thread::current()->did_ipv4_socket_write(total_sent);
+    return total_sent;
 }
 
 KResultOr<size_t> IPv4Socket::receive_byte_buffered(FileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_length, int, Userspace<sockaddr*>, Userspace<socklen_t*>)
@@ -266,6 +305,8 @@ KResultOr<size_t> IPv4Socket::receive_byte_buffered(FileDescription& description
         Thread::current()->did_ipv4_socket_read((size_t)nreceived);
 
     set_can_read(!m_receive_buffer.is_empty());
+    if (nreceived > 0)
+        protocol_did_drain_receive_buffer();
     return nreceived;
 }
 
@@ -289,11 +330,11 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
 
             dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): recvfrom without blocking {} bytes, packets in queue: {}",
                 this,
-                packet.data.value().size(),
+                packet.data.size(),
                 m_receive_queue.size());
         }
     }
-    if (!packet.data.has_value()) {
+    if (!packet.buffer) {
         if (protocol_is_disconnected()) {
             dbgln("IPv4Socket({}) is protocol-disconnected, returning 0 in recvfrom!", this);
             return 0;
@@ -318,10 +359,10 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
 
         dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): recvfrom with blocking {} bytes, packets in queue: {}",
             this,
-            packet.data.value().size(),
+            packet.data.size(),
             m_receive_queue.size());
     }
-    VERIFY(packet.data.has_value());
+    VERIFY(packet.buffer);
 
     packet_timestamp = packet.timestamp;
 
@@ -343,13 +384,13 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
     }
 
     if (type() == SOCK_RAW) {
-        size_t bytes_written = min(packet.data.value().size(), buffer_length);
-        if (!buffer.write(packet.data.value().data(), bytes_written))
+        size_t bytes_written = min(packet.data.size(), buffer_length);
+        if (!buffer.write(packet.data.data(), bytes_written))
             return EFAULT;
         return bytes_written;
     }
 
-    return protocol_receive(ReadonlyBytes { packet.data.value().data(), packet.data.value().size() }, buffer, buffer_length, flags);
+    return protocol_receive(packet.data, buffer, buffer_length, flags);
 }
 
 KResultOr<size_t> IPv4Socket::recvfrom(FileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*> user_addr, Userspace<socklen_t*> user_addr_length, Time& packet_timestamp)
@@ -375,7 +416,7 @@ KResultOr<size_t> IPv4Socket::recvfrom(FileDescription& description, UserOrKerne
     return nreceived;
 }
 
-bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port, KBuffer&& packet, const Time& packet_timestamp)
+bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port, NonnullRefPtr<PacketBuffer> buffer, ReadonlyBytes packet, const Time& packet_timestamp)
 {
     LOCKER(lock());
 
@@ -385,16 +426,15 @@ bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port,
     auto packet_size = packet.size();
 
     if (buffer_mode() == BufferMode::Bytes) {
-        size_t space_in_receive_buffer = m_receive_buffer.space_for_writing();
-        if (packet_size > space_in_receive_buffer) {
-            dbgln("IPv4Socket({}): did_receive refusing packet since buffer is full.", this);
-            VERIFY(m_can_read);
-            return false;
-        }
         auto scratch_buffer = UserOrKernelBuffer::for_kernel_buffer(m_scratch_buffer.value().data());
-        auto nreceived_or_error = protocol_receive(ReadonlyBytes { packet.data(), packet.size() }, scratch_buffer, m_scratch_buffer.value().size(), 0);
+        auto nreceived_or_error = protocol_receive(packet, scratch_buffer, m_scratch_buffer.value().size(), 0);
         if (nreceived_or_error.is_error())
             return false;
+        // Only the payload has to fit, since that's what TCP advertises its receive window for.
+        if (nreceived_or_error.value() > m_receive_buffer.space_for_writing()) {
+            dbgln("IPv4Socket({}): did_receive refusing packet since buffer is full.", this);
+            return false;
+        }
         ssize_t nwritten = m_receive_buffer.write(scratch_buffer, nreceived_or_error.value());
         if (nwritten < 0)
             return false;
@@ -404,7 +444,7 @@ bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port,
             dbgln("IPv4Socket({}): did_receive refusing packet since queue is full.", this);
             return false;
         }
-        m_receive_queue.append({ source_address, source_port, packet_timestamp, move(packet) });
+        m_receive_queue.append({ source_address, source_port, packet_timestamp, move(buffer), packet });
         set_can_read(true);
     }
     m_bytes_received += packet_size;
@@ -455,10 +495,10 @@ String IPv4Socket::absolute_path(const FileDescription&) const
     return builder.to_string();
 }
 
-KResult IPv4Socket::setsockopt(int level, int option, Userspace<const void*> user_value, socklen_t user_value_size)
+KResult IPv4Socket::setsockopt(FileDescription& description, int level, int option, Userspace<const void*> user_value, socklen_t user_value_size)
 {
     if (level != IPPROTO_IP)
-        return Socket::setsockopt(level, option, user_value, user_value_size);
+        return Socket::setsockopt(description, level, option, user_value, user_value_size);
 
     switch (option) {
     case IP_TTL: {
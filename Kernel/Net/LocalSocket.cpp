@@ -173,6 +173,14 @@ KResult LocalSocket::connect(FileDescription& description, Userspace<const socka
     set_connect_side_role(Role::Connecting);
 
     auto peer = m_file->inode()->socket();
+    if (peer->is_local()) {
+        // The accepting side's buffers are shared with our opposite ones, so the larger request wins.
+        auto& listener = static_cast<LocalSocket&>(*peer);
+        if (auto size = listener.m_accepted_send_buffer_size; size.has_value() && size.value() > m_for_client.capacity())
+            m_for_client.set_capacity(size.value());
+        if (auto size = listener.m_accepted_receive_buffer_size; size.has_value() && size.value() > m_for_server.capacity())
+            m_for_server.set_capacity(size.value());
+    }
     auto result = peer->queue_connection_from(*this);
     if (result.is_error()) {
         set_connect_side_role(Role::None);
@@ -282,12 +290,14 @@ KResultOr<size_t> LocalSocket::sendto(FileDescription& description, const UserOr
     if (!socket_buffer)
         return EINVAL;
     ssize_t nwritten = socket_buffer->write(data, data_size);
+    if (nwritten < 0)
+        return KResult((ErrnoCode)-nwritten);
     if (nwritten > 0)
         Thread::current()->did_unix_socket_write(nwritten);
     return nwritten;
 }
 
-DoubleBuffer* LocalSocket::receive_buffer_for(FileDescription& description)
+RingBuffer* LocalSocket::receive_buffer_for(FileDescription& description)
 {
     auto role = this->role(description);
     if (role == Role::Accepted)
@@ -297,7 +307,7 @@ DoubleBuffer* LocalSocket::receive_buffer_for(FileDescription& description)
     return nullptr;
 }
 
-DoubleBuffer* LocalSocket::send_buffer_for(FileDescription& description)
+RingBuffer* LocalSocket::send_buffer_for(FileDescription& description)
 {
     auto role = this->role(description);
     if (role == Role::Connected)
@@ -327,6 +337,8 @@ KResultOr<size_t> LocalSocket::recvfrom(FileDescription& description, UserOrKern
         return 0;
     VERIFY(!socket_buffer->is_empty());
     auto nread = socket_buffer->read(buffer, buffer_size);
+    if (nread < 0)
+        return KResult((ErrnoCode)-nread);
     if (nread > 0)
         Thread::current()->did_unix_socket_read(nread);
     return nread;
@@ -364,6 +376,53 @@ String LocalSocket::absolute_path(const FileDescription& description) const
     return builder.to_string();
 }
 
+RingBuffer* LocalSocket::buffer_for_option(const FileDescription& description, int option)
+{
+    // Until it's connected, a socket's own buffers are the ones of the connecting side.
+    auto role = this->role(description);
+    if (role == Role::Listener)
+        return nullptr;
+    bool is_accept_side = role == Role::Accepted;
+    if (option == SO_SNDBUF)
+        return is_accept_side ? &m_for_client : &m_for_server;
+    VERIFY(option == SO_RCVBUF);
+    return is_accept_side ? &m_for_server : &m_for_client;
+}
+
+KResult LocalSocket::setsockopt(FileDescription& description, int level, int option, Userspace<const void*> user_value, socklen_t user_value_size)
+{
+    if (level != SOL_SOCKET || (option != SO_SNDBUF && option != SO_RCVBUF))
+        return Socket::setsockopt(description, level, option, user_value, user_value_size);
+
+    if (user_value_size < sizeof(int))
+        return EINVAL;
+    int value;
+    if (!copy_from_user(&value, static_ptr_cast<const int*>(user_value)))
+        return EFAULT;
+    if (value <= 0)
+        return EINVAL;
+    // Every byte of it is kernel memory, so ordinary users get the default at most.
+    size_t limit = Process::current()->is_superuser() ? maximum_buffer_size : maximum_unprivileged_buffer_size;
+    size_t size = clamp((size_t)value, minimum_buffer_size, limit);
+
+    // We don't know yet whether this socket is going to connect or listen, so remember
+    // the size for the connections it may accept as well.
+    auto role = this->role(description);
+    if (role == Role::None || role == Role::Listener) {
+        if (option == SO_SNDBUF)
+            m_accepted_send_buffer_size = size;
+        else
+            m_accepted_receive_buffer_size = size;
+    }
+    if (role == Role::Listener)
+        return KSuccess;
+
+    auto* buffer = buffer_for_option(description, option);
+    VERIFY(buffer);
+    buffer->set_capacity(size);
+    return KSuccess;
+}
+
 KResult LocalSocket::getsockopt(FileDescription& description, int level, int option, Userspace<void*> value, Userspace<socklen_t*> value_size)
 {
     if (level != SOL_SOCKET)
@@ -375,9 +434,21 @@ KResult LocalSocket::getsockopt(FileDescription& description, int level, int opt
 
     switch (option) {
     case SO_SNDBUF:
-        TODO();
-    case SO_RCVBUF:
-        TODO();
+    case SO_RCVBUF: {
+        if (size < sizeof(int))
+            return EINVAL;
+        int capacity;
+        if (auto* buffer = buffer_for_option(description, option))
+            capacity = buffer->capacity();
+        else
+            capacity = (option == SO_SNDBUF ? m_accepted_send_buffer_size : m_accepted_receive_buffer_size).value_or(default_buffer_size);
+        if (!copy_to_user(static_ptr_cast<int*>(value), &capacity))
+            return EFAULT;
+        size = sizeof(int);
+        if (!copy_to_user(value_size, &size))
+            return EFAULT;
+        return KSuccess;
+    }
     case SO_PEERCRED: {
         if (size < sizeof(ucred))
             return EINVAL;
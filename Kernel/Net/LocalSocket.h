@@ -27,7 +27,7 @@
 #pragma once
 
 #include <AK/InlineLinkedList.h>
-#include <Kernel/DoubleBuffer.h>
+#include <Kernel/RingBuffer.h>
 #include <Kernel/Net/Socket.h>
 
 namespace Kernel {
@@ -62,6 +62,7 @@ public:
     virtual bool can_write(const FileDescription&, size_t) const override;
     virtual KResultOr<size_t> sendto(FileDescription&, const UserOrKernelBuffer&, size_t, int, Userspace<const sockaddr*>, socklen_t) override;
     virtual KResultOr<size_t> recvfrom(FileDescription&, UserOrKernelBuffer&, size_t, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>, Time&) override;
+    virtual KResult setsockopt(FileDescription&, int level, int option, Userspace<const void*>, socklen_t) override;
     virtual KResult getsockopt(FileDescription&, int level, int option, Userspace<void*>, Userspace<socklen_t*>) override;
     virtual KResult chown(FileDescription&, uid_t, gid_t) override;
     virtual KResult chmod(FileDescription&, mode_t) override;
@@ -72,8 +73,9 @@ private:
     virtual bool is_local() const override { return true; }
     bool has_attached_peer(const FileDescription&) const;
     static Lockable<InlineLinkedList<LocalSocket>>& all_sockets();
-    DoubleBuffer* receive_buffer_for(FileDescription&);
-    DoubleBuffer* send_buffer_for(FileDescription&);
+    RingBuffer* receive_buffer_for(FileDescription&);
+    RingBuffer* send_buffer_for(FileDescription&);
+    RingBuffer* buffer_for_option(const FileDescription&, int option);
     NonnullRefPtrVector<FileDescription>& sendfd_queue_for(const FileDescription&);
     NonnullRefPtrVector<FileDescription>& recvfd_queue_for(const FileDescription&);
 
@@ -110,8 +112,21 @@ private:
     bool m_accept_side_fd_open { false };
     sockaddr_un m_address { 0, { 0 } };
 
-    DoubleBuffer m_for_client;
-    DoubleBuffer m_for_server;
+    // The buffers start out small and grow as needed, up to a limit that
+    // can be changed with SO_SNDBUF and SO_RCVBUF. Only the superuser can
+    // raise it above the default.
+    static constexpr size_t default_buffer_size = 256 * KiB;
+    static constexpr size_t minimum_buffer_size = 4 * KiB;
+    static constexpr size_t maximum_unprivileged_buffer_size = default_buffer_size;
+    static constexpr size_t maximum_buffer_size = 16 * MiB;
+
+    // SO_SNDBUF and SO_RCVBUF set on a listening socket (or on one that later
+    // listens) are applied to the connections it accepts.
+    Optional<size_t> m_accepted_send_buffer_size;
+    Optional<size_t> m_accepted_receive_buffer_size;
+
+    RingBuffer m_for_client { default_buffer_size };
+    RingBuffer m_for_server { default_buffer_size };
 
     NonnullRefPtrVector<FileDescription> m_fds_for_client;
     NonnullRefPtrVector<FileDescription> m_fds_for_server;
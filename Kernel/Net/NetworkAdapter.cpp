@@ -33,6 +33,7 @@
 #include <Kernel/Net/EthernetFrameHeader.h>
 #include <Kernel/Net/LoopbackAdapter.h>
 #include <Kernel/Net/NetworkAdapter.h>
+#include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Process.h>
 #include <Kernel/Random.h>
 #include <Kernel/StdLib.h>
@@ -101,11 +102,22 @@ void NetworkAdapter::send(const MACAddress& destination, const ARPPacket& packet
     send_raw({ (const u8*)eth, size_in_bytes });
 }
 
-KResult NetworkAdapter::send_ipv4(const MACAddress& destination_mac, const IPv4Address& destination_ipv4, IPv4Protocol protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl)
+void NetworkAdapter::transmit(ReadonlyBytes frame, TransmitBatch* batch)
+{
+    if (!batch) {
+        send_raw(frame);
+        return;
+    }
+    VERIFY(&batch->m_adapter == this);
+    queue_raw(frame);
+    batch->m_has_queued_frames = true;
+}
+
+KResult NetworkAdapter::send_ipv4(const MACAddress& destination_mac, const IPv4Address& destination_ipv4, IPv4Protocol protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl, TransmitBatch* batch)
 {
     size_t ipv4_packet_size = sizeof(IPv4Packet) + payload_size;
     if (ipv4_packet_size > mtu())
-        return send_ipv4_fragmented(destination_mac, destination_ipv4, protocol, payload, payload_size, ttl);
+        return send_ipv4_fragmented(destination_mac, destination_ipv4, protocol, payload, payload_size, ttl, batch);
 
     size_t ethernet_frame_size = sizeof(EthernetFrameHeader) + sizeof(IPv4Packet) + payload_size;
     auto buffer = ByteBuffer::create_zeroed(ethernet_frame_size);
@@ -128,11 +140,11 @@ KResult NetworkAdapter::send_ipv4(const MACAddress& destination_mac, const IPv4A
 
     if (!payload.read(ipv4.payload(), payload_size))
         return EFAULT;
-    send_raw({ (const u8*)&eth, ethernet_frame_size });
+    transmit({ (const u8*)&eth, ethernet_frame_size }, batch);
     return KSuccess;
 }
 
-KResult NetworkAdapter::send_ipv4_fragmented(const MACAddress& destination_mac, const IPv4Address& destination_ipv4, IPv4Protocol protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl)
+KResult NetworkAdapter::send_ipv4_fragmented(const MACAddress& destination_mac, const IPv4Address& destination_ipv4, IPv4Protocol protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl, TransmitBatch* batch)
 {
     // packets must be split on the 64-bit boundary
     auto packet_boundary_size = (mtu() - sizeof(IPv4Packet) - sizeof(EthernetFrameHeader)) & 0xfffffff8;
@@ -143,6 +155,10 @@ KResult NetworkAdapter::send_ipv4_fragmented(const MACAddress& destination_mac,
     auto identification = get_good_random<u16>();
 
     size_t ethernet_frame_size = mtu();
+    // Submit all fragments at once, unless the caller is already collecting frames.
+    TransmitBatch local_batch(*this);
+    if (!batch)
+        batch = &local_batch;
     for (size_t packet_index = 0; packet_index < fragment_block_count; ++packet_index) {
         auto is_last_block = packet_index + 1 == fragment_block_count;
         auto packet_payload_size = is_last_block ? last_block_size : packet_boundary_size;
@@ -167,54 +183,50 @@ KResult NetworkAdapter::send_ipv4_fragmented(const MACAddress& destination_mac,
         m_bytes_out += ethernet_frame_size;
         if (!payload.read(ipv4.payload(), packet_index * packet_boundary_size, packet_payload_size))
             return EFAULT;
-        send_raw({ (const u8*)&eth, ethernet_frame_size });
+        transmit({ (const u8*)&eth, ethernet_frame_size }, batch);
     }
     return KSuccess;
 }
 
 void NetworkAdapter::did_receive(ReadonlyBytes payload)
 {
-    InterruptDisabler disabler;
-    m_packets_in++;
-    m_bytes_in += payload.size();
-
-    Optional<KBuffer> buffer;
-
-    if (m_unused_packet_buffers.is_empty()) {
-        buffer = KBuffer::copy(payload.data(), payload.size());
-    } else {
-        buffer = m_unused_packet_buffers.take_first();
-        --m_unused_packet_buffers_count;
-        if (payload.size() <= buffer.value().capacity()) {
-            memcpy(buffer.value().data(), payload.data(), payload.size());
-            buffer.value().set_size(payload.size());
-        } else {
-            buffer = KBuffer::copy(payload.data(), payload.size());
-        }
+    auto buffer = PacketBufferPool::the().try_create_with_copy(payload);
+    if (!buffer) {
+        ScopedSpinLock lock(m_packet_queue_lock);
+        m_packets_dropped++;
+        return;
     }
+    did_receive_buffer(buffer.release_nonnull());
+}
 
-    m_packet_queue.append({ buffer.value(), kgettimeofday() });
+void NetworkAdapter::did_receive_buffer(NonnullRefPtr<PacketBuffer> packet)
+{
+    {
+        ScopedSpinLock lock(m_packet_queue_lock);
+        m_packets_in++;
+        m_bytes_in += packet->size();
+        m_packet_queue.append({ move(packet), kgettimeofday() });
+    }
 
     if (on_receive)
         on_receive();
 }
 
-size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, Time& packet_timestamp)
+void NetworkAdapter::schedule_receive_poll()
 {
-    InterruptDisabler disabler;
+    if (m_receive_poll_requested.exchange(true, AK::MemoryOrder::memory_order_acq_rel))
+        return;
+    NetworkTask::wake();
+}
+
+RefPtr<PacketBuffer> NetworkAdapter::dequeue_packet(Time& packet_timestamp)
+{
+    ScopedSpinLock lock(m_packet_queue_lock);
     if (m_packet_queue.is_empty())
-        return 0;
+        return {};
     auto packet_with_timestamp = m_packet_queue.take_first();
     packet_timestamp = packet_with_timestamp.timestamp;
-    auto packet = move(packet_with_timestamp.packet);
-    size_t packet_size = packet.size();
-    VERIFY(packet_size <= buffer_size);
-    memcpy(buffer, packet.data(), packet_size);
-    if (m_unused_packet_buffers_count < 100) {
-        m_unused_packet_buffers.append(packet);
-        ++m_unused_packet_buffers_count;
-    }
-    return packet_size;
+    return move(packet_with_timestamp.packet);
 }
 
 void NetworkAdapter::set_ipv4_address(const IPv4Address& address)
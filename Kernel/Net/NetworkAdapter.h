@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <AK/ByteBuffer.h>
 #include <AK/Function.h>
 #include <AK/MACAddress.h>
@@ -37,6 +38,8 @@
 #include <Kernel/Net/ARP.h>
 #include <Kernel/Net/ICMP.h>
 #include <Kernel/Net/IPv4.h>
+#include <Kernel/Net/PacketBuffer.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/UserOrKernelBuffer.h>
 
 namespace Kernel {
@@ -64,12 +67,17 @@ public:
     void set_ipv4_gateway(const IPv4Address&);
 
     void send(const MACAddress&, const ARPPacket&);
-    KResult send_ipv4(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
-    KResult send_ipv4_fragmented(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
+    class TransmitBatch;
+    KResult send_ipv4(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl, TransmitBatch* = nullptr);
+    KResult send_ipv4_fragmented(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl, TransmitBatch* = nullptr);
 
-    size_t dequeue_packet(u8* buffer, size_t buffer_size, Time& packet_timestamp);
+    RefPtr<PacketBuffer> dequeue_packet(Time& packet_timestamp);
 
-    bool has_queued_packets() const { return !m_packet_queue.is_empty(); }
+    bool has_queued_packets() const
+    {
+        ScopedSpinLock lock(m_packet_queue_lock);
+        return !m_packet_queue.is_empty();
+    }
 
     u32 mtu() const { return m_mtu; }
     void set_mtu(u32 mtu) { m_mtu = mtu; }
@@ -78,36 +86,79 @@ public:
     u32 bytes_in() const { return m_bytes_in; }
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
+    u32 packets_dropped() const { return m_packets_dropped; }
 
     Function<void()> on_receive;
 
+    // Adapters that mask their receive interrupt under load ask the NetworkTask to poll them
+    // instead. poll_receive() handles at most budget frames and returns how many it handled;
+    // once it comes in under budget, the adapter should unmask its interrupt again.
+    bool take_receive_poll_request() { return m_receive_poll_requested.exchange(false, AK::MemoryOrder::memory_order_acq_rel); }
+    virtual size_t poll_receive(size_t) { return 0; }
+
+    // Collects the frames one caller sends through it (e.g. all TCP segments that fit into the
+    // window), so that adapters which can queue up several frames only have to hand them to the
+    // hardware once, when the batch goes out of scope. Frames sent by anyone else are unaffected.
+    class TransmitBatch {
+        AK_MAKE_NONCOPYABLE(TransmitBatch);
+        AK_MAKE_NONMOVABLE(TransmitBatch);
+
+    public:
+        explicit TransmitBatch(NetworkAdapter& adapter)
+            : m_adapter(adapter)
+        {
+        }
+        ~TransmitBatch()
+        {
+            if (m_has_queued_frames)
+                m_adapter.flush_transmit_queue();
+        }
+
+    private:
+        friend class NetworkAdapter;
+
+        NetworkAdapter& m_adapter;
+        bool m_has_queued_frames { false };
+    };
+
 protected:
     NetworkAdapter();
     void set_interface_name(const StringView& basename);
     void set_mac_address(const MACAddress& mac_address) { m_mac_address = mac_address; }
     virtual void send_raw(ReadonlyBytes) = 0;
+    // Queues a frame without making the hardware pick it up yet, flush_transmit_queue() submits
+    // everything queued so far. Adapters that can't hold frames back just send them right away.
+    virtual void queue_raw(ReadonlyBytes payload) { send_raw(payload); }
+    virtual void flush_transmit_queue() { }
     void did_receive(ReadonlyBytes);
+    void did_receive_buffer(NonnullRefPtr<PacketBuffer>);
+    void schedule_receive_poll();
 
 private:
+    void transmit(ReadonlyBytes, TransmitBatch*);
+
     MACAddress m_mac_address;
     IPv4Address m_ipv4_address;
     IPv4Address m_ipv4_netmask;
     IPv4Address m_ipv4_gateway;
 
     struct PacketWithTimestamp {
-        KBuffer packet;
+        NonnullRefPtr<PacketBuffer> packet;
         Time timestamp;
     };
 
+    // The interrupt handler queues frames and the NetworkTask takes them, possibly on
+    // different CPUs. This also protects the receive counters.
+    mutable SpinLock<u8> m_packet_queue_lock;
     SinglyLinkedList<PacketWithTimestamp> m_packet_queue;
-    SinglyLinkedList<KBuffer> m_unused_packet_buffers;
-    size_t m_unused_packet_buffers_count { 0 };
     String m_name;
     u32 m_packets_in { 0 };
     u32 m_bytes_in { 0 };
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
+    u32 m_packets_dropped { 0 };
     u32 m_mtu { 1500 };
+    Atomic<bool> m_receive_poll_requested { false };
 };
 
 }
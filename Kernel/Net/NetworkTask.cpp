@@ -24,6 +24,9 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Atomic.h>
+#include <AK/HashFunctions.h>
+#include <AK/SinglyLinkedList.h>
 #include <Kernel/Debug.h>
 #include <Kernel/Lock.h>
 #include <Kernel/Net/ARP.h>
@@ -40,16 +43,49 @@
 #include <Kernel/Net/UDP.h>
 #include <Kernel/Net/UDPSocket.h>
 #include <Kernel/Process.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/WaitQueue.h>
 
 namespace Kernel {
 
 static void handle_arp(const EthernetFrameHeader&, size_t frame_size);
-static void handle_ipv4(const EthernetFrameHeader&, size_t frame_size, const Time& packet_timestamp);
-static void handle_icmp(const EthernetFrameHeader&, const IPv4Packet&, const Time& packet_timestamp);
-static void handle_udp(const IPv4Packet&, const Time& packet_timestamp);
-static void handle_tcp(const IPv4Packet&, const Time& packet_timestamp);
+static void handle_ipv4(PacketBuffer&, const EthernetFrameHeader&, size_t frame_size, const Time& packet_timestamp);
+static void handle_icmp(PacketBuffer&, const EthernetFrameHeader&, const IPv4Packet&, const Time& packet_timestamp);
+static void handle_udp(PacketBuffer&, const IPv4Packet&, const Time& packet_timestamp);
+static void handle_tcp(PacketBuffer&, const IPv4Packet&, const Time& packet_timestamp);
+
+static void handle_frame(PacketBuffer&, const Time& packet_timestamp);
 
 [[noreturn]] static void NetworkTask_main(void*);
+[[noreturn]] static void NetworkTask_worker(void*);
+
+// Received frames are spread across one worker thread per CPU (up to a limit). Frames are
+// assigned to workers by hashing their flow, so packets of one connection are always
+// handled in order by the same worker while unrelated flows are handled in parallel.
+static constexpr size_t max_receive_workers = 8;
+static constexpr size_t max_queued_frames_per_worker = 1024;
+
+// The maximum number of frames taken from one adapter per poll before giving others a turn.
+static constexpr size_t receive_poll_budget = 64;
+
+struct ReceivedFrame {
+    NonnullRefPtr<NetworkAdapter> adapter;
+    NonnullRefPtr<PacketBuffer> buffer;
+    Time timestamp;
+};
+
+struct ReceiveWorker {
+    SpinLock<u8> lock;
+    SinglyLinkedList<ReceivedFrame> queue;
+    size_t queue_size { 0 };
+    u32 dropped_frames { 0 };
+    WaitQueue wait_queue;
+};
+
+static ReceiveWorker* s_receive_workers;
+// Published only once s_receive_workers is set up, since wake() and the interrupt
+// handlers can run on other CPUs at any time.
+static Atomic<size_t> s_receive_worker_count;
 
 void NetworkTask::spawn()
 {
@@ -57,11 +93,73 @@ void NetworkTask::spawn()
     Process::create_kernel_process(thread, "NetworkTask", NetworkTask_main, nullptr);
 }
 
+void NetworkTask::wake()
+{
+    // Timers, adapter polling and other deferred work are handled by the first worker.
+    if (s_receive_worker_count.load(AK::MemoryOrder::memory_order_acquire))
+        s_receive_workers[0].wait_queue.wake_all();
+}
+
+static u32 flow_hash(ReadonlyBytes frame)
+{
+    if (frame.size() < sizeof(EthernetFrameHeader) + sizeof(IPv4Packet))
+        return 0;
+    auto& eth = *(const EthernetFrameHeader*)frame.data();
+    if (eth.ether_type() != EtherType::IPv4)
+        return 0;
+    auto& ipv4 = *(const IPv4Packet*)eth.payload();
+    u32 hash = pair_int_hash(ipv4.source().to_u32(), ipv4.destination().to_u32());
+    hash = pair_int_hash(hash, ipv4.protocol());
+
+    // Only the first fragment of a datagram carries the ports, so keep fragments together
+    // by hashing on the addresses only.
+    bool has_ports = ipv4.protocol() == (u8)IPv4Protocol::TCP || ipv4.protocol() == (u8)IPv4Protocol::UDP;
+    if (has_ports && !ipv4.is_a_fragment() && frame.size() >= sizeof(EthernetFrameHeader) + sizeof(IPv4Packet) + sizeof(u32)) {
+        auto* ports = (const u8*)ipv4.payload();
+        hash = pair_int_hash(hash, (ports[0] << 24) | (ports[1] << 16) | (ports[2] << 8) | ports[3]);
+    }
+    return hash;
+}
+
+static void steer_received_frames(NetworkAdapter& adapter)
+{
+    // Called from the adapter's interrupt handler.
+    size_t worker_count = s_receive_worker_count.load(AK::MemoryOrder::memory_order_acquire);
+    Time timestamp;
+    for (;;) {
+        auto buffer = adapter.dequeue_packet(timestamp);
+        if (!buffer)
+            break;
+        auto& worker = s_receive_workers[flow_hash(buffer->bytes()) % worker_count];
+        ScopedSpinLock lock(worker.lock);
+        if (worker.queue_size >= max_queued_frames_per_worker) {
+            worker.dropped_frames++;
+            continue;
+        }
+        worker.queue.append({ adapter, buffer.release_nonnull(), timestamp });
+        worker.queue_size++;
+        lock.unlock();
+        worker.wait_queue.wake_all();
+    }
+}
+
+static void poll_adapters()
+{
+    NetworkAdapter::for_each([](auto& adapter) {
+        if (!adapter.take_receive_poll_request())
+            return;
+        // An adapter that used up its budget asks to be polled again right away.
+        adapter.poll_receive(receive_poll_budget);
+    });
+}
+
 void NetworkTask_main(void*)
 {
-    WaitQueue packet_wait_queue;
+    size_t worker_count = clamp<size_t>(Processor::count(), 1, max_receive_workers);
+    s_receive_workers = new ReceiveWorker[worker_count];
+    s_receive_worker_count.store(worker_count, AK::MemoryOrder::memory_order_release);
+
     u8 octet = 15;
-    int pending_packets = 0;
     NetworkAdapter::for_each([&](auto& adapter) {
         if (String(adapter.class_name()) == "LoopbackAdapter") {
             adapter.set_ipv4_address({ 127, 0, 0, 1 });
@@ -75,83 +173,96 @@ void NetworkTask_main(void*)
 
         klog() << "NetworkTask: " << adapter.class_name() << " network adapter found: hw=" << adapter.mac_address().to_string().characters() << " address=" << adapter.ipv4_address().to_string().characters() << " netmask=" << adapter.ipv4_netmask().to_string().characters() << " gateway=" << adapter.ipv4_gateway().to_string().characters();
 
-        adapter.on_receive = [&]() {
-            pending_packets++;
-            packet_wait_queue.wake_all();
+        adapter.on_receive = [&adapter]() {
+            steer_received_frames(adapter);
         };
     });
 
-    auto dequeue_packet = [&pending_packets](u8* buffer, size_t buffer_size, Time& packet_timestamp) -> size_t {
-        if (pending_packets == 0)
-            return 0;
-        size_t packet_size = 0;
-        NetworkAdapter::for_each([&](auto& adapter) {
-            if (packet_size || !adapter.has_queued_packets())
-                return;
-            packet_size = adapter.dequeue_packet(buffer, buffer_size, packet_timestamp);
-            pending_packets--;
-#if NETWORK_TASK_DEBUG
-            klog() << "NetworkTask: Dequeued packet from " << adapter.name().characters() << " (" << packet_size << " bytes)";
-#endif
-        });
-        return packet_size;
-    };
+    for (size_t i = 1; i < worker_count; ++i) {
+        auto name = String::formatted("NetworkTask #{}", i);
+        Process::current()->create_kernel_thread(NetworkTask_worker, (void*)i, THREAD_PRIORITY_NORMAL, name, 1u << i, false);
+    }
 
-    size_t buffer_size = 64 * KiB;
-    auto buffer_region = MM.allocate_kernel_region(buffer_size, "Kernel Packet Buffer", Region::Access::Read | Region::Access::Write);
-    auto buffer = (u8*)buffer_region->vaddr().get();
-    Time packet_timestamp;
+    klog() << "NetworkTask: Enter main loop with " << worker_count << " receive worker(s).";
+    NetworkTask_worker((void*)0);
+}
 
-    klog() << "NetworkTask: Enter main loop.";
+void NetworkTask_worker(void* data)
+{
+    auto index = (size_t)data;
+    auto& worker = s_receive_workers[index];
     for (;;) {
-        size_t packet_size = dequeue_packet(buffer, buffer_size, packet_timestamp);
-        if (!packet_size) {
-            packet_wait_queue.wait_forever("NetworkTask");
-            continue;
+        if (index == 0) {
+            TCPSocket::handle_expired_retransmission_timers();
+            poll_adapters();
+        }
+
+        Optional<ReceivedFrame> frame;
+        {
+            ScopedSpinLock lock(worker.lock);
+            if (!worker.queue.is_empty()) {
+                frame = worker.queue.take_first();
+                worker.queue_size--;
+            }
         }
-        if (packet_size < sizeof(EthernetFrameHeader)) {
-            klog() << "NetworkTask: Packet is too small to be an Ethernet packet! (" << packet_size << ")";
+        if (!frame.has_value()) {
+            worker.wait_queue.wait_forever("NetworkTask");
             continue;
         }
-        auto& eth = *(const EthernetFrameHeader*)buffer;
+
+#if NETWORK_TASK_DEBUG
+        klog() << "NetworkTask #" << index << ": Dequeued packet from " << frame->adapter->name().characters() << " (" << frame->buffer->size() << " bytes)";
+#endif
+        handle_frame(frame->buffer, frame->timestamp);
+    }
+}
+
+void handle_frame(PacketBuffer& frame, const Time& packet_timestamp)
+{
+    auto* buffer = frame.data();
+    auto packet_size = frame.size();
+    if (packet_size < sizeof(EthernetFrameHeader)) {
+        klog() << "NetworkTask: Packet is too small to be an Ethernet packet! (" << packet_size << ")";
+        return;
+    }
+    auto& eth = *(const EthernetFrameHeader*)buffer;
 #if ETHERNET_DEBUG
-        dbgln("NetworkTask: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), packet_size);
+    dbgln("NetworkTask: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), packet_size);
 #endif
 
 #if ETHERNET_VERY_DEBUG
-        for (size_t i = 0; i < packet_size; i++) {
-            klog() << String::format("%#02x", buffer[i]);
-
-            switch (i % 16) {
-            case 7:
-                klog() << "  ";
-                break;
-            case 15:
-                klog() << "";
-                break;
-            default:
-                klog() << " ";
-                break;
-            }
-        }
-
-        klog() << "";
-#endif
+    for (size_t i = 0; i < packet_size; i++) {
+        klog() << String::format("%#02x", buffer[i]);
 
-        switch (eth.ether_type()) {
-        case EtherType::ARP:
-            handle_arp(eth, packet_size);
-            break;
-        case EtherType::IPv4:
-            handle_ipv4(eth, packet_size, packet_timestamp);
+        switch (i % 16) {
+        case 7:
+            klog() << "  ";
             break;
-        case EtherType::IPv6:
-            // ignore
+        case 15:
+            klog() << "";
             break;
         default:
-            klog() << "NetworkTask: Unknown ethernet type 0x" << String::format("%x", eth.ether_type());
+            klog() << " ";
+            break;
         }
     }
+
+    klog() << "";
+#endif
+
+    switch (eth.ether_type()) {
+    case EtherType::ARP:
+        handle_arp(eth, packet_size);
+        break;
+    case EtherType::IPv4:
+        handle_ipv4(frame, eth, packet_size, packet_timestamp);
+        break;
+    case EtherType::IPv6:
+        // ignore
+        break;
+    default:
+        klog() << "NetworkTask: Unknown ethernet type 0x" << String::format("%x", eth.ether_type());
+    }
 }
 
 void handle_arp(const EthernetFrameHeader& eth, size_t frame_size)
@@ -205,7 +316,7 @@ void handle_arp(const EthernetFrameHeader& eth, size_t frame_size)
     }
 }
 
-void handle_ipv4(const EthernetFrameHeader& eth, size_t frame_size, const Time& packet_timestamp)
+void handle_ipv4(PacketBuffer& frame, const EthernetFrameHeader& eth, size_t frame_size, const Time& packet_timestamp)
 {
     constexpr size_t minimum_ipv4_frame_size = sizeof(EthernetFrameHeader) + sizeof(IPv4Packet);
     if (frame_size < minimum_ipv4_frame_size) {
@@ -231,18 +342,18 @@ void handle_ipv4(const EthernetFrameHeader& eth, size_t frame_size, const Time&
 
     switch ((IPv4Protocol)packet.protocol()) {
     case IPv4Protocol::ICMP:
-        return handle_icmp(eth, packet, packet_timestamp);
+        return handle_icmp(frame, eth, packet, packet_timestamp);
     case IPv4Protocol::UDP:
-        return handle_udp(packet, packet_timestamp);
+        return handle_udp(frame, packet, packet_timestamp);
     case IPv4Protocol::TCP:
-        return handle_tcp(packet, packet_timestamp);
+        return handle_tcp(frame, packet, packet_timestamp);
     default:
         klog() << "handle_ipv4: Unhandled protocol " << packet.protocol();
         break;
     }
 }
 
-void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
+void handle_icmp(PacketBuffer& frame, const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
 {
     auto& icmp_header = *static_cast<const ICMPHeader*>(ipv4_packet.payload());
 #if ICMP_DEBUG
@@ -260,7 +371,7 @@ void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet,
             }
         }
         for (auto& socket : icmp_sockets)
-            socket.did_receive(ipv4_packet.source(), 0, KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
+            socket.did_receive(ipv4_packet.source(), 0, frame, ipv4_packet.bytes(), packet_timestamp);
     }
 
     auto adapter = NetworkAdapter::from_ipv4_address(ipv4_packet.destination());
@@ -290,7 +401,7 @@ void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet,
     }
 }
 
-void handle_udp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
+void handle_udp(PacketBuffer& frame, const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
 {
     if (ipv4_packet.payload_size() < sizeof(UDPPacket)) {
         klog() << "handle_udp: Packet too small (" << ipv4_packet.payload_size() << ", need " << sizeof(UDPPacket) << ")";
@@ -316,10 +427,10 @@ void handle_udp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
 
     VERIFY(socket->type() == SOCK_DGRAM);
     VERIFY(socket->local_port() == udp_packet.destination_port());
-    socket->did_receive(ipv4_packet.source(), udp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
+    socket->did_receive(ipv4_packet.source(), udp_packet.source_port(), frame, ipv4_packet.bytes(), packet_timestamp);
 }
 
-void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
+void handle_tcp(PacketBuffer& frame, const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
 {
     if (ipv4_packet.payload_size() < sizeof(TCPPacket)) {
         klog() << "handle_tcp: IPv4 payload is too small to be a TCP packet (" << ipv4_packet.payload_size() << ", need " << sizeof(TCPPacket) << ")";
@@ -430,6 +541,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
 #endif
             client->set_sequence_number(1000);
             client->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+            client->process_syn_options(tcp_packet);
             [[maybe_unused]] auto rc2 = client->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
             client->set_state(TCPSocket::State::SynReceived);
             return;
@@ -524,6 +636,9 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            // We may still be waiting for queued data and our FIN to be acknowledged.
+            if (tcp_packet.ack_number() != socket->sequence_number())
+                return;
             socket->set_state(TCPSocket::State::Closed);
             return;
         default:
@@ -536,6 +651,8 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            if (tcp_packet.ack_number() != socket->sequence_number())
+                return;
             socket->set_state(TCPSocket::State::FinWait2);
             return;
         case TCPFlags::FIN:
@@ -567,6 +684,8 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            if (tcp_packet.ack_number() != socket->sequence_number())
+                return;
             socket->set_state(TCPSocket::State::TimeWait);
             return;
         default:
@@ -576,10 +695,22 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             return;
         }
     case TCPSocket::State::Established:
-        if (tcp_packet.has_fin()) {
-            if (payload_size != 0)
-                socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
+        if ((payload_size != 0 || tcp_packet.has_fin()) && tcp_packet.sequence_number() != socket->ack_number()) {
+            // Out of order, or a retransmission of something we already have. Tell the peer what
+            // we are actually expecting; repeated ACKs like this one trigger its fast retransmit.
+            if (payload_size != 0 && !tcp_packet.has_fin())
+                socket->queue_out_of_order_segment(tcp_packet.sequence_number(), payload_size, frame, ipv4_packet.bytes(), packet_timestamp);
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
 
+        if (payload_size != 0 && !socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), frame, ipv4_packet.bytes(), packet_timestamp)) {
+            // No room for it; re-announce our current window.
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
+
+        if (tcp_packet.has_fin()) {
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
             socket->set_state(TCPSocket::State::CloseWait);
@@ -587,15 +718,15 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             return;
         }
 
-        socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+        if (payload_size) {
+            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            socket->deliver_out_of_order_segments();
 
 #if TCP_DEBUG
-        klog() << "Got packet with ack_no=" << tcp_packet.ack_number() << ", seq_no=" << tcp_packet.sequence_number() << ", payload_size=" << payload_size << ", acking it with new ack_no=" << socket->ack_number() << ", seq_no=" << socket->sequence_number();
+            klog() << "Got packet with ack_no=" << tcp_packet.ack_number() << ", seq_no=" << tcp_packet.sequence_number() << ", payload_size=" << payload_size << ", acking it with new ack_no=" << socket->ack_number() << ", seq_no=" << socket->sequence_number();
 #endif
 
-        if (payload_size) {
-            if (socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp))
-                unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
         }
     }
 }
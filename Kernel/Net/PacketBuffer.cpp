@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/Heap/kmalloc.h>
+#include <Kernel/Net/PacketBuffer.h>
+#include <Kernel/StdLib.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+static AK::Singleton<PacketBufferPool> s_the;
+
+PacketBufferPool& PacketBufferPool::the()
+{
+    return *s_the;
+}
+
+PacketBuffer::PacketBuffer(u8* data, size_t capacity, PhysicalAddress physical_address, bool pooled)
+    : m_data(data)
+    , m_capacity(capacity)
+    , m_physical_address(physical_address)
+    , m_pooled(pooled)
+{
+}
+
+PacketBuffer::~PacketBuffer()
+{
+    VERIFY(!m_pooled);
+    kfree(m_data);
+}
+
+void PacketBuffer::did_drop_last_reference()
+{
+    PacketBufferPool::the().return_to_pool(*this);
+}
+
+PacketBufferPool::PacketBufferPool()
+{
+    static_assert(PAGE_SIZE % buffer_size == 0);
+    m_region = MM.allocate_contiguous_kernel_region(buffer_size * buffer_count, "Packet buffers", Region::Access::Read | Region::Access::Write);
+    if (!m_region) {
+        dmesgln("PacketBufferPool: Could not allocate packet buffers, falling back to the heap");
+        return;
+    }
+    auto base_address = m_region->physical_page(0)->paddr();
+    for (size_t i = buffer_count; i > 0; --i) {
+        size_t offset = (i - 1) * buffer_size;
+        auto* buffer = new PacketBuffer(m_region->vaddr().offset(offset).as_ptr(), buffer_size, base_address.offset(offset), true);
+        buffer->m_next_free = m_free_list;
+        m_free_list = buffer;
+    }
+    m_total_buffers = buffer_count;
+    m_free_buffers = buffer_count;
+}
+
+RefPtr<PacketBuffer> PacketBufferPool::try_allocate()
+{
+    ScopedSpinLock lock(m_lock);
+    if (!m_free_list) {
+        m_allocation_failures++;
+        return {};
+    }
+    auto* buffer = m_free_list;
+    m_free_list = buffer->m_next_free;
+    buffer->m_next_free = nullptr;
+    buffer->m_ref_count.store(1, AK::memory_order_release);
+    buffer->m_size = 0;
+    m_free_buffers--;
+    m_allocations++;
+    m_peak_buffers_in_use = max(m_peak_buffers_in_use, m_total_buffers - m_free_buffers);
+    return adopt(*buffer);
+}
+
+RefPtr<PacketBuffer> PacketBufferPool::try_create_with_copy(ReadonlyBytes bytes)
+{
+    RefPtr<PacketBuffer> buffer;
+    if (bytes.size() <= buffer_size)
+        buffer = try_allocate();
+
+    if (!buffer)
+        buffer = try_allocate_from_heap(bytes.size());
+    if (!buffer)
+        return {};
+
+    memcpy(buffer->data(), bytes.data(), bytes.size());
+    buffer->set_size(bytes.size());
+    return buffer;
+}
+
+RefPtr<PacketBuffer> PacketBufferPool::try_allocate_from_heap(size_t size)
+{
+    {
+        ScopedSpinLock lock(m_lock);
+        m_heap_allocations++;
+        PacketBuffer* previous = nullptr;
+        for (auto* buffer = m_heap_cache; buffer; previous = buffer, buffer = buffer->m_next_free) {
+            if (buffer->capacity() < size)
+                continue;
+            if (previous)
+                previous->m_next_free = buffer->m_next_free;
+            else
+                m_heap_cache = buffer->m_next_free;
+            m_heap_cache_size--;
+            buffer->m_next_free = nullptr;
+            buffer->m_ref_count.store(1, AK::memory_order_release);
+            return adopt(*buffer);
+        }
+    }
+
+    // Round up so that a cached buffer is likely to fit the next packet of a similar size.
+    size_t capacity = round_up_to_power_of_two(size, buffer_size);
+    auto* data = (u8*)kmalloc(capacity);
+    if (!data)
+        return {};
+    return adopt(*new PacketBuffer(data, capacity, {}, false));
+}
+
+void PacketBufferPool::return_to_pool(PacketBuffer& buffer)
+{
+    if (!buffer.is_pooled()) {
+        {
+            ScopedSpinLock lock(m_lock);
+            if (m_heap_cache_size < max_heap_cache_size) {
+                buffer.m_next_free = m_heap_cache;
+                m_heap_cache = &buffer;
+                m_heap_cache_size++;
+                return;
+            }
+        }
+        delete &buffer;
+        return;
+    }
+
+    ScopedSpinLock lock(m_lock);
+    buffer.m_next_free = m_free_list;
+    m_free_list = &buffer;
+    m_free_buffers++;
+}
+
+PacketBufferPoolStatistics PacketBufferPool::statistics() const
+{
+    ScopedSpinLock lock(m_lock);
+    PacketBufferPoolStatistics statistics;
+    statistics.buffer_size = buffer_size;
+    statistics.total_buffers = m_total_buffers;
+    statistics.free_buffers = m_free_buffers;
+    statistics.peak_buffers_in_use = m_peak_buffers_in_use;
+    statistics.allocations = m_allocations;
+    statistics.allocation_failures = m_allocation_failures;
+    statistics.heap_allocations = m_heap_allocations;
+    return statistics;
+}
+
+}
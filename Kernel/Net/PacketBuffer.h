@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/Span.h>
+#include <Kernel/PhysicalAddress.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/VM/Region.h>
+
+namespace Kernel {
+
+class PacketBufferPool;
+
+// A refcounted buffer holding one received frame. Most buffers come from a preallocated,
+// physically contiguous pool so that network adapters can DMA straight into them, and the
+// same buffer is then handed by reference all the way from the driver to the sockets.
+class PacketBuffer {
+    AK_MAKE_NONCOPYABLE(PacketBuffer);
+    AK_MAKE_NONMOVABLE(PacketBuffer);
+    friend class PacketBufferPool;
+
+public:
+    void ref()
+    {
+        m_ref_count.fetch_add(1, AK::memory_order_acq_rel);
+    }
+
+    void unref()
+    {
+        if (m_ref_count.fetch_sub(1, AK::memory_order_acq_rel) == 1)
+            did_drop_last_reference();
+    }
+
+    u8* data() { return m_data; }
+    const u8* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    ReadonlyBytes bytes() const { return { m_data, m_size }; }
+
+    void set_size(size_t size)
+    {
+        VERIFY(size <= m_capacity);
+        m_size = size;
+    }
+
+    bool is_pooled() const { return m_pooled; }
+    PhysicalAddress physical_address() const
+    {
+        VERIFY(m_pooled);
+        return m_physical_address;
+    }
+
+private:
+    PacketBuffer(u8* data, size_t capacity, PhysicalAddress, bool pooled);
+    ~PacketBuffer();
+
+    void did_drop_last_reference();
+
+    Atomic<u32> m_ref_count { 1 };
+    u8* m_data { nullptr };
+    size_t m_size { 0 };
+    size_t m_capacity { 0 };
+    PhysicalAddress m_physical_address;
+    bool m_pooled { false };
+    PacketBuffer* m_next_free { nullptr };
+};
+
+struct PacketBufferPoolStatistics {
+    size_t buffer_size { 0 };
+    size_t total_buffers { 0 };
+    size_t free_buffers { 0 };
+    size_t peak_buffers_in_use { 0 };
+    u64 allocations { 0 };
+    u64 allocation_failures { 0 };
+    u64 heap_allocations { 0 };
+};
+
+class PacketBufferPool {
+public:
+    static constexpr size_t buffer_size = 2048;
+    static constexpr size_t buffer_count = 512;
+
+    static PacketBufferPool& the();
+
+    PacketBufferPool();
+
+    // Returns a buffer from the pool, or null if the pool is exhausted.
+    RefPtr<PacketBuffer> try_allocate();
+
+    // Copies the given frame into a pool buffer, falling back to the heap if the frame doesn't
+    // fit into one or the pool is exhausted.
+    RefPtr<PacketBuffer> try_create_with_copy(ReadonlyBytes);
+
+    PacketBufferPoolStatistics statistics() const;
+
+private:
+    friend class PacketBuffer;
+
+    // Frames that don't fit into a pool buffer (e.g. on the loopback adapter) are stored in
+    // heap buffers instead. A few of those are kept around for reuse.
+    static constexpr size_t max_heap_cache_size = 16;
+
+    RefPtr<PacketBuffer> try_allocate_from_heap(size_t);
+    void return_to_pool(PacketBuffer&);
+
+    OwnPtr<Region> m_region;
+    mutable SpinLock<u8> m_lock;
+    PacketBuffer* m_free_list { nullptr };
+    PacketBuffer* m_heap_cache { nullptr };
+    size_t m_heap_cache_size { 0 };
+    size_t m_total_buffers { 0 };
+    size_t m_free_buffers { 0 };
+    size_t m_peak_buffers_in_use { 0 };
+    u64 m_allocations { 0 };
+    u64 m_allocation_failures { 0 };
+    u64 m_heap_allocations { 0 };
+};
+
+}
@@ -41,6 +41,15 @@ struct TCPFlags {
     };
 };
 
+enum class TCPOptionKind : u8 {
+    End = 0,
+    NoOperation = 1,
+    MaximumSegmentSize = 2,
+    WindowScale = 3,
+    SACKPermitted = 4,
+    SACK = 5,
+};
+
 class [[gnu::packed]] TCPPacket {
 public:
     TCPPacket() = default;
@@ -80,6 +89,35 @@ public:
     u16 urgent() const { return m_urgent; }
     void set_urgent(u16 urgent) { m_urgent = urgent; }
 
+    const u8* options() const { return ((const u8*)this) + sizeof(TCPPacket); }
+    u8* options() { return ((u8*)this) + sizeof(TCPPacket); }
+    size_t options_size() const { return header_size() > sizeof(TCPPacket) ? header_size() - sizeof(TCPPacket) : 0; }
+
+    // Calls callback(kind, data, length) for every well-formed option, where data/length
+    // describe the bytes after the kind and length octets.
+    template<typename Callback>
+    void for_each_option(Callback callback) const
+    {
+        auto* options = this->options();
+        size_t size = options_size();
+        for (size_t i = 0; i < size;) {
+            auto kind = (TCPOptionKind)options[i];
+            if (kind == TCPOptionKind::End)
+                return;
+            if (kind == TCPOptionKind::NoOperation) {
+                ++i;
+                continue;
+            }
+            if (i + 1 >= size)
+                return;
+            u8 length = options[i + 1];
+            if (length < 2 || i + length > size)
+                return;
+            callback(kind, options + i + 2, (size_t)length - 2);
+            i += length;
+        }
+    }
+
     const void* payload() const { return ((const u8*)this) + header_size(); }
     void* payload() { return ((u8*)this) + header_size(); }
 
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/NumericLimits.h>
+#include <Kernel/Net/TCPCongestionControl.h>
+
+namespace Kernel {
+
+TCPCongestionControl::TCPCongestionControl(u32 maximum_segment_size)
+    : m_maximum_segment_size(maximum_segment_size)
+    , m_slow_start_threshold(NumericLimits<u32>::max())
+{
+    // RFC 6928: IW = min(10 * MSS, max(2 * MSS, 14600))
+    m_congestion_window = min(10 * maximum_segment_size, max(2 * maximum_segment_size, 14600u));
+}
+
+// RFC 5681 slow start and congestion avoidance, with the RFC 6582 (NewReno)
+// modification to fast recovery.
+class TCPNewReno final : public TCPCongestionControl {
+public:
+    explicit TCPNewReno(u32 maximum_segment_size)
+        : TCPCongestionControl(maximum_segment_size)
+    {
+    }
+
+    virtual const char* name() const override { return "newreno"; }
+
+    virtual void on_ack(u32 bytes_acked) override
+    {
+        if (is_in_slow_start()) {
+            m_congestion_window += min(bytes_acked, m_maximum_segment_size);
+            return;
+        }
+        // Grow by roughly one MSS per round trip, counting acknowledged bytes
+        // so that stretch ACKs are not penalized.
+        m_bytes_acked_in_avoidance += bytes_acked;
+        if (m_bytes_acked_in_avoidance >= m_congestion_window) {
+            m_bytes_acked_in_avoidance -= m_congestion_window;
+            m_congestion_window += m_maximum_segment_size;
+        }
+    }
+
+    virtual void on_enter_fast_recovery(u32 bytes_in_flight) override
+    {
+        reduce_slow_start_threshold(bytes_in_flight);
+        m_congestion_window = m_slow_start_threshold + 3 * m_maximum_segment_size;
+    }
+
+    virtual void on_duplicate_ack_in_fast_recovery() override
+    {
+        m_congestion_window += m_maximum_segment_size;
+    }
+
+    virtual void on_partial_ack(u32 bytes_acked) override
+    {
+        // Deflate by the amount of new data acknowledged, then add back one
+        // MSS for the segment that is being retransmitted.
+        m_congestion_window -= min(bytes_acked, m_congestion_window);
+        m_congestion_window += m_maximum_segment_size;
+    }
+
+    virtual void on_exit_fast_recovery(u32 bytes_in_flight) override
+    {
+        m_congestion_window = min(m_slow_start_threshold, max(bytes_in_flight, m_maximum_segment_size) + m_maximum_segment_size);
+    }
+
+    virtual void on_retransmission_timeout(u32 bytes_in_flight) override
+    {
+        reduce_slow_start_threshold(bytes_in_flight);
+        m_congestion_window = m_maximum_segment_size;
+    }
+
+private:
+    void reduce_slow_start_threshold(u32 bytes_in_flight)
+    {
+        m_slow_start_threshold = max(bytes_in_flight / 2, 2 * m_maximum_segment_size);
+        m_bytes_acked_in_avoidance = 0;
+    }
+
+    u32 m_bytes_acked_in_avoidance { 0 };
+};
+
+NonnullOwnPtr<TCPCongestionControl> TCPCongestionControl::create(Algorithm algorithm, u32 maximum_segment_size)
+{
+    switch (algorithm) {
+    case Algorithm::NewReno:
+        return make<TCPNewReno>(maximum_segment_size);
+    }
+    VERIFY_NOT_REACHED();
+}
+
+}
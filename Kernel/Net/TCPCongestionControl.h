@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Types.h>
+
+namespace Kernel {
+
+// The congestion controller only decides how large the congestion window is.
+// TCPSocket owns the segment queue and decides what to (re)transmit, and tells
+// the controller about every event that should change the window.
+class TCPCongestionControl {
+public:
+    enum class Algorithm {
+        NewReno,
+    };
+
+    static NonnullOwnPtr<TCPCongestionControl> create(Algorithm, u32 maximum_segment_size);
+    virtual ~TCPCongestionControl() = default;
+
+    virtual const char* name() const = 0;
+
+    u32 congestion_window() const { return m_congestion_window; }
+    u32 slow_start_threshold() const { return m_slow_start_threshold; }
+    bool is_in_slow_start() const { return m_congestion_window < m_slow_start_threshold; }
+
+    // New data was cumulatively acknowledged outside of fast recovery.
+    virtual void on_ack(u32 bytes_acked) = 0;
+
+    // The third duplicate ACK arrived and the first unacknowledged segment is being resent.
+    virtual void on_enter_fast_recovery(u32 bytes_in_flight) = 0;
+    virtual void on_duplicate_ack_in_fast_recovery() = 0;
+    virtual void on_partial_ack(u32 bytes_acked) = 0;
+    virtual void on_exit_fast_recovery(u32 bytes_in_flight) = 0;
+
+    virtual void on_retransmission_timeout(u32 bytes_in_flight) = 0;
+
+protected:
+    explicit TCPCongestionControl(u32 maximum_segment_size);
+
+    u32 m_maximum_segment_size { 0 };
+    u32 m_congestion_window { 0 };
+    u32 m_slow_start_threshold { 0 };
+};
+
+}
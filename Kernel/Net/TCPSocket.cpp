@@ -29,15 +29,67 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/RandomDevice.h>
 #include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Net/EthernetFrameHeader.h>
 #include <Kernel/Net/NetworkAdapter.h>
+#include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Net/Routing.h>
 #include <Kernel/Net/TCP.h>
 #include <Kernel/Net/TCPSocket.h>
 #include <Kernel/Process.h>
 #include <Kernel/Random.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/TimerQueue.h>
 
 namespace Kernel {
 
+static inline bool sequence_is_before(u32 a, u32 b)
+{
+    return static_cast<i32>(a - b) < 0;
+}
+
+static inline u32 read_u32_network_order(const u8* data)
+{
+    return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | data[3];
+}
+
+static inline void write_u32_network_order(u8* data, u32 value)
+{
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+// Retransmission timers fire in a deferred interrupt context where we can't take the
+// socket lock, so they just queue the socket up for the NetworkTask to deal with.
+static SpinLock<u8> s_sockets_with_expired_timers_lock;
+static AK::Singleton<Vector<WeakPtr<TCPSocket>>> s_sockets_with_expired_timers;
+
+static void queue_socket_with_expired_timer(const WeakPtr<TCPSocket>& socket)
+{
+    {
+        ScopedSpinLock lock(s_sockets_with_expired_timers_lock);
+        s_sockets_with_expired_timers->append(socket);
+    }
+    NetworkTask::wake();
+}
+
+void TCPSocket::handle_expired_retransmission_timers()
+{
+    Vector<WeakPtr<TCPSocket>> sockets;
+    {
+        ScopedSpinLock lock(s_sockets_with_expired_timers_lock);
+        sockets = move(*s_sockets_with_expired_timers);
+    }
+    for (auto& weak_socket : sockets) {
+        auto socket = weak_socket.strong_ref();
+        if (!socket)
+            continue;
+        LOCKER(socket->lock());
+        socket->retransmission_timer_did_fire();
+    }
+}
+
 void TCPSocket::for_each(Function<void(const TCPSocket&)> callback)
 {
     LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
@@ -57,6 +109,9 @@ void TCPSocket::set_state(State new_state)
     if (new_state == State::Established && m_direction == Direction::Outgoing)
         m_role = Role::Connected;
 
+    if (new_state == State::Established && !m_congestion_control)
+        m_congestion_control = TCPCongestionControl::create(TCPCongestionControl::Algorithm::NewReno, maximum_segment_size());
+
     if (new_state == State::Closed) {
         LOCKER(closing_sockets().lock());
         closing_sockets().resource().remove(tuple());
@@ -147,10 +202,15 @@ void TCPSocket::release_for_accept(RefPtr<TCPSocket> socket)
 TCPSocket::TCPSocket(int protocol)
     : IPv4Socket(SOCK_STREAM, protocol)
 {
+    while ((receive_buffer_capacity() >> m_receive_window_scale) > NumericLimits<u16>::max() && m_receive_window_scale < max_window_scale)
+        ++m_receive_window_scale;
 }
 
 TCPSocket::~TCPSocket()
 {
+    if (m_retransmission_timer)
+        TimerQueue::the().cancel_timer(m_retransmission_timer.release_nonnull());
+
     LOCKER(sockets_by_tuple().lock());
     sockets_by_tuple().resource().remove(tuple());
 
@@ -176,24 +236,92 @@ KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, Use
 
 KResultOr<size_t> TCPSocket::protocol_send(const UserOrKernelBuffer& data, size_t data_length)
 {
-    int err = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &data, data_length);
-    if (err < 0)
-        return KResult((ErrnoCode)-err);
-    return data_length;
+    size_t length = min(data_length, send_buffer_space());
+    if (!length)
+        return EAGAIN;
+
+    size_t segment_size = maximum_segment_size();
+    for (size_t offset = 0; offset < length; offset += segment_size) {
+        auto segment = data.offset(offset);
+        auto result = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &segment, min(segment_size, length - offset));
+        if (result.is_error()) {
+            if (offset)
+                return offset;
+            return result;
+        }
+    }
+    return length;
+}
+
+size_t TCPSocket::send_buffer_space() const
+{
+    size_t queued = m_sequence_number - m_send_unacknowledged;
+    if (queued >= send_buffer_size)
+        return 0;
+    return send_buffer_size - queued;
+}
+
+bool TCPSocket::can_write(const FileDescription& description, size_t size) const
+{
+    return IPv4Socket::can_write(description, size) && send_buffer_space() > 0;
+}
+
+u16 TCPSocket::advertised_window_size(bool is_syn)
+{
+    // The window in a SYN segment is never scaled (RFC 7323 section 2.2).
+    u8 scale = (is_syn || !m_window_scaling_enabled) ? 0 : m_receive_window_scale;
+    u16 window_size = min(receive_buffer_space() >> scale, (size_t)NumericLimits<u16>::max());
+    m_advertised_window_edge = m_ack_number + ((u32)window_size << scale);
+    return window_size;
 }
 
 KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, size_t payload_size)
 {
-    const size_t buffer_size = sizeof(TCPPacket) + payload_size;
+    u8 options[40] {};
+    size_t options_size = 0;
+    if (flags & TCPFlags::SYN) {
+        auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+        if (!routing_decision.is_zero())
+            m_local_maximum_segment_size = routing_decision.adapter->mtu() - sizeof(EthernetFrameHeader) - sizeof(IPv4Packet) - sizeof(TCPPacket);
+
+        options[0] = (u8)TCPOptionKind::MaximumSegmentSize;
+        options[1] = 4;
+        options[2] = m_local_maximum_segment_size >> 8;
+        options[3] = m_local_maximum_segment_size & 0xff;
+        options_size = 4;
+
+        // Only offer window scaling in a SYN/ACK if the peer offered it first.
+        if (!(flags & TCPFlags::ACK) || m_window_scaling_enabled) {
+            options[4] = (u8)TCPOptionKind::NoOperation;
+            options[5] = (u8)TCPOptionKind::WindowScale;
+            options[6] = 3;
+            options[7] = m_receive_window_scale;
+            options_size = 8;
+        }
+
+        if (!(flags & TCPFlags::ACK) || m_sack_enabled) {
+            options[options_size++] = (u8)TCPOptionKind::NoOperation;
+            options[options_size++] = (u8)TCPOptionKind::NoOperation;
+            options[options_size++] = (u8)TCPOptionKind::SACKPermitted;
+            options[options_size++] = 2;
+        }
+    } else if ((flags & TCPFlags::ACK) && m_sack_enabled && !m_out_of_order_segments.is_empty()) {
+        options_size = write_sack_option(options);
+    }
+
+    const size_t header_size = sizeof(TCPPacket) + options_size;
+    const size_t buffer_size = header_size + payload_size;
+    const bool occupies_sequence_space = (flags & (TCPFlags::SYN | TCPFlags::FIN)) || payload_size > 0;
     auto buffer = ByteBuffer::create_zeroed(buffer_size);
     auto& tcp_packet = *(TCPPacket*)(buffer.data());
     VERIFY(local_port());
     tcp_packet.set_source_port(local_port());
     tcp_packet.set_destination_port(peer_port());
-    tcp_packet.set_window_size(1024);
-    tcp_packet.set_sequence_number(m_sequence_number);
-    tcp_packet.set_data_offset(sizeof(TCPPacket) / sizeof(u32));
+    tcp_packet.set_window_size(advertised_window_size(flags & TCPFlags::SYN));
+    tcp_packet.set_sequence_number(occupies_sequence_space ? m_sequence_number : m_send_next);
+    tcp_packet.set_data_offset(header_size / sizeof(u32));
     tcp_packet.set_flags(flags);
+    memcpy(tcp_packet.options(), options, options_size);
 
     if (flags & TCPFlags::ACK)
         tcp_packet.set_ack_number(m_ack_number);
@@ -201,15 +329,13 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
     if (payload && !payload->read(tcp_packet.payload(), payload_size))
         return EFAULT;
 
-    if (flags & TCPFlags::SYN) {
+    if (flags & (TCPFlags::SYN | TCPFlags::FIN))
         ++m_sequence_number;
-    } else {
-        m_sequence_number += payload_size;
-    }
+    m_sequence_number += payload_size;
 
     tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
 
-    if (tcp_packet.has_syn() || payload_size > 0) {
+    if (occupies_sequence_space) {
         LOCKER(m_not_acked_lock);
         m_not_acked.append({ m_sequence_number, move(buffer) });
         send_outgoing_packets();
@@ -236,18 +362,42 @@ void TCPSocket::send_outgoing_packets()
     auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
     VERIFY(!routing_decision.is_zero());
 
-    auto now = kgettimeofday();
+    auto now = TimeManagement::the().monotonic_time();
+
+    LOCKER(m_not_acked_lock);
+    // Let the adapter submit all of the segments that fit into the window at once.
+    NetworkAdapter::TransmitBatch batch(*routing_decision.adapter);
+    u32 send_window = m_peer_window;
+    if (m_congestion_control)
+        send_window = min(send_window, m_congestion_control->congestion_window());
 
-    LOCKER(m_not_acked_lock, Lock::Mode::Shared);
     for (auto& packet : m_not_acked) {
-        auto diff = now - packet.tx_time;
-        if (diff <= Time::from_nanoseconds(500'000'000))
+        auto& tcp_packet = *(TCPPacket*)(packet.buffer.data());
+        if (sequence_is_before(m_send_next, packet.ack_number)) {
+            // Not sent yet (or being sent again after a timeout); only send it if both the peer
+            // and the network have room for it. SYN and FIN segments carry no payload and are
+            // always let through.
+            size_t payload_size = packet.buffer.size() - tcp_packet.header_size();
+            u32 bytes_in_flight = m_send_next - m_send_unacknowledged;
+            if (payload_size > 0 && bytes_in_flight + payload_size > send_window)
+                break;
+            m_send_next = packet.ack_number;
+            if (sequence_is_before(m_send_maximum, m_send_next))
+                m_send_maximum = m_send_next;
+        } else if (packet.needs_retransmission) {
+            packet.needs_retransmission = false;
+        } else {
             continue;
+        }
+        if (packet.tx_counter > 0)
+            m_retransmissions++;
         packet.tx_time = now;
         packet.tx_counter++;
 
+        if (tcp_packet.has_ack() && !tcp_packet.has_syn())
+            refresh_acknowledgement(tcp_packet);
+
         if constexpr (TCP_SOCKET_DEBUG) {
-            auto& tcp_packet = *(const TCPPacket*)(packet.buffer.data());
             dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
                 local_address(), local_port(),
                 peer_address(), peer_port(),
@@ -263,9 +413,8 @@ void TCPSocket::send_outgoing_packets()
         auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(packet.buffer.data());
         int err = routing_decision.adapter->send_ipv4(
             routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
-            packet_buffer, packet.buffer.size(), ttl());
+            packet_buffer, packet.buffer.size(), ttl(), &batch);
         if (err < 0) {
-            auto& tcp_packet = *(const TCPPacket*)(packet.buffer.data());
             dmesgln("Error ({}) sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
                 err,
                 local_address(),
@@ -284,76 +433,511 @@ void TCPSocket::send_outgoing_packets()
             m_bytes_out += packet.buffer.size();
         }
     }
+
+    if (m_send_next != m_send_unacknowledged) {
+        if (m_is_probing_window) {
+            // The window has opened up again.
+            m_is_probing_window = false;
+            m_retransmission_deadline = {};
+        }
+        if (m_retransmission_deadline.is_zero())
+            restart_retransmission_timer();
+    } else if (m_send_next != m_sequence_number) {
+        // Nothing is in flight, but the peer's window keeps us from sending what's queued.
+        // If its window update gets lost we'd wait forever, so keep probing it (RFC 1122 4.2.2.17).
+        arm_persist_timer();
+    }
+}
+
+void TCPSocket::update_rtt(u64 sample_us)
+{
+    // Jacobson/Karels estimator as specified in RFC 6298 section 2.
+    if (!m_has_rtt_sample) {
+        m_smoothed_rtt_us = sample_us;
+        m_rtt_variance_us = sample_us / 2;
+        m_has_rtt_sample = true;
+    } else {
+        u64 delta = m_smoothed_rtt_us > sample_us ? m_smoothed_rtt_us - sample_us : sample_us - m_smoothed_rtt_us;
+        m_rtt_variance_us = (3 * m_rtt_variance_us + delta) / 4;
+        m_smoothed_rtt_us = (7 * m_smoothed_rtt_us + sample_us) / 8;
+    }
+    u64 timeout = m_smoothed_rtt_us + max(4 * m_rtt_variance_us, (u64)1000);
+    m_retransmission_timeout_us = min(max(timeout, min_retransmission_timeout_us), max_retransmission_timeout_us);
+}
+
+void TCPSocket::restart_retransmission_timer()
+{
+    m_retransmission_deadline = TimeManagement::the().monotonic_time() + Time::from_microseconds(m_retransmission_timeout_us);
+    schedule_retransmission_timer();
+}
+
+void TCPSocket::schedule_retransmission_timer()
+{
+    // Restarting the timer on every ACK only moves the deadline; an already queued timer
+    // notices that when it fires and gets rescheduled for the new deadline.
+    if (m_retransmission_timer)
+        return;
+    auto weak_this = make_weak_ptr<TCPSocket>();
+    m_retransmission_timer = TimerQueue::the().add_timer_without_id(CLOCK_MONOTONIC_COARSE, m_retransmission_deadline, [weak_this]() {
+        queue_socket_with_expired_timer(weak_this);
+    });
+    if (!m_retransmission_timer)
+        queue_socket_with_expired_timer(weak_this);
+}
+
+void TCPSocket::retransmission_timer_did_fire()
+{
+    m_retransmission_timer = nullptr;
+    if (m_retransmission_deadline.is_zero())
+        return;
+    if (TimeManagement::the().monotonic_time() < m_retransmission_deadline) {
+        schedule_retransmission_timer();
+        return;
+    }
+
+    if (m_is_probing_window) {
+        m_retransmission_deadline = {};
+        send_window_probe();
+        m_persist_timeout_us = min(m_persist_timeout_us * 2, max_retransmission_timeout_us);
+        arm_persist_timer();
+        return;
+    }
+
+    LOCKER(m_not_acked_lock);
+    m_retransmission_deadline = {};
+    if (m_not_acked.is_empty())
+        return;
+
+    if (m_peer_window == 0) {
+        // The peer dropped what we sent for lack of room, not because the network lost it.
+        // Don't back off or shrink the congestion window, just wait for the window to open.
+        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): retransmission timeout with a zero window, probing from {}", this, m_send_unacknowledged);
+        for (auto& packet : m_not_acked)
+            packet.needs_retransmission = false;
+        m_send_next = m_send_unacknowledged;
+        send_outgoing_packets();
+        return;
+    }
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): retransmission timeout ({} us), resending from {}", this, m_retransmission_timeout_us, m_send_unacknowledged);
+
+    m_retransmission_timeouts++;
+    m_retransmission_timeout_us = min(m_retransmission_timeout_us * 2, max_retransmission_timeout_us);
+    if (m_congestion_control)
+        m_congestion_control->on_retransmission_timeout(m_send_next - m_send_unacknowledged);
+    m_in_fast_recovery = false;
+    m_duplicate_ack_count = 0;
+
+    // Go back to the first unacknowledged segment and forget what the peer SACKed, since
+    // it is allowed to discard out-of-order data (RFC 2018 section 8).
+    for (auto& packet : m_not_acked) {
+        packet.is_sacked = false;
+        packet.needs_retransmission = false;
+    }
+    m_has_sacked_data = false;
+    m_send_next = m_send_unacknowledged;
+
+    send_outgoing_packets();
+}
+
+void TCPSocket::arm_persist_timer()
+{
+    if (!m_is_probing_window) {
+        m_is_probing_window = true;
+        m_persist_timeout_us = m_retransmission_timeout_us;
+    } else if (!m_retransmission_deadline.is_zero()) {
+        return;
+    }
+    m_retransmission_deadline = TimeManagement::the().monotonic_time() + Time::from_microseconds(m_persist_timeout_us);
+    schedule_retransmission_timer();
+}
+
+void TCPSocket::send_window_probe()
+{
+    LOCKER(m_not_acked_lock);
+    OutgoingPacket* next_packet = nullptr;
+    for (auto& packet : m_not_acked) {
+        if (sequence_is_before(m_send_next, packet.ack_number)) {
+            next_packet = &packet;
+            break;
+        }
+    }
+    if (!next_packet)
+        return;
+
+    // The probe is the start of the next segment: as much of it as the peer claims to have room
+    // for, but at least one byte. If it's accepted, the rest of the segment gets trimmed on ACK.
+    auto& next_tcp_packet = *(const TCPPacket*)(next_packet->buffer.data());
+    size_t header_size = next_tcp_packet.header_size();
+    size_t payload_size = next_packet->buffer.size() - header_size;
+    if (!payload_size)
+        return;
+    size_t probe_payload_size = clamp((size_t)m_peer_window, (size_t)1, payload_size);
+    auto buffer = ByteBuffer::copy(next_packet->buffer.data(), header_size + probe_payload_size);
+    auto& tcp_packet = *(TCPPacket*)(buffer.data());
+    tcp_packet.set_ack_number(m_ack_number);
+    tcp_packet.set_window_size(advertised_window_size(false));
+    tcp_packet.set_checksum(0);
+    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, probe_payload_size));
+
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return;
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): probing window with {} bytes at {}", this, probe_payload_size, tcp_packet.sequence_number());
+
+    auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer.data());
+    auto result = routing_decision.adapter->send_ipv4(
+        routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
+        packet_buffer, buffer.size(), ttl());
+    if (result.is_error())
+        return;
+
+    u32 probe_end = tcp_packet.sequence_number() + probe_payload_size;
+    if (sequence_is_before(m_send_maximum, probe_end))
+        m_send_maximum = probe_end;
+    m_window_probes++;
+    m_packets_out++;
+    m_bytes_out += buffer.size();
+}
+
+void TCPSocket::trim_acknowledged_payload(OutgoingPacket& packet)
+{
+    auto& tcp_packet = *(const TCPPacket*)(packet.buffer.data());
+    if (!sequence_is_before(tcp_packet.sequence_number(), m_send_unacknowledged))
+        return;
+    size_t header_size = tcp_packet.header_size();
+    size_t payload_size = packet.buffer.size() - header_size;
+    size_t acknowledged_size = m_send_unacknowledged - tcp_packet.sequence_number();
+    if (acknowledged_size >= payload_size)
+        return;
+
+    auto buffer = ByteBuffer::create_uninitialized(packet.buffer.size() - acknowledged_size);
+    memcpy(buffer.data(), packet.buffer.data(), header_size);
+    memcpy(buffer.data() + header_size, packet.buffer.data() + header_size + acknowledged_size, payload_size - acknowledged_size);
+    auto& trimmed_tcp_packet = *(TCPPacket*)(buffer.data());
+    trimmed_tcp_packet.set_sequence_number(m_send_unacknowledged);
+    trimmed_tcp_packet.set_checksum(0);
+    trimmed_tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), trimmed_tcp_packet, payload_size - acknowledged_size));
+    packet.buffer = move(buffer);
 }
 
 void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
 {
+    if (packet.has_syn() && m_state == State::SynSent)
+        process_syn_options(packet);
+
     if (packet.has_ack()) {
         u32 ack_number = packet.ack_number();
 
         dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", ack_number);
 
-        int removed = 0;
+        auto previous_peer_window = m_peer_window;
+        u8 scale = (packet.has_syn() || !m_window_scaling_enabled) ? 0 : m_peer_window_scale;
+        m_peer_window = (u32)packet.window_size() << scale;
+
         LOCKER(m_not_acked_lock);
-        while (!m_not_acked.is_empty()) {
-            auto& packet = m_not_acked.first();
+        if (m_sack_enabled)
+            process_sack_option(packet);
+
+        if (sequence_is_before(m_send_unacknowledged, ack_number) && !sequence_is_before(m_send_maximum, ack_number)) {
+            u32 bytes_acked = ack_number - m_send_unacknowledged;
+            m_send_unacknowledged = ack_number;
+            if (sequence_is_before(m_send_next, ack_number))
+                m_send_next = ack_number;
+
+            int removed = 0;
+            Optional<Time> rtt_sample_tx_time;
+            while (!m_not_acked.is_empty()) {
+                auto& packet = m_not_acked.first();
+
+                dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
+
+                if (!sequence_is_before(ack_number, packet.ack_number)) {
+                    // Karn's algorithm: only segments that were sent exactly once give a usable RTT sample.
+                    if (packet.tx_counter == 1)
+                        rtt_sample_tx_time = packet.tx_time;
+                    m_not_acked.take_first();
+                    removed++;
+                } else {
+                    break;
+                }
+            }
+
+            dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+
+            // An accepted window probe leaves the start of the next segment acknowledged.
+            if (!m_not_acked.is_empty())
+                trim_acknowledged_payload(m_not_acked.first());
 
-            dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
+            if (rtt_sample_tx_time.has_value())
+                update_rtt((TimeManagement::the().monotonic_time() - rtt_sample_tx_time.value()).to_microseconds());
 
-            if (packet.ack_number <= ack_number) {
-                m_not_acked.take_first();
-                removed++;
+            if (m_send_unacknowledged == m_send_maximum) {
+                m_retransmission_deadline = {};
+                m_has_sacked_data = false;
             } else {
-                break;
+                restart_retransmission_timer();
             }
+
+            did_acknowledge(ack_number, bytes_acked);
+            evaluate_block_conditions();
+        } else if (ack_number == m_send_unacknowledged && m_send_next != m_send_unacknowledged
+            && size == packet.header_size() && !packet.has_syn() && !packet.has_fin()
+            && m_peer_window == previous_peer_window) {
+            did_receive_duplicate_ack();
         }
 
-        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+        if (!m_not_acked.is_empty())
+            send_outgoing_packets();
     }
 
     m_packets_in++;
     m_bytes_in += packet.header_size() + size;
 }
 
-NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket& packet, u16 payload_size)
+void TCPSocket::did_acknowledge(u32 ack_number, u32 bytes_acked)
+{
+    m_duplicate_ack_count = 0;
+    if (!m_congestion_control)
+        return;
+
+    if (!m_in_fast_recovery) {
+        m_congestion_control->on_ack(bytes_acked);
+        return;
+    }
+
+    if (!sequence_is_before(ack_number, m_recovery_point)) {
+        m_in_fast_recovery = false;
+        m_congestion_control->on_exit_fast_recovery(m_send_next - m_send_unacknowledged);
+        return;
+    }
+
+    // A partial ACK means that the segment after the acknowledged data was lost too (RFC 6582).
+    m_congestion_control->on_partial_ack(bytes_acked);
+    mark_next_hole_for_retransmission();
+}
+
+void TCPSocket::did_receive_duplicate_ack()
 {
-    struct [[gnu::packed]] PseudoHeader {
-        IPv4Address source;
-        IPv4Address destination;
-        u8 zero;
-        u8 protocol;
-        NetworkOrdered<u16> payload_size;
+    if (!m_congestion_control)
+        return;
+
+    if (m_in_fast_recovery) {
+        m_congestion_control->on_duplicate_ack_in_fast_recovery();
+        // With SACK, every further duplicate ACK can point out another hole to fill.
+        if (m_sack_enabled)
+            mark_next_hole_for_retransmission();
+        return;
+    }
+
+    if (++m_duplicate_ack_count < duplicate_ack_threshold)
+        return;
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): fast retransmit of {}", this, m_send_unacknowledged);
+
+    m_fast_retransmissions++;
+    m_in_fast_recovery = true;
+    m_recovery_point = m_send_next;
+    m_recovery_retransmitted_up_to = m_send_unacknowledged;
+    m_congestion_control->on_enter_fast_recovery(m_send_next - m_send_unacknowledged);
+    mark_next_hole_for_retransmission();
+}
+
+void TCPSocket::mark_next_hole_for_retransmission()
+{
+    // The first unacknowledged segment is always presumed lost. Beyond that, a segment is
+    // only known to be lost if the peer has SACKed something after it.
+    bool is_first = true;
+    for (auto& packet : m_not_acked) {
+        if (sequence_is_before(m_send_next, packet.ack_number))
+            return;
+        bool is_known_hole = is_first || (m_has_sacked_data && sequence_is_before(packet.ack_number, m_highest_sacked));
+        is_first = false;
+        if (!is_known_hole)
+            return;
+        if (packet.is_sacked || !sequence_is_before(m_recovery_retransmitted_up_to, packet.ack_number))
+            continue;
+        packet.needs_retransmission = true;
+        m_recovery_retransmitted_up_to = packet.ack_number;
+        return;
+    }
+}
+
+void TCPSocket::process_sack_option(const TCPPacket& tcp_packet)
+{
+    tcp_packet.for_each_option([&](TCPOptionKind kind, const u8* data, size_t length) {
+        if (kind != TCPOptionKind::SACK || length % 8)
+            return;
+        for (size_t i = 0; i < length; i += 8) {
+            u32 left_edge = read_u32_network_order(data + i);
+            u32 right_edge = read_u32_network_order(data + i + 4);
+            if (!sequence_is_before(left_edge, right_edge) || sequence_is_before(m_send_maximum, right_edge))
+                continue;
+            for (auto& packet : m_not_acked) {
+                auto& sent_packet = *(const TCPPacket*)(packet.buffer.data());
+                if (!sequence_is_before(sent_packet.sequence_number(), left_edge) && !sequence_is_before(right_edge, packet.ack_number))
+                    packet.is_sacked = true;
+            }
+            if (!m_has_sacked_data || sequence_is_before(m_highest_sacked, right_edge)) {
+                m_highest_sacked = right_edge;
+                m_has_sacked_data = true;
+            }
+        }
+    });
+}
+
+size_t TCPSocket::write_sack_option(u8* options) const
+{
+    struct Block {
+        u32 left_edge;
+        u32 right_edge;
     };
+    Vector<Block, 8> blocks;
+    size_t most_recent_block = 0;
+    for (auto& segment : m_out_of_order_segments) {
+        u32 end = segment.sequence_number + segment.payload_size;
+        if (blocks.is_empty() || sequence_is_before(blocks.last().right_edge, segment.sequence_number))
+            blocks.append({ segment.sequence_number, end });
+        else if (sequence_is_before(blocks.last().right_edge, end))
+            blocks.last().right_edge = end;
+        if (segment.sequence_number == m_last_out_of_order_sequence)
+            most_recent_block = blocks.size() - 1;
+    }
 
-    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, sizeof(TCPPacket) + payload_size };
+    // The block containing the most recently received segment goes first (RFC 2018 section 4).
+    swap(blocks[0], blocks[most_recent_block]);
+
+    size_t count = min(blocks.size(), max_sack_blocks);
+    options[0] = (u8)TCPOptionKind::NoOperation;
+    options[1] = (u8)TCPOptionKind::NoOperation;
+    options[2] = (u8)TCPOptionKind::SACK;
+    options[3] = 2 + count * 8;
+    for (size_t i = 0; i < count; ++i) {
+        write_u32_network_order(options + 4 + i * 8, blocks[i].left_edge);
+        write_u32_network_order(options + 8 + i * 8, blocks[i].right_edge);
+    }
+    return 4 + count * 8;
+}
 
-    u32 checksum = 0;
-    auto* w = (const NetworkOrdered<u16>*)&pseudo_header;
-    for (size_t i = 0; i < sizeof(pseudo_header) / sizeof(u16); ++i) {
-        checksum += w[i];
-        if (checksum > 0xffff)
-            checksum = (checksum >> 16) + (checksum & 0xffff);
+void TCPSocket::queue_out_of_order_segment(u32 sequence_number, size_t payload_size, NonnullRefPtr<PacketBuffer> buffer, ReadonlyBytes raw_ipv4_packet, const Time& packet_timestamp)
+{
+    // Don't hold on to anything that the peer shouldn't have sent in the first place.
+    if (!sequence_is_before(m_ack_number, sequence_number) || sequence_is_before(m_advertised_window_edge, sequence_number + payload_size))
+        return;
+    if (m_out_of_order_bytes + payload_size > receive_buffer_capacity())
+        return;
+
+    size_t index = 0;
+    for (; index < m_out_of_order_segments.size(); ++index) {
+        auto& segment = m_out_of_order_segments[index];
+        if (segment.sequence_number == sequence_number)
+            return;
+        if (sequence_is_before(sequence_number, segment.sequence_number))
+            break;
     }
-    w = (const NetworkOrdered<u16>*)&packet;
-    for (size_t i = 0; i < sizeof(packet) / sizeof(u16); ++i) {
-        checksum += w[i];
-        if (checksum > 0xffff)
-            checksum = (checksum >> 16) + (checksum & 0xffff);
+    m_out_of_order_segments.insert(index, { sequence_number, payload_size, move(buffer), raw_ipv4_packet, packet_timestamp });
+    m_out_of_order_bytes += payload_size;
+    m_last_out_of_order_sequence = sequence_number;
+    m_out_of_order_segments_received++;
+}
+
+void TCPSocket::deliver_out_of_order_segments()
+{
+    while (!m_out_of_order_segments.is_empty()) {
+        auto& segment = m_out_of_order_segments.first();
+        u32 end = segment.sequence_number + segment.payload_size;
+        if (!sequence_is_before(m_ack_number, end)) {
+            // Already covered by data that arrived in order.
+            m_out_of_order_bytes -= segment.payload_size;
+            m_out_of_order_segments.take_first();
+            continue;
+        }
+        if (segment.sequence_number != m_ack_number)
+            return;
+        if (!did_receive(peer_address(), peer_port(), segment.buffer, segment.raw_ipv4_packet, segment.timestamp)) {
+            // No room for it after all; drop it and let the peer resend it.
+            m_out_of_order_bytes = 0;
+            m_out_of_order_segments.clear();
+            return;
+        }
+        m_ack_number = end;
+        m_out_of_order_bytes -= segment.payload_size;
+        m_out_of_order_segments.take_first();
     }
-    VERIFY(packet.data_offset() * 4 == sizeof(TCPPacket));
-    w = (const NetworkOrdered<u16>*)packet.payload();
-    for (size_t i = 0; i < payload_size / sizeof(u16); ++i) {
-        checksum += w[i];
-        if (checksum > 0xffff)
-            checksum = (checksum >> 16) + (checksum & 0xffff);
+}
+
+void TCPSocket::process_syn_options(const TCPPacket& packet)
+{
+    bool peer_offered_window_scaling = false;
+    bool peer_offered_sack = false;
+    packet.for_each_option([&](TCPOptionKind kind, const u8* data, size_t length) {
+        switch (kind) {
+        case TCPOptionKind::MaximumSegmentSize:
+            if (length == 2) {
+                u16 mss = (data[0] << 8) | data[1];
+                if (mss)
+                    m_peer_maximum_segment_size = mss;
+            }
+            break;
+        case TCPOptionKind::WindowScale:
+            if (length == 1) {
+                m_peer_window_scale = min(data[0], max_window_scale);
+                peer_offered_window_scaling = true;
+            }
+            break;
+        case TCPOptionKind::SACKPermitted:
+            peer_offered_sack = true;
+            break;
+        default:
+            break;
+        }
+    });
+
+    m_window_scaling_enabled = peer_offered_window_scaling;
+    m_sack_enabled = peer_offered_sack;
+    m_peer_window = packet.window_size();
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): peer MSS {}, window scaling {} (peer shift {}, our shift {}), SACK {}",
+        this, m_peer_maximum_segment_size, m_window_scaling_enabled, m_peer_window_scale, m_receive_window_scale, m_sack_enabled);
+}
+
+void TCPSocket::protocol_did_drain_receive_buffer()
+{
+    if (m_state != State::Established && m_state != State::FinWait1 && m_state != State::FinWait2)
+        return;
+
+    // Receiver-side silly window syndrome avoidance (RFC 1122 4.2.3.3): only announce
+    // a larger window once it has grown by a meaningful amount.
+    u32 right_edge = m_ack_number + receive_buffer_space();
+    u32 threshold = min((u32)receive_buffer_capacity() / 2, maximum_segment_size());
+    if (sequence_is_before(right_edge, m_advertised_window_edge + threshold))
+        return;
+
+    [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::ACK);
+}
+
+void TCPSocket::refresh_acknowledgement(TCPPacket& packet)
+{
+    // A queued segment may be sent (again) long after it was built, by which time its ACK number
+    // and window are stale. Patch them up in place and adjust the checksum incrementally instead
+    // of checksumming the whole segment again.
+    u16 checksum = packet.checksum();
+    if (packet.ack_number() != m_ack_number) {
+        checksum = InternetChecksum::update_u32(checksum, packet.ack_number(), m_ack_number);
+        packet.set_ack_number(m_ack_number);
     }
-    if (payload_size & 1) {
-        u16 expanded_byte = ((const u8*)packet.payload())[payload_size - 1] << 8;
-        checksum += expanded_byte;
-        if (checksum > 0xffff)
-            checksum = (checksum >> 16) + (checksum & 0xffff);
+    u16 window_size = advertised_window_size(false);
+    if (packet.window_size() != window_size) {
+        checksum = InternetChecksum::update_u16(checksum, packet.window_size(), window_size);
+        packet.set_window_size(window_size);
     }
-    return ~(checksum & 0xffff);
+    packet.set_checksum(checksum);
+}
+
+NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket& packet, u16 payload_size)
+{
+    return compute_ipv4_pseudo_header_checksum(source, destination, IPv4Protocol::TCP, { (const u8*)&packet, packet.header_size() + payload_size });
 }
 
 KResult TCPSocket::protocol_bind()
@@ -391,7 +975,7 @@ KResult TCPSocket::protocol_connect(FileDescription& description, ShouldBlock sh
 
     allocate_local_port_if_needed();
 
-    m_sequence_number = get_good_random<u32>();
+    set_sequence_number(get_good_random<u32>());
     m_ack_number = 0;
 
     set_setup_state(SetupState::InProgress);
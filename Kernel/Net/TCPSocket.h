@@ -28,12 +28,18 @@
 
 #include <AK/Function.h>
 #include <AK/HashMap.h>
+#include <AK/OwnPtr.h>
 #include <AK/SinglyLinkedList.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
+#include <Kernel/KBuffer.h>
 #include <Kernel/Net/IPv4Socket.h>
+#include <Kernel/Net/TCPCongestionControl.h>
 
 namespace Kernel {
 
+class Timer;
+
 class TCPSocket final : public IPv4Socket {
 public:
     static void for_each(Function<void(const TCPSocket&)>);
@@ -140,7 +146,13 @@ public:
     void set_error(Error error) { m_error = error; }
 
     void set_ack_number(u32 n) { m_ack_number = n; }
-    void set_sequence_number(u32 n) { m_sequence_number = n; }
+    void set_sequence_number(u32 n)
+    {
+        m_sequence_number = n;
+        m_send_unacknowledged = n;
+        m_send_next = n;
+        m_send_maximum = n;
+    }
     u32 ack_number() const { return m_ack_number; }
     u32 sequence_number() const { return m_sequence_number; }
     u32 packets_in() const { return m_packets_in; }
@@ -148,9 +160,33 @@ public:
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
 
+    u32 maximum_segment_size() const { return min(m_local_maximum_segment_size, m_peer_maximum_segment_size); }
+    u32 peer_window() const { return m_peer_window; }
+    u32 congestion_window() const { return m_congestion_control ? m_congestion_control->congestion_window() : 0; }
+    u32 slow_start_threshold() const { return m_congestion_control ? m_congestion_control->slow_start_threshold() : 0; }
+    bool is_sack_enabled() const { return m_sack_enabled; }
+
+    u64 smoothed_rtt_us() const { return m_smoothed_rtt_us; }
+    u64 rtt_variance_us() const { return m_rtt_variance_us; }
+    u64 retransmission_timeout_us() const { return m_retransmission_timeout_us; }
+    u32 retransmissions() const { return m_retransmissions; }
+    u32 fast_retransmissions() const { return m_fast_retransmissions; }
+    u32 retransmission_timeouts() const { return m_retransmission_timeouts; }
+    u32 window_probes() const { return m_window_probes; }
+    u32 out_of_order_segments_received() const { return m_out_of_order_segments_received; }
+
     KResult send_tcp_packet(u16 flags, const UserOrKernelBuffer* = nullptr, size_t = 0);
     void send_outgoing_packets();
+    void refresh_acknowledgement(TCPPacket&);
     void receive_tcp_packet(const TCPPacket&, u16 size);
+    void process_syn_options(const TCPPacket&);
+
+    // Holds on to a segment that arrived ahead of a gap, so that it doesn't have to be
+    // resent and can be reported back to the peer in SACK blocks.
+    void queue_out_of_order_segment(u32 sequence_number, size_t payload_size, NonnullRefPtr<PacketBuffer>, ReadonlyBytes raw_ipv4_packet, const Time& packet_timestamp);
+    void deliver_out_of_order_segments();
+
+    static void handle_expired_retransmission_timers();
 
     static Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>& sockets_by_tuple();
     static RefPtr<TCPSocket> from_tuple(const IPv4SocketTuple& tuple);
@@ -165,6 +201,7 @@ public:
     void release_for_accept(RefPtr<TCPSocket>);
 
     virtual KResult close() override;
+    virtual bool can_write(const FileDescription&, size_t) const override;
 
 protected:
     void set_direction(Direction direction) { m_direction = direction; }
@@ -184,6 +221,34 @@ private:
     virtual bool protocol_is_disconnected() const override;
     virtual KResult protocol_bind() override;
     virtual KResult protocol_listen() override;
+    virtual void protocol_did_drain_receive_buffer() override;
+
+    // Upper bound on data that has been written but not yet acknowledged by the peer.
+    static constexpr size_t send_buffer_size = 256 * KiB;
+    static constexpr u32 default_maximum_segment_size = 536;
+    static constexpr u8 max_window_scale = 14;
+    static constexpr int duplicate_ack_threshold = 3;
+    static constexpr size_t max_sack_blocks = 4;
+
+    // RFC 6298, except for the minimum RTO which is lower than the recommended one second.
+    static constexpr u64 initial_retransmission_timeout_us = 1'000'000;
+    static constexpr u64 min_retransmission_timeout_us = 200'000;
+    static constexpr u64 max_retransmission_timeout_us = 60'000'000;
+
+    size_t send_buffer_space() const;
+    u16 advertised_window_size(bool is_syn);
+    void did_acknowledge(u32 ack_number, u32 bytes_acked);
+    void did_receive_duplicate_ack();
+    void process_sack_option(const TCPPacket&);
+    void mark_next_hole_for_retransmission();
+    size_t write_sack_option(u8* options) const;
+
+    void update_rtt(u64 sample_us);
+    void restart_retransmission_timer();
+    void schedule_retransmission_timer();
+    void retransmission_timer_did_fire();
+    void arm_persist_timer();
+    void send_window_probe();
 
     WeakPtr<TCPSocket> m_originator;
     HashMap<IPv4SocketTuple, NonnullRefPtr<TCPSocket>> m_pending_release_for_accept;
@@ -198,13 +263,66 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
 
+    // RFC 793 SND.UNA and SND.NXT; m_sequence_number is the next sequence number to be queued.
+    u32 m_send_unacknowledged { 0 };
+    u32 m_send_next { 0 };
+    u32 m_send_maximum { 0 };
+    u32 m_peer_window { 0 };
+    u32 m_advertised_window_edge { 0 };
+    u32 m_local_maximum_segment_size { default_maximum_segment_size };
+    u32 m_peer_maximum_segment_size { default_maximum_segment_size };
+    u8 m_peer_window_scale { 0 };
+    u8 m_receive_window_scale { 0 };
+    bool m_window_scaling_enabled { false };
+    bool m_sack_enabled { false };
+
+    OwnPtr<TCPCongestionControl> m_congestion_control;
+    int m_duplicate_ack_count { 0 };
+    bool m_in_fast_recovery { false };
+    u32 m_recovery_point { 0 };
+    u32 m_recovery_retransmitted_up_to { 0 };
+    u32 m_highest_sacked { 0 };
+    bool m_has_sacked_data { false };
+
+    u64 m_smoothed_rtt_us { 0 };
+    u64 m_rtt_variance_us { 0 };
+    u64 m_retransmission_timeout_us { initial_retransmission_timeout_us };
+    bool m_has_rtt_sample { false };
+    Time m_retransmission_deadline {};
+    RefPtr<Timer> m_retransmission_timer;
+    // While the peer's window keeps us from sending anything, the timer is the RFC 1122
+    // persist timer instead, which sends window probes with exponential backoff.
+    bool m_is_probing_window { false };
+    u64 m_persist_timeout_us { 0 };
+
+    u32 m_retransmissions { 0 };
+    u32 m_fast_retransmissions { 0 };
+    u32 m_retransmission_timeouts { 0 };
+    u32 m_window_probes { 0 };
+    u32 m_out_of_order_segments_received { 0 };
+
+    struct OutOfOrderSegment {
+        u32 sequence_number { 0 };
+        size_t payload_size { 0 };
+        NonnullRefPtr<PacketBuffer> buffer;
+        ReadonlyBytes raw_ipv4_packet;
+        Time timestamp {};
+    };
+    Vector<OutOfOrderSegment> m_out_of_order_segments;
+    size_t m_out_of_order_bytes { 0 };
+    u32 m_last_out_of_order_sequence { 0 };
+
     struct OutgoingPacket {
         u32 ack_number { 0 };
         ByteBuffer buffer;
         int tx_counter { 0 };
         Time tx_time {};
+        bool needs_retransmission { false };
+        bool is_sacked { false };
     };
 
+    void trim_acknowledged_payload(OutgoingPacket&);
+
     Lock m_not_acked_lock { "TCPSocket unacked packets" };
     SinglyLinkedList<OutgoingPacket> m_not_acked;
 };
@@ -104,6 +104,10 @@ KResultOr<size_t> UDPSocket::protocol_send(const UserOrKernelBuffer& data, size_
     if (!data.read(udp_packet.payload(), data_length))
         return EFAULT;
 
+    // A computed checksum of zero is sent as all ones, since zero means "no checksum".
+    u16 checksum = compute_ipv4_pseudo_header_checksum(routing_decision.adapter->ipv4_address(), peer_address(), IPv4Protocol::UDP, buffer.bytes());
+    udp_packet.set_checksum(checksum ? checksum : 0xffff);
+
     auto result = routing_decision.adapter->send_ipv4(routing_decision.next_hop, peer_address(), IPv4Protocol::UDP, UserOrKernelBuffer::for_kernel_buffer(buffer.data()), buffer_size, ttl());
     if (result.is_error())
         return result;
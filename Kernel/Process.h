@@ -276,8 +276,11 @@ public:
     KResultOr<int> sys$close(int fd);
     KResultOr<ssize_t> sys$read(int fd, Userspace<u8*>, ssize_t);
     KResultOr<ssize_t> sys$readv(int fd, Userspace<const struct iovec*> iov, int iov_count);
+    KResultOr<ssize_t> sys$preadv(Userspace<const Syscall::SC_preadv_params*>);
     KResultOr<ssize_t> sys$write(int fd, Userspace<const u8*>, ssize_t);
     KResultOr<ssize_t> sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count);
+    KResultOr<ssize_t> sys$pwritev(Userspace<const Syscall::SC_pwritev_params*>);
+    KResultOr<ssize_t> sys$sendfile(Userspace<const Syscall::SC_sendfile_params*>);
     KResultOr<int> sys$fstat(int fd, Userspace<stat*>);
     KResultOr<int> sys$stat(Userspace<const Syscall::SC_stat_params*>);
     KResultOr<int> sys$lseek(int fd, off_t, int whence);
@@ -295,6 +298,9 @@ public:
     KResultOr<int> sys$purge(int mode);
     KResultOr<int> sys$select(Userspace<const Syscall::SC_select_params*>);
     KResultOr<int> sys$poll(Userspace<const Syscall::SC_poll_params*>);
+    KResultOr<int> sys$epoll_create(int flags);
+    KResultOr<int> sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*>);
+    KResultOr<int> sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*>);
     KResultOr<ssize_t> sys$get_dir_entries(int fd, Userspace<void*>, ssize_t);
     KResultOr<int> sys$getcwd(Userspace<char*>, size_t);
     KResultOr<int> sys$chdir(Userspace<const char*>, size_t);
@@ -503,7 +509,9 @@ private:
     bool create_perf_events_buffer_if_needed();
 
     KResult do_exec(NonnullRefPtr<FileDescription> main_program_description, Vector<String> arguments, Vector<String> environment, RefPtr<FileDescription> interpreter_description, Thread*& new_main_thread, u32& prev_flags, const Elf32_Ehdr& main_program_header);
-    KResultOr<ssize_t> do_write(FileDescription&, const UserOrKernelBuffer&, size_t);
+    KResultOr<ssize_t> do_write(FileDescription&, const UserOrKernelBuffer&, size_t, Optional<off_t> offset = {});
+    KResultOr<ssize_t> do_readv(int fd, Userspace<const struct iovec*>, int iov_count, Optional<off_t> offset);
+    KResultOr<ssize_t> do_writev(int fd, Userspace<const struct iovec*>, int iov_count, Optional<off_t> offset);
 
     KResultOr<RefPtr<FileDescription>> find_elf_interpreter_for_executable(const String& path, const Elf32_Ehdr& elf_header, int nread, size_t file_size);
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/RingBuffer.h>
+
+namespace Kernel {
+
+inline void RingBuffer::compute_lockfree_metadata()
+{
+    InterruptDisabler disabler;
+    m_empty = m_used == 0;
+    m_space_for_writing = m_used < m_capacity ? m_capacity - m_used : 0;
+}
+
+RingBuffer::RingBuffer(size_t capacity)
+    : m_capacity(capacity)
+    , m_initial_capacity(capacity)
+{
+    compute_lockfree_metadata();
+}
+
+void RingBuffer::set_capacity(size_t capacity)
+{
+    LOCKER(m_lock);
+    m_capacity = capacity;
+    // Let go of storage we're no longer allowed to use, if nothing is using it right now.
+    if (m_used == 0 && storage_size() > capacity) {
+        m_storage = nullptr;
+        m_read_offset = 0;
+    }
+    compute_lockfree_metadata();
+    if (m_unblock_callback && m_space_for_writing > 0)
+        m_unblock_callback();
+}
+
+bool RingBuffer::ensure_storage(size_t needed)
+{
+    VERIFY(m_lock.is_locked());
+    size_t current_size = storage_size();
+    if (needed <= current_size)
+        return true;
+
+    size_t new_size = max(current_size * 2, initial_storage_size);
+    while (new_size < needed)
+        new_size *= 2;
+    new_size = min(new_size, max(m_capacity, needed));
+
+    auto new_storage = KBuffer::try_create_with_size(new_size, Region::Access::Read | Region::Access::Write, "RingBuffer");
+    if (!new_storage)
+        return false;
+
+    // Lay the buffered data out linearly at the start of the new storage.
+    if (m_used > 0) {
+        size_t first_chunk = min(m_used, current_size - m_read_offset);
+        memcpy(new_storage->data(), m_storage->data() + m_read_offset, first_chunk);
+        memcpy(new_storage->data() + first_chunk, m_storage->data(), m_used - first_chunk);
+    }
+    m_storage = move(new_storage);
+    m_read_offset = 0;
+    return true;
+}
+
+ssize_t RingBuffer::write(const UserOrKernelBuffer& data, size_t size)
+{
+    if (!size)
+        return 0;
+    LOCKER(m_lock);
+    size_t bytes_to_write = min(size, m_space_for_writing);
+    if (!bytes_to_write)
+        return 0;
+
+    // Grow the storage as needed, but make do with what we have if we can't.
+    if (!ensure_storage(m_used + bytes_to_write)) {
+        bytes_to_write = min(bytes_to_write, storage_size() - m_used);
+        if (!bytes_to_write)
+            return -ENOMEM;
+    }
+
+    size_t storage_size = this->storage_size();
+    size_t write_offset = (m_read_offset + m_used) % storage_size;
+    size_t first_chunk = min(bytes_to_write, storage_size - write_offset);
+    if (!data.read(m_storage->data() + write_offset, first_chunk))
+        return -EFAULT;
+    if (first_chunk < bytes_to_write && !data.read(m_storage->data(), first_chunk, bytes_to_write - first_chunk))
+        return -EFAULT;
+
+    m_used += bytes_to_write;
+    compute_lockfree_metadata();
+    if (m_unblock_callback && !m_empty)
+        m_unblock_callback();
+    return (ssize_t)bytes_to_write;
+}
+
+ssize_t RingBuffer::read(UserOrKernelBuffer& data, size_t size)
+{
+    if (!size)
+        return 0;
+    LOCKER(m_lock);
+    if (m_used == 0)
+        return 0;
+
+    size_t storage_size = this->storage_size();
+    size_t nread = min(m_used, size);
+    size_t first_chunk = min(nread, storage_size - m_read_offset);
+    if (!data.write(m_storage->data() + m_read_offset, first_chunk))
+        return -EFAULT;
+    if (first_chunk < nread && !data.write(m_storage->data(), first_chunk, nread - first_chunk))
+        return -EFAULT;
+
+    m_used -= nread;
+    m_read_offset = m_used ? (m_read_offset + nread) % storage_size : 0;
+    // Don't hold on to a large buffer after a burst; it's grown again if another one comes.
+    if (!m_used && storage_size > m_initial_capacity)
+        m_storage = nullptr;
+    compute_lockfree_metadata();
+    if (m_unblock_callback && m_space_for_writing > 0)
+        m_unblock_callback();
+    return (ssize_t)nread;
+}
+
+}
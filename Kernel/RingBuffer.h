@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Function.h>
+#include <AK/OwnPtr.h>
+#include <AK/Types.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/KResult.h>
+#include <Kernel/Lock.h>
+#include <Kernel/UserOrKernelBuffer.h>
+
+namespace Kernel {
+
+// A byte stream buffer whose storage is allocated on first use and grown on demand, up to
+// a capacity that can be changed at runtime. Unlike DoubleBuffer, the whole capacity is
+// available to the writer no matter how far behind the reader is. Storage grown beyond the
+// initial capacity is given back whenever the reader catches up.
+class RingBuffer {
+public:
+    static constexpr size_t initial_storage_size = 4 * KiB;
+
+    explicit RingBuffer(size_t capacity = 64 * KiB);
+
+    [[nodiscard]] ssize_t write(const UserOrKernelBuffer&, size_t);
+    [[nodiscard]] ssize_t read(UserOrKernelBuffer&, size_t);
+
+    bool is_empty() const { return m_empty; }
+
+    size_t space_for_writing() const { return m_space_for_writing; }
+    size_t capacity() const { return m_capacity; }
+    size_t storage_size() const { return m_storage ? m_storage->capacity() : 0; }
+
+    // Changes the maximum amount of data the buffer will hold. Shrinking below the amount
+    // that's currently buffered only stops further writes until the reader catches up.
+    void set_capacity(size_t);
+
+    void set_unblock_callback(Function<void()> callback)
+    {
+        VERIFY(!m_unblock_callback);
+        m_unblock_callback = move(callback);
+    }
+
+private:
+    bool ensure_storage(size_t);
+    void compute_lockfree_metadata();
+
+    OwnPtr<KBuffer> m_storage;
+    Function<void()> m_unblock_callback;
+    size_t m_capacity { 0 };
+    size_t m_initial_capacity { 0 };
+    size_t m_read_offset { 0 };
+    size_t m_used { 0 };
+    size_t m_space_for_writing { 0 };
+    bool m_empty { true };
+    mutable Lock m_lock { "RingBuffer" };
+};
+
+}
@@ -24,6 +24,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Array.h>
+#include <AK/NumericLimits.h>
 #include <AK/QuickSort.h>
 #include <AK/ScopeGuard.h>
 #include <AK/TemporaryChange.h>
@@ -45,6 +47,23 @@ namespace Kernel {
 extern bool g_profiling_all_threads;
 extern PerformanceEventBuffer* g_global_perf_events;
 
+struct ThreadReadyQueue {
+    IntrusiveList<Thread, &Thread::m_ready_queue_node> thread_list;
+};
+static constexpr u32 g_ready_queue_buckets = sizeof(u32) * 8;
+
+// Every processor owns a set of ready queues. A runnable thread is queued
+// on exactly one processor, which is usually the one it last ran on, and
+// each processor normally only ever pulls threads off its own queues.
+struct ThreadReadyQueues {
+    SpinLock<u8> lock;
+    u32 mask { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> count { 0 }; // Only a hint when read without holding the lock
+    Array<ThreadReadyQueue, g_ready_queue_buckets> queues;
+
+    Thread* pull_next_runnable_thread(u32 affinity_mask);
+};
+
 class SchedulerPerProcessorData {
     AK_MAKE_NONCOPYABLE(SchedulerPerProcessorData);
     AK_MAKE_NONMOVABLE(SchedulerPerProcessorData);
@@ -55,6 +74,7 @@ public:
     WeakPtr<Thread> m_pending_beneficiary;
     const char* m_pending_donate_reason { nullptr };
     bool m_in_scheduler { true };
+    ThreadReadyQueues m_ready_queues;
 };
 
 RecursiveSpinLock g_scheduler_lock;
@@ -72,18 +92,13 @@ READONLY_AFTER_INIT WaitQueue* g_finalizer_wait_queue;
 Atomic<bool> g_finalizer_has_work { false };
 READONLY_AFTER_INIT static Process* s_colonel_process;
 
-struct ThreadReadyQueue {
-    IntrusiveList<Thread, &Thread::m_ready_queue_node> thread_list;
-};
-static SpinLock<u8> g_ready_queues_lock;
-static u32 g_ready_queues_mask;
-static constexpr u32 g_ready_queue_buckets = sizeof(g_ready_queues_mask) * 8;
-READONLY_AFTER_INIT static ThreadReadyQueue* g_ready_queues; // g_ready_queue_buckets entries
+// Processors that have their ready queues set up and are pulling threads off them
+static Atomic<u32> s_scheduling_processors_mask { 0 };
 
 static inline u32 thread_priority_to_priority_index(u32 thread_priority)
 {
     // Converts the priority in the range of THREAD_PRIORITY_MIN...THREAD_PRIORITY_MAX
-    // to a index into g_ready_queues where 0 is the highest priority bucket
+    // to a index into ThreadReadyQueues::queues where 0 is the highest priority bucket
     VERIFY(thread_priority >= THREAD_PRIORITY_MIN && thread_priority <= THREAD_PRIORITY_MAX);
     constexpr u32 thread_priority_count = THREAD_PRIORITY_MAX - THREAD_PRIORITY_MIN + 1;
     static_assert(thread_priority_count > 0);
@@ -92,16 +107,53 @@ static inline u32 thread_priority_to_priority_index(u32 thread_priority)
     return priority_bucket;
 }
 
-Thread& Scheduler::pull_next_runnable_thread()
+static inline ThreadReadyQueues& ready_queues_for(u32 cpu)
 {
-    auto affinity_mask = 1u << Processor::current().id();
+    return Processor::by_id(cpu).get_scheduler_data().m_ready_queues;
+}
 
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority_mask = g_ready_queues_mask;
+static u32 select_processor_for(const Thread& thread)
+{
+    auto scheduling_mask = s_scheduling_processors_mask.load(AK::MemoryOrder::memory_order_acquire);
+    VERIFY(scheduling_mask != 0);
+    auto candidate_mask = thread.affinity() & scheduling_mask;
+    if (candidate_mask == 0) {
+        // None of the processors this thread may run on are scheduling yet.
+        // Park it on the first one that is, it'll be stolen once allowed.
+        return __builtin_ffsl(scheduling_mask) - 1;
+    }
+
+    // Find the least loaded processor this thread is allowed to run on
+    u32 best_cpu = 0;
+    u32 best_count = NumericLimits<u32>::max();
+    for (auto mask = candidate_mask; mask != 0;) {
+        u32 cpu = __builtin_ffsl(mask) - 1;
+        mask &= ~(1u << cpu);
+        auto count = ready_queues_for(cpu).count.load();
+        if (count < best_count) {
+            best_cpu = cpu;
+            best_count = count;
+        }
+    }
+
+    // Keep the thread on the processor it last ran on unless that one is
+    // noticeably busier, as its caches are likely still warm.
+    auto last_cpu = thread.cpu();
+    if (candidate_mask & (1u << last_cpu)) {
+        if (ready_queues_for(last_cpu).count.load() <= best_count + 1)
+            return last_cpu;
+    }
+    return best_cpu;
+}
+
+Thread* ThreadReadyQueues::pull_next_runnable_thread(u32 affinity_mask)
+{
+    ScopedSpinLock lock(this->lock);
+    auto priority_mask = mask;
     while (priority_mask != 0) {
         auto priority = __builtin_ffsl(priority_mask);
         VERIFY(priority > 0);
-        auto& ready_queue = g_ready_queues[--priority];
+        auto& ready_queue = queues[--priority];
         for (auto& thread : ready_queue.thread_list) {
             VERIFY(thread.m_runnable_priority == (int)priority);
             if (thread.is_active())
@@ -111,7 +163,8 @@ Thread& Scheduler::pull_next_runnable_thread()
             thread.m_runnable_priority = -1;
             ready_queue.thread_list.remove(thread);
             if (ready_queue.thread_list.is_empty())
-                g_ready_queues_mask &= ~(1u << priority);
+                mask &= ~(1u << priority);
+            count--;
             // Mark it as active because we are using this thread. This is similar
             // to comparing it with Processor::current_thread, but when there are
             // multiple processors there's no easy way to check whether the thread
@@ -123,34 +176,78 @@ Thread& Scheduler::pull_next_runnable_thread()
             // switching to it.
             // FIXME: Figure out a better way maybe?
             thread.set_active(true);
-            return thread;
+            return &thread;
         }
         priority_mask &= ~(1u << priority);
     }
-    return *Processor::current().idle_thread();
+    return nullptr;
+}
+
+Thread& Scheduler::pull_next_runnable_thread()
+{
+    auto& processor = Processor::current();
+    auto cpu = processor.get_id();
+    auto affinity_mask = 1u << cpu;
+
+    if (auto* thread = processor.get_scheduler_data().m_ready_queues.pull_next_runnable_thread(affinity_mask))
+        return *thread;
+
+    // We ran out of work, so rather than going idle try to steal a thread
+    // from the busiest other processor that has one we're allowed to run.
+    auto other_processors_mask = s_scheduling_processors_mask.load(AK::MemoryOrder::memory_order_acquire) & ~affinity_mask;
+    while (other_processors_mask != 0) {
+        u32 busiest_cpu = 0;
+        u32 busiest_count = 0;
+        for (auto mask = other_processors_mask; mask != 0;) {
+            u32 other_cpu = __builtin_ffsl(mask) - 1;
+            mask &= ~(1u << other_cpu);
+            auto count = ready_queues_for(other_cpu).count.load();
+            if (count > busiest_count) {
+                busiest_cpu = other_cpu;
+                busiest_count = count;
+            }
+        }
+        if (busiest_count == 0)
+            break;
+        if (auto* thread = ready_queues_for(busiest_cpu).pull_next_runnable_thread(affinity_mask)) {
+            dbgln_if(SCHEDULER_DEBUG, "Scheduler[{}]: Stole {} from processor {}", cpu, *thread, busiest_cpu);
+            return *thread;
+        }
+        other_processors_mask &= ~(1u << busiest_cpu);
+    }
+
+    return *processor.idle_thread();
 }
 
 bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
 {
     if (&thread == Processor::current().idle_thread())
         return true;
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority = thread.m_runnable_priority;
-    if (priority < 0) {
-        VERIFY(!thread.m_ready_queue_node.is_in_list());
-        return false;
-    }
 
     if (check_affinity && !(thread.affinity() & (1 << Processor::current().id())))
         return false;
 
-    VERIFY(g_ready_queues_mask & (1u << priority));
-    auto& ready_queue = g_ready_queues[priority];
-    thread.m_runnable_priority = -1;
-    ready_queue.thread_list.remove(thread);
-    if (ready_queue.thread_list.is_empty())
-        g_ready_queues_mask &= ~(1u << priority);
-    return true;
+    for (;;) {
+        auto cpu = thread.m_runnable_cpu;
+        auto& ready_queues = ready_queues_for(cpu);
+        ScopedSpinLock lock(ready_queues.lock);
+        if (thread.m_runnable_cpu != cpu)
+            continue; // The thread was moved to another processor in the meanwhile, try again
+        auto priority = thread.m_runnable_priority;
+        if (priority < 0) {
+            VERIFY(!thread.m_ready_queue_node.is_in_list());
+            return false;
+        }
+
+        VERIFY(ready_queues.mask & (1u << priority));
+        auto& ready_queue = ready_queues.queues[priority];
+        thread.m_runnable_priority = -1;
+        ready_queue.thread_list.remove(thread);
+        if (ready_queue.thread_list.is_empty())
+            ready_queues.mask &= ~(1u << priority);
+        ready_queues.count--;
+        return true;
+    }
 }
 
 void Scheduler::queue_runnable_thread(Thread& thread)
@@ -159,16 +256,20 @@ void Scheduler::queue_runnable_thread(Thread& thread)
     if (&thread == Processor::current().idle_thread())
         return;
     auto priority = thread_priority_to_priority_index(thread.priority());
+    auto cpu = select_processor_for(thread);
+    auto& ready_queues = ready_queues_for(cpu);
 
-    ScopedSpinLock lock(g_ready_queues_lock);
+    ScopedSpinLock lock(ready_queues.lock);
     VERIFY(thread.m_runnable_priority < 0);
     thread.m_runnable_priority = (int)priority;
+    thread.m_runnable_cpu = cpu;
     VERIFY(!thread.m_ready_queue_node.is_in_list());
-    auto& ready_queue = g_ready_queues[priority];
+    auto& ready_queue = ready_queues.queues[priority];
     bool was_empty = ready_queue.thread_list.is_empty();
     ready_queue.thread_list.append(thread);
     if (was_empty)
-        g_ready_queues_mask |= (1u << priority);
+        ready_queues.mask |= (1u << priority);
+    ready_queues.count++;
 }
 
 UNMAP_AFTER_INIT void Scheduler::start()
@@ -180,7 +281,14 @@ UNMAP_AFTER_INIT void Scheduler::start()
     g_scheduler_lock.lock();
 
     auto& processor = Processor::current();
-    processor.set_scheduler_data(*new SchedulerPerProcessorData());
+    // The BSP's scheduler data was already set up by Scheduler::initialize
+    // because threads get queued on it before we get here.
+    if (processor.get_id() != 0) {
+        processor.set_scheduler_data(*new SchedulerPerProcessorData());
+#if SCHEDULE_ON_ALL_PROCESSORS
+        s_scheduling_processors_mask.fetch_or(1u << processor.get_id(), AK::MemoryOrder::memory_order_release);
+#endif
+    }
     VERIFY(processor.is_initialized());
     auto& idle_thread = *processor.idle_thread();
     VERIFY(processor.current_thread() == &idle_thread);
@@ -497,7 +605,8 @@ UNMAP_AFTER_INIT void Scheduler::initialize()
 
     RefPtr<Thread> idle_thread;
     g_finalizer_wait_queue = new WaitQueue;
-    g_ready_queues = new ThreadReadyQueue[g_ready_queue_buckets];
+    Processor::current().set_scheduler_data(*new SchedulerPerProcessorData());
+    s_scheduling_processors_mask.store(1u << Processor::current().get_id(), AK::MemoryOrder::memory_order_release);
 
     g_finalizer_has_work.store(false, AK::MemoryOrder::memory_order_release);
     s_colonel_process = Process::create_kernel_process(idle_thread, "colonel", idle_loop, nullptr, 1).leak_ref();
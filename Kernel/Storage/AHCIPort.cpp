@@ -68,7 +68,7 @@ AHCIPort::AHCIPort(const AHCIPortHandler& handler, volatile AHCI::PortRegisters&
     m_fis_receive_page = MM.allocate_supervisor_physical_page();
     if (m_command_list_page.is_null() || m_fis_receive_page.is_null())
         return;
-    for (size_t index = 0; index < 1; index++) {
+    for (size_t index = 0; index < max_transfer_size / PAGE_SIZE; index++) {
         m_dma_buffers.append(MM.allocate_supervisor_physical_page().release_nonnull());
     }
     for (size_t index = 0; index < 1; index++) {
@@ -67,6 +67,9 @@ private:
     };
 
 public:
+    // Every port owns enough DMA pages to transfer this much with a single command.
+    static constexpr size_t max_transfer_size = 8 * PAGE_SIZE;
+
     UNMAP_AFTER_INIT static NonnullRefPtr<AHCIPort> create(const AHCIPortHandler&, volatile AHCI::PortRegisters&, u32 port_index);
 
     u32 port_index() const { return m_port_index; }
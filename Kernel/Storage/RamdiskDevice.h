@@ -44,6 +44,7 @@ public:
     // ^StorageDevice
     virtual Type type() const override { return StorageDevice::Type::Ramdisk; }
     virtual size_t max_addressable_block() const override;
+    virtual size_t max_transfer_size() const override { return 64 * KiB; }
 
     // ^BlockDevice
     virtual void start_request(AsyncBlockDeviceRequest&) override;
@@ -49,6 +49,7 @@ public:
 
     // ^StorageDevice
     virtual Type type() const override { return StorageDevice::Type::SATA; }
+    virtual size_t max_transfer_size() const override { return AHCIPort::max_transfer_size; }
     // ^BlockDevice
     virtual void start_request(AsyncBlockDeviceRequest&) override;
     virtual String device_name() const override;
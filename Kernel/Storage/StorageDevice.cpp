@@ -63,12 +63,11 @@ KResultOr<size_t> StorageDevice::read(FileDescription&, size_t offset, UserOrKer
     u16 whole_blocks = len / block_size();
     ssize_t remaining = len % block_size();
 
-    unsigned blocks_per_page = PAGE_SIZE / block_size();
-
-    // PATAChannel will chuck a wobbly if we try to read more than PAGE_SIZE
-    // at a time, because it uses a single page for its DMA buffer.
-    if (whole_blocks >= blocks_per_page) {
-        whole_blocks = blocks_per_page;
+    // Don't hand the controller more than it can transfer in one go (e.g. PATAChannel
+    // uses a single page for its DMA buffer), callers will come back for the rest.
+    unsigned max_blocks_per_request = max_transfer_size() / block_size();
+    if (whole_blocks >= max_blocks_per_request) {
+        whole_blocks = max_blocks_per_request;
         remaining = 0;
     }
 
@@ -130,12 +129,11 @@ KResultOr<size_t> StorageDevice::write(FileDescription&, size_t offset, const Us
     u16 whole_blocks = len / block_size();
     ssize_t remaining = len % block_size();
 
-    unsigned blocks_per_page = PAGE_SIZE / block_size();
-
-    // PATAChannel will chuck a wobbly if we try to write more than PAGE_SIZE
-    // at a time, because it uses a single page for its DMA buffer.
-    if (whole_blocks >= blocks_per_page) {
-        whole_blocks = blocks_per_page;
+    // Don't hand the controller more than it can transfer in one go (e.g. PATAChannel
+    // uses a single page for its DMA buffer), callers will come back for the rest.
+    unsigned max_blocks_per_request = max_transfer_size() / block_size();
+    if (whole_blocks >= max_blocks_per_request) {
+        whole_blocks = max_blocks_per_request;
         remaining = 0;
     }
 
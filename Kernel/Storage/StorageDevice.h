@@ -48,6 +48,8 @@ public:
 public:
     virtual Type type() const = 0;
     virtual size_t max_addressable_block() const { return m_max_addressable_block; }
+    // The largest single request the controller can transfer, in bytes.
+    virtual size_t max_transfer_size() const { return PAGE_SIZE; }
 
     NonnullRefPtr<StorageController> controller() const;
 
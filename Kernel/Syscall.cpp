@@ -206,7 +206,10 @@ void syscall_handler(TrapFrame* trap)
     auto arg2 = regs.ecx;
     auto arg3 = regs.ebx;
 
+    auto tlb_flush_ipis_before = current_thread->tlb_flush_ipis();
     auto result = Syscall::handle(regs, function, arg1, arg2, arg3);
+    if (auto tlb_flush_ipis = current_thread->tlb_flush_ipis() - tlb_flush_ipis_before)
+        MM.record_syscall_tlb_flush_ipis(function, tlb_flush_ipis);
     if (result.is_error())
         regs.eax = result.error();
     else
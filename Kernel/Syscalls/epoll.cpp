@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Checked.h>
+#include <AK/ScopeGuard.h>
+#include <AK/Time.h>
+#include <Kernel/FileSystem/EventPoll.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+KResultOr<int> Process::sys$epoll_create(int flags)
+{
+    REQUIRE_PROMISE(stdio);
+    if (flags & ~EPOLL_CLOEXEC)
+        return EINVAL;
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    auto description_or_error = FileDescription::create(*EventPoll::create());
+    if (description_or_error.is_error())
+        return description_or_error.error();
+
+    auto description = description_or_error.release_value();
+    description->set_readable(true);
+
+    u32 fd_flags = 0;
+    if (flags & EPOLL_CLOEXEC)
+        fd_flags |= FD_CLOEXEC;
+
+    m_fds[fd].set(move(description), fd_flags);
+    return fd;
+}
+
+KResultOr<int> Process::sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_ctl_params params {};
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    auto epoll_description = file_description(params.epfd);
+    if (!epoll_description)
+        return EBADF;
+    if (!epoll_description->file().is_event_poll())
+        return EINVAL;
+    auto& event_poll = static_cast<EventPoll&>(epoll_description->file());
+
+    // NOTE: We allow EPOLL_CTL_DEL on a closed fd, so stale entries can be cleaned up after close().
+    if (params.op == EPOLL_CTL_DEL)
+        return event_poll.remove(params.fd);
+
+    epoll_event event {};
+    if (!copy_from_user(&event, params.event))
+        return EFAULT;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return EBADF;
+    if (description == epoll_description)
+        return EINVAL;
+
+    switch (params.op) {
+    case EPOLL_CTL_ADD:
+        return event_poll.add(params.fd, *description, event);
+    case EPOLL_CTL_MOD:
+        return event_poll.modify(params.fd, *description, event);
+    default:
+        return EINVAL;
+    }
+}
+
+KResultOr<int> Process::sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_wait_params params {};
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (params.maxevents <= 0)
+        return EINVAL;
+    Checked events_size = sizeof(epoll_event);
+    events_size *= params.maxevents;
+    if (events_size.has_overflow())
+        return EFAULT;
+
+    auto epoll_description = file_description(params.epfd);
+    if (!epoll_description)
+        return EBADF;
+    if (!epoll_description->file().is_event_poll())
+        return EINVAL;
+    auto& event_poll = static_cast<EventPoll&>(epoll_description->file());
+
+    Thread::BlockTimeout timeout;
+    if (params.timeout) {
+        auto timeout_time = copy_time_from_user(params.timeout);
+        if (!timeout_time.has_value())
+            return EFAULT;
+        timeout = Thread::BlockTimeout(false, &timeout_time.value());
+    }
+
+    sigset_t sigmask = {};
+    if (params.sigmask && !copy_from_user(&sigmask, params.sigmask))
+        return EFAULT;
+
+    auto current_thread = Thread::current();
+
+    u32 previous_signal_mask = 0;
+    if (params.sigmask)
+        previous_signal_mask = current_thread->update_signal_mask(sigmask);
+    ScopeGuard rollback_signal_mask([&]() {
+        if (params.sigmask)
+            current_thread->update_signal_mask(previous_signal_mask);
+    });
+
+    Vector<epoll_event> ready_events;
+    for (;;) {
+        if (event_poll.collect_ready_events(ready_events, params.maxevents) > 0)
+            break;
+
+        // The interest set stays registered with the files, so all we block on is the epoll file itself.
+        // NOTE: The timeout is absolute once constructed, so blocking again doesn't extend it.
+        Thread::SelectBlocker::FDVector fds_info;
+        fds_info.append({ *epoll_description, Thread::FileBlocker::BlockFlags::Read });
+        auto block_result = current_thread->block<Thread::SelectBlocker>(timeout, fds_info);
+        if (block_result.was_interrupted())
+            return EINTR;
+        if (block_result.timed_out()) {
+            event_poll.collect_ready_events(ready_events, params.maxevents);
+            break;
+        }
+    }
+
+    if (!ready_events.is_empty() && !copy_to_user(params.events, ready_events.data(), ready_events.size() * sizeof(epoll_event)))
+        return EFAULT;
+    return ready_events.size();
+}
+
+}
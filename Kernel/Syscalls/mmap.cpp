@@ -33,6 +33,7 @@
 #include <Kernel/VM/PrivateInodeVMObject.h>
 #include <Kernel/VM/Region.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/VM/TLBFlushBatch.h>
 #include <LibC/limits.h>
 #include <LibELF/Validation.h>
 
@@ -340,6 +341,10 @@ KResultOr<int> Process::sys$mprotect(Userspace<void*> addr, size_t size, int pro
             return EACCES;
         }
 
+        // All pieces keep the old region's VMObject alive, so the other processors can be
+        // told about all of the remapping below at once.
+        TLBFlushBatch tlb_flush_batch(space().page_directory());
+
         // This vector is the region(s) adjacent to our range.
         // We need to allocate a new region for the range we wanted to change permission bits on.
         auto adjacent_regions = space().split_region_around_range(*old_region, range_to_mprotect);
@@ -413,6 +418,19 @@ KResultOr<int> Process::sys$madvise(Userspace<void*> address, size_t size, int a
             return EPERM;
         return region->is_volatile(VirtualAddress(address), size) ? 0 : 1;
     }
+    bool use_huge_pages = advice & MADV_HUGEPAGE;
+    bool avoid_huge_pages = advice & MADV_NOHUGEPAGE;
+    if (use_huge_pages && avoid_huge_pages)
+        return EINVAL;
+    if (use_huge_pages || avoid_huge_pages) {
+        if (!region->vmobject().is_anonymous())
+            return EPERM;
+        // NOTE: This applies to the whole region. Remapping it puts pages that are already
+        //       physically contiguous into large pages, or splits large pages up again.
+        region->set_huge_pages(use_huge_pages);
+        region->remap();
+        return 0;
+    }
     return EINVAL;
 }
 
@@ -474,6 +492,10 @@ KResultOr<int> Process::sys$munmap(Userspace<void*> addr, size_t size)
         if (!old_region->is_mmap())
             return EPERM;
 
+        // The remaining pieces keep the old region's VMObject alive, so the other processors
+        // can be told about all of the remapping below at once.
+        TLBFlushBatch tlb_flush_batch(space().page_directory());
+
         auto new_regions = space().split_region_around_range(*old_region, range_to_unmap);
 
         // We manually unmap the old region here, specifying that we *don't* want the VM deallocated.
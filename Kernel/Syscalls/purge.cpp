@@ -25,6 +25,8 @@
  */
 
 #include <AK/NonnullRefPtrVector.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/FileSystem/InodePageCache.h>
 #include <Kernel/Process.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/InodeVMObject.h>
@@ -65,6 +67,18 @@ KResultOr<int> Process::sys$purge(int mode)
         for (auto& vmobject : vmobjects) {
             purged_page_count += vmobject.release_all_clean_pages();
         }
+
+        // Now that clean pages are unmapped, most of the page cache can go as well.
+        NonnullRefPtrVector<Inode> inodes;
+        {
+            ScopedSpinLock all_inodes_lock(Inode::all_inodes_lock());
+            for (auto& inode : Inode::all_with_lock()) {
+                if (inode.has_page_cache())
+                    inodes.append(inode);
+            }
+        }
+        for (auto& inode : inodes)
+            purged_page_count += inode.page_cache()->release_unmapped_pages();
     }
     return purged_page_count;
 }
@@ -32,9 +32,8 @@ namespace Kernel {
 
 using BlockFlags = Thread::FileBlocker::BlockFlags;
 
-KResultOr<ssize_t> Process::sys$readv(int fd, Userspace<const struct iovec*> iov, int iov_count)
+KResultOr<ssize_t> Process::do_readv(int fd, Userspace<const struct iovec*> iov, int iov_count, Optional<off_t> offset)
 {
-    REQUIRE_PROMISE(stdio);
     if (iov_count < 0)
         return EINVAL;
 
@@ -42,6 +41,9 @@ KResultOr<ssize_t> Process::sys$readv(int fd, Userspace<const struct iovec*> iov
     if (iov_count > (int)MiB)
         return EFAULT;
 
+    if (offset.has_value() && offset.value() < 0)
+        return EINVAL;
+
     u64 total_length = 0;
     Vector<iovec, 32> vecs;
     vecs.resize(iov_count);
@@ -63,30 +65,60 @@ KResultOr<ssize_t> Process::sys$readv(int fd, Userspace<const struct iovec*> iov
     if (description->is_directory())
         return EISDIR;
 
-    int nread = 0;
-    for (auto& vec : vecs) {
-        if (description->is_blocking()) {
-            if (!description->can_read()) {
-                auto unblock_flags = BlockFlags::None;
-                if (Thread::current()->block<Thread::ReadBlocker>({}, *description, unblock_flags).was_interrupted())
-                    return EINTR;
-                if (!has_flag(unblock_flags, BlockFlags::Read))
-                    return EAGAIN;
-                // TODO: handle exceptions in unblock_flags
-            }
+    if (offset.has_value() && !description->file().is_seekable())
+        return ESPIPE;
+
+    // Like read(), we only wait for some data to become available, and then
+    // return whatever we managed to gather without blocking again.
+    if (description->is_blocking()) {
+        if (!description->can_read()) {
+            auto unblock_flags = BlockFlags::None;
+            if (Thread::current()->block<Thread::ReadBlocker>({}, *description, unblock_flags).was_interrupted())
+                return EINTR;
+            if (!has_flag(unblock_flags, BlockFlags::Read))
+                return EAGAIN;
+            // TODO: handle exceptions in unblock_flags
         }
+    }
+
+    size_t nread = 0;
+    for (auto& vec : vecs) {
+        if (!vec.iov_len)
+            continue;
         auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)vec.iov_base, vec.iov_len);
         if (!buffer.has_value())
             return EFAULT;
-        auto result = description->read(buffer.value(), vec.iov_len);
-        if (result.is_error())
+        auto result = offset.has_value()
+            ? description->read(buffer.value(), offset.value() + nread, vec.iov_len)
+            : description->read(buffer.value(), vec.iov_len);
+        if (result.is_error()) {
+            if (nread)
+                break;
             return result.error();
+        }
         nread += result.value();
+        if (result.value() < vec.iov_len)
+            break;
     }
 
     return nread;
 }
 
+KResultOr<ssize_t> Process::sys$readv(int fd, Userspace<const struct iovec*> iov, int iov_count)
+{
+    REQUIRE_PROMISE(stdio);
+    return do_readv(fd, iov, iov_count, {});
+}
+
+KResultOr<ssize_t> Process::sys$preadv(Userspace<const Syscall::SC_preadv_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_preadv_params params {};
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+    return do_readv(params.fd, Userspace<const struct iovec*>((FlatPtr)params.iov), params.iov_count, params.offset);
+}
+
 KResultOr<ssize_t> Process::sys$read(int fd, Userspace<u8*> buffer, ssize_t size)
 {
     REQUIRE_PROMISE(stdio);
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/NumericLimits.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FileSystem/InodePageCache.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/Process.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+static constexpr size_t max_pages_per_write = 16;
+
+KResultOr<ssize_t> Process::sys$sendfile(Userspace<const Syscall::SC_sendfile_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_sendfile_params params {};
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    auto in_description = file_description(params.in_fd);
+    auto out_description = file_description(params.out_fd);
+    if (!in_description || !out_description)
+        return EBADF;
+    if (!in_description->is_readable() || !out_description->is_writable())
+        return EBADF;
+
+    // Like on other systems, the data has to come from something that could be mmap()ed.
+    auto* inode = in_description->inode();
+    if (!inode || !inode->metadata().is_regular_file())
+        return EINVAL;
+    if (out_description->should_append())
+        return EINVAL;
+
+    off_t offset = in_description->offset();
+    if (params.offset) {
+        if (!copy_from_user(&offset, params.offset))
+            return EFAULT;
+        if (offset < 0)
+            return EINVAL;
+    }
+    size_t count = min(params.count, (size_t)NumericLimits<i32>::max());
+
+    auto send_bytes = [&](ReadonlyBytes bytes) -> KResultOr<size_t> {
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(bytes.data()));
+        auto nwritten_or_error = do_write(*out_description, buffer, bytes.size());
+        if (nwritten_or_error.is_error())
+            return nwritten_or_error.error();
+        return (size_t)nwritten_or_error.value();
+    };
+
+    // Map the cached pages into the kernel and write straight from there, so the only copy of the
+    // data is the one the destination makes. Holding on to the pages keeps the cache from reusing
+    // them while we're blocked in the write, without holding the cache lock.
+    size_t total_sent = 0;
+    bool done = false;
+    if (auto* page_cache = in_description->is_direct() ? nullptr : inode->page_cache()) {
+        while (total_sent < count) {
+            size_t position = offset + total_sent;
+            size_t file_size = inode->size();
+            if (position >= file_size) {
+                done = true;
+                break;
+            }
+            size_t end = min(position + (count - total_sent), file_size);
+            size_t first_page = position / PAGE_SIZE;
+            size_t end_page = min(first_page + max_pages_per_write, (end - 1) / PAGE_SIZE + 1);
+
+            NonnullRefPtrVector<PhysicalPage> pages;
+            for (auto& page : page_cache->pages_for_shared_mapping(first_page, end_page)) {
+                if (!page)
+                    break;
+                pages.append(*page);
+            }
+            // If the cache couldn't provide the pages, the bounce buffer below picks up from here.
+            if (pages.is_empty())
+                break;
+            size_t mapped_size = pages.size() * PAGE_SIZE;
+            auto region = MM.allocate_kernel_region_with_vmobject(AnonymousVMObject::create_with_physical_pages(move(pages)), mapped_size, "sendfile", Region::Access::Read);
+            if (!region)
+                break;
+
+            size_t offset_in_region = position % PAGE_SIZE;
+            size_t span_size = min(mapped_size - offset_in_region, end - position);
+            auto nsent_or_error = send_bytes({ region->vaddr().offset(offset_in_region).as_ptr(), span_size });
+            if (nsent_or_error.is_error()) {
+                if (!total_sent)
+                    return nsent_or_error.error();
+                done = true;
+                break;
+            }
+            total_sent += nsent_or_error.value();
+            if (nsent_or_error.value() < span_size) {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    if (!done && total_sent < count) {
+        auto bounce_buffer = KBuffer::try_create_with_size(PAGE_SIZE, Region::Access::Read | Region::Access::Write, "sendfile");
+        if (!bounce_buffer && !total_sent)
+            return ENOMEM;
+        while (bounce_buffer && total_sent < count) {
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(bounce_buffer->data());
+            auto nread = inode->read_bytes(offset + total_sent, min((size_t)PAGE_SIZE, count - total_sent), buffer, in_description);
+            if (nread < 0) {
+                if (total_sent)
+                    break;
+                return KResult((ErrnoCode)-nread);
+            }
+            if (nread == 0)
+                break;
+            auto nsent_or_error = send_bytes(ReadonlyBytes { bounce_buffer->data(), (size_t)nread });
+            if (nsent_or_error.is_error()) {
+                if (total_sent)
+                    break;
+                return nsent_or_error.error();
+            }
+            total_sent += nsent_or_error.value();
+            if (nsent_or_error.value() < (size_t)nread)
+                break;
+        }
+    }
+
+    if (total_sent)
+        Thread::current()->did_file_read(total_sent);
+
+    if (params.offset) {
+        off_t new_offset = offset + total_sent;
+        if (!copy_to_user(params.offset, &new_offset))
+            return EFAULT;
+    } else {
+        in_description->seek(offset + total_sent, SEEK_SET);
+    }
+    return total_sent;
+}
+
+}
@@ -379,7 +379,7 @@ KResultOr<int> Process::sys$setsockopt(Userspace<const Syscall::SC_setsockopt_pa
         return ENOTSOCK;
     auto& socket = *description->socket();
     REQUIRE_PROMISE_FOR_SOCKET_DOMAIN(socket.domain());
-    return socket.setsockopt(params.level, params.option, user_value, params.value_size);
+    return socket.setsockopt(*description, params.level, params.option, user_value, params.value_size);
 }
 
 }
@@ -31,9 +31,8 @@
 
 namespace Kernel {
 
-KResultOr<ssize_t> Process::sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count)
+KResultOr<ssize_t> Process::do_writev(int fd, Userspace<const struct iovec*> iov, int iov_count, Optional<off_t> offset)
 {
-    REQUIRE_PROMISE(stdio);
     if (iov_count < 0)
         return EINVAL;
 
@@ -41,6 +40,9 @@ KResultOr<ssize_t> Process::sys$writev(int fd, Userspace<const struct iovec*> io
     if (iov_count > (int)MiB)
         return EFAULT;
 
+    if (offset.has_value() && offset.value() < 0)
+        return EINVAL;
+
     u64 total_length = 0;
     Vector<iovec, 32> vecs;
     vecs.resize(iov_count);
@@ -59,24 +61,49 @@ KResultOr<ssize_t> Process::sys$writev(int fd, Userspace<const struct iovec*> io
     if (!description->is_writable())
         return EBADF;
 
-    int nwritten = 0;
+    if (offset.has_value() && !description->file().is_seekable())
+        return ESPIPE;
+
+    size_t nwritten = 0;
     for (auto& vec : vecs) {
+        if (!vec.iov_len)
+            continue;
         auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)vec.iov_base, vec.iov_len);
         if (!buffer.has_value())
             return EFAULT;
-        auto result = do_write(*description, buffer.value(), vec.iov_len);
+        Optional<off_t> vec_offset;
+        if (offset.has_value())
+            vec_offset = offset.value() + nwritten;
+        auto result = do_write(*description, buffer.value(), vec.iov_len, vec_offset);
         if (result.is_error()) {
             if (nwritten == 0)
                 return result.error();
             return nwritten;
         }
         nwritten += result.value();
+        if ((size_t)result.value() < vec.iov_len)
+            break;
     }
 
     return nwritten;
 }
 
-KResultOr<ssize_t> Process::do_write(FileDescription& description, const UserOrKernelBuffer& data, size_t data_size)
+KResultOr<ssize_t> Process::sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count)
+{
+    REQUIRE_PROMISE(stdio);
+    return do_writev(fd, iov, iov_count, {});
+}
+
+KResultOr<ssize_t> Process::sys$pwritev(Userspace<const Syscall::SC_pwritev_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_pwritev_params params {};
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+    return do_writev(params.fd, Userspace<const struct iovec*>((FlatPtr)params.iov), params.iov_count, params.offset);
+}
+
+KResultOr<ssize_t> Process::do_write(FileDescription& description, const UserOrKernelBuffer& data, size_t data_size, Optional<off_t> offset)
 {
     ssize_t total_nwritten = 0;
     if (!description.is_blocking()) {
@@ -84,7 +111,7 @@ KResultOr<ssize_t> Process::do_write(FileDescription& description, const UserOrK
             return EAGAIN;
     }
 
-    if (description.should_append())
+    if (!offset.has_value() && description.should_append())
         description.seek(0, SEEK_END);
 
     while ((size_t)total_nwritten < data_size) {
@@ -101,7 +128,9 @@ KResultOr<ssize_t> Process::do_write(FileDescription& description, const UserOrK
             }
             // TODO: handle exceptions in unblock_flags
         }
-        auto nwritten_or_error = description.write(data.offset(total_nwritten), data_size - total_nwritten);
+        auto nwritten_or_error = offset.has_value()
+            ? description.write(offset.value() + total_nwritten, data.offset(total_nwritten), data_size - total_nwritten)
+            : description.write(data.offset(total_nwritten), data_size - total_nwritten);
         if (nwritten_or_error.is_error()) {
             if (total_nwritten)
                 return total_nwritten;
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/FileSystem/InodePageCache.h>
+#include <Kernel/Process.h>
+#include <Kernel/Scheduler.h>
+#include <Kernel/Tasks/PageZeroingTask.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+static WaitQueue* s_page_zeroing_wait_queue;
+static Atomic<bool> s_page_zeroing_has_work { true };
+
+void PageZeroingTask::spawn()
+{
+    s_page_zeroing_wait_queue = new WaitQueue;
+    RefPtr<Thread> page_zeroing_thread;
+    Process::create_kernel_process(page_zeroing_thread, "PageZeroingTask", [] {
+        dbgln("PageZeroingTask is running");
+        for (;;) {
+            if (s_page_zeroing_has_work.exchange(false, AK::MemoryOrder::memory_order_acq_rel)) {
+                // Cached file data is the easiest memory to give back when it runs low.
+                if (MM.is_low_on_memory())
+                    InodePageCache::shrink(MemoryManager::low_memory_page_count);
+                size_t zeroed_page_count = 0;
+                while (MM.add_page_to_zeroed_page_pool()) {
+                    if (++zeroed_page_count % 16 == 0)
+                        Scheduler::yield();
+                }
+            }
+            s_page_zeroing_wait_queue->wait_forever("PageZeroingTask");
+        }
+    });
+    // Only ever run when there is nothing better to do
+    if (page_zeroing_thread)
+        page_zeroing_thread->set_priority(THREAD_PRIORITY_MIN);
+}
+
+void PageZeroingTask::wake()
+{
+    if (!s_page_zeroing_wait_queue)
+        return;
+    if (s_page_zeroing_has_work.exchange(true, AK::MemoryOrder::memory_order_acq_rel) == false)
+        s_page_zeroing_wait_queue->wake_all();
+}
+
+}
@@ -88,6 +88,7 @@ class Thread
     friend class Process;
     friend class Scheduler;
     friend class ThreadReadyQueue;
+    friend struct ThreadReadyQueues;
 
     static SpinLock<u8> g_tid_map_lock;
     static HashMap<ThreadID, Thread*>* g_tid_map;
@@ -992,6 +993,11 @@ public:
     void did_zero_fault() { ++m_zero_faults; }
     unsigned cow_faults() const { return m_cow_faults; }
     void did_cow_fault() { ++m_cow_faults; }
+    unsigned tlb_flush_ipis() const { return m_tlb_flush_ipis; }
+    void did_send_tlb_flush_ipis(unsigned count) { m_tlb_flush_ipis += count; }
+
+    TLBFlushBatch* tlb_flush_batch() { return m_tlb_flush_batch; }
+    void set_tlb_flush_batch(TLBFlushBatch* batch) { m_tlb_flush_batch = batch; }
 
     unsigned file_read_bytes() const { return m_file_read_bytes; }
     unsigned file_write_bytes() const { return m_file_write_bytes; }
@@ -1130,6 +1136,7 @@ private:
 
     IntrusiveListNode m_process_thread_list_node;
     int m_runnable_priority { -1 };
+    u32 m_runnable_cpu { 0 };
 
     friend class WaitQueue;
 
@@ -1239,6 +1246,9 @@ private:
     unsigned m_inode_faults { 0 };
     unsigned m_zero_faults { 0 };
     unsigned m_cow_faults { 0 };
+    unsigned m_tlb_flush_ipis { 0 };
+
+    TLBFlushBatch* m_tlb_flush_batch { nullptr };
 
     unsigned m_file_read_bytes { 0 };
     unsigned m_file_write_bytes { 0 };
@@ -391,6 +391,39 @@ size_t AnonymousVMObject::mark_committed_pages_for_nonvolatile_range(const Volat
     return pages_updated;
 }
 
+bool AnonymousVMObject::populate_huge_page(size_t first_page_index)
+{
+    constexpr size_t huge_page_count = HUGE_PAGE_SIZE / PAGE_SIZE;
+    VERIFY(first_page_index + huge_page_count <= page_count());
+
+    // Only untouched memory can be replaced wholesale by a large page, and
+    // purgeable memory is left alone so it can still be purged page by page.
+    size_t lazy_committed_page_count = 0;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (!m_purgeable_ranges.is_empty())
+            return false;
+        for (size_t i = first_page_index; i < first_page_index + huge_page_count; ++i) {
+            auto& page = m_physical_pages[i];
+            if (!page || !(page->is_shared_zero_page() || page->is_lazy_committed_page()))
+                return false;
+            if (page->is_lazy_committed_page())
+                ++lazy_committed_page_count;
+        }
+    }
+
+    auto huge_page = MM.allocate_user_huge_page(lazy_committed_page_count);
+    if (huge_page.is_empty())
+        return false;
+
+    ScopedSpinLock lock(m_lock);
+    VERIFY(m_unused_committed_pages >= lazy_committed_page_count);
+    m_unused_committed_pages -= lazy_committed_page_count;
+    for (size_t i = 0; i < huge_page_count; ++i)
+        m_physical_pages[first_page_index + i] = huge_page[i];
+    return true;
+}
+
 RefPtr<PhysicalPage> AnonymousVMObject::allocate_committed_page(size_t page_index)
 {
     {
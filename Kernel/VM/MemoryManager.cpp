@@ -29,17 +29,21 @@
 #include <AK/StringView.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/CMOS.h>
+#include <Kernel/CommandLine.h>
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/FileSystem/InodePageCache.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/Multiboot.h>
 #include <Kernel/Process.h>
 #include <Kernel/StdLib.h>
+#include <Kernel/Tasks/PageZeroingTask.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/ContiguousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/PhysicalRegion.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/VM/TLBFlushBatch.h>
 
 extern u8* start_of_kernel_image;
 extern u8* end_of_kernel_image;
@@ -71,6 +75,29 @@ MemoryManager& MM
     return *s_the;
 }
 
+static void zero_page_non_temporal(u8* page)
+{
+    if (!Processor::current().has_feature(CPUFeature::SSE2)) {
+        fast_u32_fill((u32*)page, 0, PAGE_SIZE / sizeof(u32));
+        return;
+    }
+    // Pages zeroed ahead of time won't be touched again for a while,
+    // so keep them from pushing everything else out of the caches.
+    auto* ptr = (u32*)page;
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(u32); i += 4) {
+        asm volatile(
+            "movnti %1, 0(%0)\n"
+            "movnti %1, 4(%0)\n"
+            "movnti %1, 8(%0)\n"
+            "movnti %1, 12(%0)\n"
+            :
+            : "r"(ptr + i), "r"(0)
+            : "memory");
+    }
+    asm volatile("sfence" ::
+                     : "memory");
+}
+
 bool MemoryManager::is_initialized()
 {
     return s_the != nullptr;
@@ -81,7 +108,7 @@ UNMAP_AFTER_INIT MemoryManager::MemoryManager()
     ScopedSpinLock lock(s_mm_lock);
     m_kernel_page_directory = PageDirectory::create_kernel_page_directory();
     parse_memory_map();
-    write_cr3(kernel_page_directory().cr3());
+    Processor::switch_page_directory(kernel_page_directory().cr3());
     protect_kernel_image();
 
     // We're temporarily "committing" to two pages that we need to allocate below
@@ -97,6 +124,8 @@ UNMAP_AFTER_INIT MemoryManager::MemoryManager()
     // By using a tag we don't have to query the VMObject for every page
     // whether it was committed or not
     m_lazy_committed_page = allocate_committed_user_physical_page();
+
+    m_fault_around_pages = kernel_command_line().fault_around_pages();
 }
 
 UNMAP_AFTER_INIT MemoryManager::~MemoryManager()
@@ -327,7 +356,7 @@ PageTableEntry* MemoryManager::pte(PageDirectory& page_directory, VirtualAddress
 
     auto* pd = quickmap_pd(const_cast<PageDirectory&>(page_directory), page_directory_table_index);
     const PageDirectoryEntry& pde = pd[page_directory_index];
-    if (!pde.is_present())
+    if (!pde.is_present() || pde.is_huge())
         return nullptr;
 
     return &quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()))[page_table_index];
@@ -343,7 +372,10 @@ PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, Virtual
     u32 page_table_index = (vaddr.get() >> 12) & 0x1ff;
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
-    PageDirectoryEntry& pde = pd[page_directory_index];
+    auto* pde_ptr = &pd[page_directory_index];
+    if (pde_ptr->is_present() && pde_ptr->is_huge())
+        split_huge_pde(page_directory, *pde_ptr, vaddr);
+    PageDirectoryEntry& pde = *pde_ptr;
     if (!pde.is_present()) {
         bool did_purge = false;
         auto page_table = allocate_user_physical_page(ShouldZeroFill::Yes, &did_purge);
@@ -384,7 +416,10 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
     u32 page_table_index = (vaddr.get() >> 12) & 0x1ff;
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
-    PageDirectoryEntry& pde = pd[page_directory_index];
+    auto* pde_ptr = &pd[page_directory_index];
+    if (pde_ptr->is_present() && pde_ptr->is_huge())
+        split_huge_pde(page_directory, *pde_ptr, vaddr);
+    PageDirectoryEntry& pde = *pde_ptr;
     if (pde.is_present()) {
         auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
         auto& pte = page_table[page_table_index];
@@ -403,13 +438,109 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
             if (all_clear) {
                 pde.clear();
 
-                auto result = page_directory.m_page_tables.remove(vaddr.get() & ~0x1fffff);
+                auto page_table_key = vaddr.get() & ~0x1fffff;
+                // Other processors may walk this page table until a batched flush reaches them.
+                if (auto* current_thread = Thread::current(); current_thread && current_thread->tlb_flush_batch())
+                    current_thread->tlb_flush_batch()->keep_alive_until_flushed(page_directory, page_directory.m_page_tables.get(page_table_key).value());
+                auto result = page_directory.m_page_tables.remove(page_table_key);
                 VERIFY(result);
             }
         }
     }
 }
 
+PageDirectoryEntry* MemoryManager::ensure_huge_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    VERIFY(!(vaddr.get() & (HUGE_PAGE_SIZE - 1)));
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    auto* pde = &pd[page_directory_index];
+    if (pde->is_present() && !pde->is_huge()) {
+        // Leave page tables we didn't allocate ourselves (like the boot ones) alone.
+        if (!page_directory.m_page_tables.contains(vaddr.get()))
+            return nullptr;
+        // The caller is about to map the whole 2 MiB with this entry. Keep the page table
+        // around so that splitting the large page later on never has to allocate one.
+        pde->clear();
+        return pde;
+    }
+    if (!pde->is_present()) {
+        // Every large page has a page table set aside for when it gets split.
+        // That way release_pte() can always unmap a single page inside of it.
+        bool did_purge = false;
+        auto page_table = allocate_user_physical_page(ShouldZeroFill::No, &did_purge);
+        if (!page_table) {
+            dbgln("MM: Unable to allocate page table to map large page at {}", vaddr);
+            return nullptr;
+        }
+        if (did_purge) {
+            // Purging may have quickmapped other page directories
+            pde = &quickmap_pd(page_directory, page_directory_table_index)[page_directory_index];
+            VERIFY(!pde->is_present());
+        }
+        auto result = page_directory.m_page_tables.set(vaddr.get(), move(page_table));
+        VERIFY(result == AK::HashSetResult::InsertedNewEntry);
+    }
+    return pde;
+}
+
+bool MemoryManager::release_huge_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    VERIFY(!(vaddr.get() & (HUGE_PAGE_SIZE - 1)));
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    PageDirectoryEntry& pde = pd[page_directory_index];
+    if (!pde.is_present() || !pde.is_huge())
+        return false;
+    pde.clear();
+    // The page table set aside for splitting isn't reachable through the page directory, so it can go right away.
+    auto result = page_directory.m_page_tables.remove(vaddr.get());
+    VERIFY(result);
+    return true;
+}
+
+void MemoryManager::split_huge_pde(PageDirectory& page_directory, PageDirectoryEntry& pde, VirtualAddress vaddr)
+{
+    VERIFY(pde.is_present() && pde.is_huge());
+    VirtualAddress huge_page_vaddr(vaddr.get() & ~(HUGE_PAGE_SIZE - 1));
+    auto page_table = page_directory.m_page_tables.get(huge_page_vaddr.get());
+    VERIFY(page_table.has_value());
+
+    // Same mapping, just described by 512 small pages instead of one large one.
+    auto huge_pde = pde;
+    auto* ptes = quickmap_pt(page_table.value()->paddr());
+    for (size_t i = 0; i < HUGE_PAGE_SIZE / PAGE_SIZE; ++i) {
+        auto& pte = ptes[i];
+        pte.clear();
+        pte.set_physical_page_base((FlatPtr)huge_pde.page_table_base() + i * PAGE_SIZE);
+        pte.set_present(true);
+        pte.set_writable(huge_pde.is_writable());
+        pte.set_user_allowed(huge_pde.is_user_allowed());
+        pte.set_cache_disabled(huge_pde.is_cache_disabled());
+        pte.set_execute_disabled(huge_pde.is_execute_disabled());
+    }
+
+    pde.clear();
+    pde.set_page_table_base(page_table.value()->paddr().get());
+    pde.set_user_allowed(true);
+    pde.set_present(true);
+    pde.set_writable(true);
+    pde.set_global(&page_directory == m_kernel_page_directory.ptr());
+
+    // Invalidating any address inside the large page drops its TLB entry.
+    flush_tlb(&page_directory, huge_page_vaddr);
+}
+
 UNMAP_AFTER_INIT void MemoryManager::initialize(u32 cpu)
 {
     auto mm_data = new MemoryManagerData;
@@ -497,13 +628,18 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region(size_t size, String name, R
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    // Big regions that get populated on demand can be backed by large pages.
+    bool use_huge_pages = size >= HUGE_PAGE_SIZE && strategy != AllocationStrategy::AllocateNow;
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, use_huge_pages ? HUGE_PAGE_SIZE : PAGE_SIZE);
     if (!range.has_value())
         return {};
     auto vmobject = AnonymousVMObject::create_with_size(size, strategy);
     if (!vmobject)
         return {};
-    return allocate_kernel_region_with_vmobject(range.value(), vmobject.release_nonnull(), move(name), access, cacheable);
+    auto region = Region::create_kernel_only(range.value(), vmobject.release_nonnull(), 0, move(name), access, cacheable);
+    region->set_huge_pages(use_huge_pages);
+    region->map(kernel_page_directory());
+    return region;
 }
 
 OwnPtr<Region> MemoryManager::allocate_kernel_region(PhysicalAddress paddr, size_t size, String name, Region::Access access, Region::Cacheable cacheable)
@@ -573,31 +709,85 @@ void MemoryManager::uncommit_user_physical_pages(size_t page_count)
     m_user_physical_pages_committed -= page_count;
 }
 
-void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+void MemoryManager::return_user_physical_page_to_region(PhysicalAddress paddr)
 {
-    ScopedSpinLock lock(s_mm_lock);
+    VERIFY(s_mm_lock.is_locked());
     for (auto& region : m_user_physical_regions) {
-        if (!region.contains(page))
+        if (!region.contains(paddr))
             continue;
-
-        region.return_page(page);
-        --m_user_physical_pages_used;
-
-        // Always return pages to the uncommitted pool. Pages that were
-        // committed and allocated are only freed upon request. Once
-        // returned there is no guarantee being able to get them back.
-        ++m_user_physical_pages_uncommitted;
+        region.return_page_address(paddr);
         return;
     }
 
-    dmesgln("MM: deallocate_user_physical_page couldn't figure out region for user page @ {}", page.paddr());
+    dmesgln("MM: return_user_physical_page_to_region couldn't figure out region for user page @ {}", paddr);
     VERIFY_NOT_REACHED();
 }
 
-RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed)
+void MemoryManager::refill_user_page_cache(MemoryManagerData& mm_data)
+{
+    VERIFY(s_mm_lock.is_locked());
+    for (auto& region : m_user_physical_regions) {
+        while (mm_data.m_user_page_cache_count < MemoryManagerData::user_page_cache_size / 2 && region.free()) {
+            auto paddr = region.take_free_page_address();
+            VERIFY(paddr.has_value());
+            mm_data.m_user_page_cache[mm_data.m_user_page_cache_count++] = paddr.value();
+        }
+        if (mm_data.m_user_page_cache_count == MemoryManagerData::user_page_cache_size / 2)
+            return;
+    }
+}
+
+void MemoryManager::flush_user_page_cache(MemoryManagerData& mm_data, size_t keep_count)
+{
+    VERIFY(s_mm_lock.is_locked());
+    while (mm_data.m_user_page_cache_count > keep_count)
+        return_user_physical_page_to_region(mm_data.m_user_page_cache[--mm_data.m_user_page_cache_count]);
+}
+
+void MemoryManager::flush_all_user_page_caches()
+{
+    VERIFY(s_mm_lock.is_locked());
+    Processor::for_each([&](Processor& processor) {
+        if (processor.has_mm_data())
+            flush_user_page_cache(processor.get_mm_data(), 0);
+        return IterationDecision::Continue;
+    });
+}
+
+Optional<PhysicalAddress> MemoryManager::take_free_user_physical_page_address()
+{
+    VERIFY(s_mm_lock.is_locked());
+    auto& mm_data = get_data();
+    if (mm_data.m_user_page_cache_count == 0)
+        refill_user_page_cache(mm_data);
+    if (mm_data.m_user_page_cache_count == 0) {
+        // The regions ran dry, but other processors may still be holding on to some pages
+        flush_all_user_page_caches();
+        refill_user_page_cache(mm_data);
+    }
+    if (mm_data.m_user_page_cache_count == 0)
+        return {};
+    return mm_data.m_user_page_cache[--mm_data.m_user_page_cache_count];
+}
+
+void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+{
+    ScopedSpinLock lock(s_mm_lock);
+    auto& mm_data = get_data();
+    if (mm_data.m_user_page_cache_count == MemoryManagerData::user_page_cache_size)
+        flush_user_page_cache(mm_data, MemoryManagerData::user_page_cache_size / 2);
+    mm_data.m_user_page_cache[mm_data.m_user_page_cache_count++] = page.paddr();
+    --m_user_physical_pages_used;
+
+    // Always return pages to the uncommitted pool. Pages that were
+    // committed and allocated are only freed upon request. Once
+    // returned there is no guarantee being able to get them back.
+    ++m_user_physical_pages_uncommitted;
+}
+
+RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed, ShouldZeroFill should_zero_fill)
 {
     VERIFY(s_mm_lock.is_locked());
-    RefPtr<PhysicalPage> page;
     if (committed) {
         // Draw from the committed pages pool. We should always have these pages available
         VERIFY(m_user_physical_pages_committed > 0);
@@ -608,33 +798,102 @@ RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed)
             return {};
         m_user_physical_pages_uncommitted--;
     }
-    for (auto& region : m_user_physical_regions) {
-        page = region.take_free_page(false);
-        if (!page.is_null()) {
-            ++m_user_physical_pages_used;
-            break;
+
+    Optional<PhysicalAddress> paddr;
+    bool is_zeroed = false;
+    if (should_zero_fill == ShouldZeroFill::Yes) {
+        if (m_zeroed_page_count > 0) {
+            ++m_zeroed_page_pool_hits;
+            paddr = m_zeroed_pages[--m_zeroed_page_count];
+            is_zeroed = true;
+        } else {
+            ++m_zeroed_page_pool_misses;
         }
     }
-    VERIFY(!committed || !page.is_null());
-    return page;
+    if (should_zero_fill == ShouldZeroFill::Yes && m_zeroed_page_count < zeroed_page_pool_low_water_mark)
+        PageZeroingTask::wake();
+    else if (is_low_on_memory() && InodePageCache::total_cached_page_count() > 0)
+        PageZeroingTask::wake();
+    if (!paddr.has_value())
+        paddr = take_free_user_physical_page_address();
+    if (!paddr.has_value() && m_zeroed_page_count > 0) {
+        // Everything else is gone, so use what is left in the pool
+        paddr = m_zeroed_pages[--m_zeroed_page_count];
+        is_zeroed = true;
+    }
+    VERIFY(!committed || paddr.has_value());
+    if (!paddr.has_value())
+        return {};
+    ++m_user_physical_pages_used;
+
+    if (should_zero_fill == ShouldZeroFill::Yes && !is_zeroed) {
+        auto* ptr = quickmap_page(paddr.value());
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
+    return PhysicalPage::create(paddr.value(), false);
 }
 
-NonnullRefPtr<PhysicalPage> MemoryManager::allocate_committed_user_physical_page(ShouldZeroFill should_zero_fill)
+bool MemoryManager::add_page_to_zeroed_page_pool()
 {
-    ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page(true);
-    if (should_zero_fill == ShouldZeroFill::Yes) {
-        auto* ptr = quickmap_page(*page);
-        memset(ptr, 0, PAGE_SIZE);
+    PhysicalAddress paddr;
+    {
+        ScopedSpinLock lock(s_mm_lock);
+        if (m_zeroed_page_count == zeroed_page_pool_size)
+            return false;
+        // Don't tie up pages in the pool when memory is getting tight
+        if (is_low_on_memory())
+            return false;
+        Optional<PhysicalAddress> free_page;
+        for (auto& region : m_user_physical_regions) {
+            if (region.free()) {
+                free_page = region.take_free_page_address();
+                break;
+            }
+        }
+        if (!free_page.has_value())
+            return false;
+        paddr = free_page.value();
+    }
+
+    {
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(paddr);
+        zero_page_non_temporal(ptr);
         unquickmap_page();
     }
+
+    ScopedSpinLock lock(s_mm_lock);
+    if (m_zeroed_page_count == zeroed_page_pool_size) {
+        return_user_physical_page_to_region(paddr);
+        return false;
+    }
+    m_zeroed_pages[m_zeroed_page_count++] = paddr;
+    return true;
+}
+
+void MemoryManager::record_zero_fault_latency(Time latency)
+{
+    auto microseconds = latency.to_microseconds();
+    size_t bucket = 0;
+    while (microseconds > 0 && bucket < zero_fault_latency_bucket_count - 1) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    ++m_zero_fault_latency_histogram[bucket];
+}
+
+NonnullRefPtr<PhysicalPage> MemoryManager::allocate_committed_user_physical_page(ShouldZeroFill should_zero_fill)
+{
+    ScopedSpinLock lock(s_mm_lock);
+    auto page = find_free_user_physical_page(true, should_zero_fill);
     return page.release_nonnull();
 }
 
 RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge)
 {
     ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page(false);
+    auto page = find_free_user_physical_page(false, should_zero_fill);
     bool purged_pages = false;
 
     if (!page) {
@@ -646,7 +905,7 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
             int purged_page_count = static_cast<AnonymousVMObject&>(vmobject).purge_with_interrupts_disabled({});
             if (purged_page_count) {
                 dbgln("MM: Purge saved the day! Purged {} pages from AnonymousVMObject", purged_page_count);
-                page = find_free_user_physical_page(false);
+                page = find_free_user_physical_page(false, should_zero_fill);
                 purged_pages = true;
                 VERIFY(page);
                 return IterationDecision::Break;
@@ -659,17 +918,47 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
         }
     }
 
-    if (should_zero_fill == ShouldZeroFill::Yes) {
-        auto* ptr = quickmap_page(*page);
-        memset(ptr, 0, PAGE_SIZE);
-        unquickmap_page();
-    }
-
     if (did_purge)
         *did_purge = purged_pages;
     return page;
 }
 
+NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_user_huge_page(size_t committed_page_count)
+{
+    constexpr size_t page_count = HUGE_PAGE_SIZE / PAGE_SIZE;
+    VERIFY(committed_page_count <= page_count);
+    ScopedSpinLock lock(s_mm_lock);
+    VERIFY(m_user_physical_pages_committed >= committed_page_count);
+    size_t uncommitted_page_count = page_count - committed_page_count;
+    if (m_user_physical_pages_uncommitted < uncommitted_page_count)
+        return {};
+
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    for (int attempt = 0; attempt < 2 && physical_pages.is_empty(); ++attempt) {
+        // The processor caches may be holding the pages we need to complete a block
+        if (attempt == 1)
+            flush_all_user_page_caches();
+        for (auto& region : m_user_physical_regions) {
+            physical_pages = region.take_contiguous_free_pages(page_count, false, HUGE_PAGE_SIZE);
+            if (!physical_pages.is_empty())
+                break;
+        }
+    }
+    if (physical_pages.is_empty())
+        return {};
+
+    m_user_physical_pages_committed -= committed_page_count;
+    m_user_physical_pages_uncommitted -= uncommitted_page_count;
+    m_user_physical_pages_used += page_count;
+
+    for (auto& page : physical_pages) {
+        auto* ptr = quickmap_page(page);
+        fast_u32_fill((u32*)ptr, 0, PAGE_SIZE / sizeof(u32));
+        unquickmap_page();
+    }
+    return physical_pages;
+}
+
 void MemoryManager::deallocate_supervisor_physical_page(const PhysicalPage& page)
 {
     ScopedSpinLock lock(s_mm_lock);
@@ -698,7 +987,7 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     for (auto& region : m_super_physical_regions) {
         physical_pages = region.take_contiguous_free_pages(count, true, physical_alignment);
         if (!physical_pages.is_empty())
-            continue;
+            break;
     }
 
     if (physical_pages.is_empty()) {
@@ -755,7 +1044,7 @@ void MemoryManager::enter_space(Space& space)
     ScopedSpinLock lock(s_mm_lock);
 
     current_thread->tss().cr3 = space.page_directory().cr3();
-    write_cr3(space.page_directory().cr3());
+    Processor::switch_page_directory(space.page_directory().cr3());
 }
 
 void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
@@ -765,7 +1054,34 @@ void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 
 void MemoryManager::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
-    Processor::flush_tlb(page_directory, vaddr, page_count);
+    // Whatever a page fault changed has to be visible everywhere before we return from it.
+    if (auto* current_thread = Thread::current(); current_thread && !current_thread->is_handling_page_fault()) {
+        if (auto* batch = current_thread->tlb_flush_batch(); batch && batch->try_add(*page_directory, vaddr, page_count)) {
+            s_the->m_batched_tlb_flushes++;
+            return;
+        }
+    }
+    flush_tlb_now(page_directory, vaddr, page_count);
+}
+
+void MemoryManager::flush_tlb_now(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
+{
+    auto ipi_count = Processor::flush_tlb(page_directory, vaddr, page_count);
+    if (!s_the)
+        return;
+    if (page_count > Processor::full_tlb_flush_threshold)
+        s_the->m_full_tlb_flushes++;
+    if (ipi_count) {
+        s_the->m_tlb_flush_ipis += ipi_count;
+        if (auto* current_thread = Thread::current())
+            current_thread->did_send_tlb_flush_ipis(ipi_count);
+    }
+}
+
+void MemoryManager::record_syscall_tlb_flush_ipis(FlatPtr function, unsigned ipi_count)
+{
+    if (function < Syscall::Function::__Count)
+        m_syscall_tlb_flush_ipis[function] += ipi_count;
 }
 
 extern "C" PageTableEntry boot_pd3_pt1023[1024];
@@ -822,6 +1138,11 @@ PageTableEntry* MemoryManager::quickmap_pt(PhysicalAddress pt_paddr)
 }
 
 u8* MemoryManager::quickmap_page(PhysicalPage& physical_page)
+{
+    return quickmap_page(physical_page.paddr());
+}
+
+u8* MemoryManager::quickmap_page(PhysicalAddress paddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
     auto& mm_data = get_data();
@@ -832,8 +1153,8 @@ u8* MemoryManager::quickmap_page(PhysicalPage& physical_page)
     VirtualAddress vaddr(0xffe00000 + pte_idx * PAGE_SIZE);
 
     auto& pte = boot_pd3_pt1023[pte_idx];
-    if (pte.physical_page_base() != physical_page.paddr().as_ptr()) {
-        pte.set_physical_page_base(physical_page.paddr().get());
+    if (pte.physical_page_base() != paddr.as_ptr()) {
+        pte.set_physical_page_base(paddr.get());
         pte.set_present(true);
         pte.set_writable(true);
         pte.set_user_allowed(false);
@@ -29,6 +29,8 @@
 #include <AK/HashTable.h>
 #include <AK/NonnullRefPtrVector.h>
 #include <AK/String.h>
+#include <AK/Time.h>
+#include <Kernel/API/Syscall.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/Forward.h>
 #include <Kernel/SpinLock.h>
@@ -113,6 +115,12 @@ struct MemoryManagerData {
 
     PhysicalAddress m_last_quickmap_pd;
     PhysicalAddress m_last_quickmap_pt;
+
+    // Recently freed user physical pages, handed out again before going
+    // back to the physical regions. Only touched with s_mm_lock held.
+    static constexpr size_t user_page_cache_size = 32;
+    PhysicalAddress m_user_page_cache[user_page_cache_size];
+    size_t m_user_page_cache_count { 0 };
 };
 
 extern RecursiveSpinLock s_mm_lock;
@@ -124,6 +132,7 @@ class MemoryManager {
     friend class PhysicalRegion;
     friend class AnonymousVMObject;
     friend class Region;
+    friend class TLBFlushBatch;
     friend class VMObject;
 
 public:
@@ -157,6 +166,7 @@ public:
     NonnullRefPtr<PhysicalPage> allocate_committed_user_physical_page(ShouldZeroFill = ShouldZeroFill::Yes);
     RefPtr<PhysicalPage> allocate_user_physical_page(ShouldZeroFill = ShouldZeroFill::Yes, bool* did_purge = nullptr);
     RefPtr<PhysicalPage> allocate_supervisor_physical_page();
+    NonnullRefPtrVector<PhysicalPage> allocate_user_huge_page(size_t committed_page_count);
     NonnullRefPtrVector<PhysicalPage> allocate_contiguous_supervisor_physical_pages(size_t size, size_t physical_alignment = PAGE_SIZE);
     void deallocate_user_physical_page(const PhysicalPage&);
     void deallocate_supervisor_physical_page(const PhysicalPage&);
@@ -175,6 +185,35 @@ public:
     unsigned super_physical_pages() const { return m_super_physical_pages; }
     unsigned super_physical_pages_used() const { return m_super_physical_pages_used; }
 
+    // Pages zeroed ahead of time by the PageZeroingTask, so that zero-fill
+    // faults don't have to clear them on the spot.
+    static constexpr size_t zeroed_page_pool_size = 512;
+    // Below this many pages, handing one out wakes the PageZeroingTask to top the pool up.
+    static constexpr size_t zeroed_page_pool_low_water_mark = zeroed_page_pool_size / 2;
+
+    // With fewer uncommitted pages than this, the PageZeroingTask stops filling the pool
+    // and trims the inode page caches instead.
+    static constexpr size_t low_memory_page_count = zeroed_page_pool_size * 4;
+    bool is_low_on_memory() const { return m_user_physical_pages_uncommitted < low_memory_page_count; }
+    bool add_page_to_zeroed_page_pool();
+    unsigned zeroed_page_pool_count() const { return m_zeroed_page_count; }
+    unsigned zeroed_page_pool_hits() const { return m_zeroed_page_pool_hits; }
+    unsigned zeroed_page_pool_misses() const { return m_zeroed_page_pool_misses; }
+
+    // Bucket 0 counts zero faults handled in less than a microsecond,
+    // bucket n those that took [2^(n-1), 2^n) microseconds. The last
+    // bucket also takes everything slower than that.
+    static constexpr size_t zero_fault_latency_bucket_count = 16;
+    void record_zero_fault_latency(Time);
+    unsigned zero_fault_latency_bucket(size_t bucket) const { return m_zero_fault_latency_histogram[bucket]; }
+
+    // Batched flushes are the ones a TLBFlushBatch absorbed instead of sending them out on their own.
+    unsigned tlb_flush_ipis() const { return m_tlb_flush_ipis; }
+    unsigned full_tlb_flushes() const { return m_full_tlb_flushes; }
+    unsigned batched_tlb_flushes() const { return m_batched_tlb_flushes; }
+    void record_syscall_tlb_flush_ipis(FlatPtr function, unsigned ipi_count);
+    unsigned syscall_tlb_flush_ipis(Syscall::Function function) const { return m_syscall_tlb_flush_ipis[function]; }
+
     template<typename Callback>
     static void for_each_vmobject(Callback callback)
     {
@@ -188,6 +227,10 @@ public:
 
     void dump_kernel_regions();
 
+    // How many pages around a faulting one Region::handle_inode_fault() reads in and maps
+    // at once. Tunable with the "fault_around" boot parameter, 1 turns it off.
+    size_t fault_around_pages() const { return m_fault_around_pages; }
+
     PhysicalPage& shared_zero_page() { return *m_shared_zero_page; }
     PhysicalPage& lazy_committed_page() { return *m_lazy_committed_page; }
 
@@ -211,14 +254,21 @@ private:
     void parse_memory_map();
     static void flush_tlb_local(VirtualAddress, size_t page_count = 1);
     static void flush_tlb(const PageDirectory*, VirtualAddress, size_t page_count = 1);
+    static void flush_tlb_now(const PageDirectory*, VirtualAddress, size_t page_count);
 
     static Region* user_region_from_vaddr(Space&, VirtualAddress);
     static Region* kernel_region_from_vaddr(VirtualAddress);
 
     static Region* find_region_from_vaddr(VirtualAddress);
 
-    RefPtr<PhysicalPage> find_free_user_physical_page(bool);
+    RefPtr<PhysicalPage> find_free_user_physical_page(bool committed, ShouldZeroFill);
+    Optional<PhysicalAddress> take_free_user_physical_page_address();
+    void refill_user_page_cache(MemoryManagerData&);
+    void flush_user_page_cache(MemoryManagerData&, size_t keep_count);
+    void flush_all_user_page_caches();
+    void return_user_physical_page_to_region(PhysicalAddress);
     u8* quickmap_page(PhysicalPage&);
+    u8* quickmap_page(PhysicalAddress);
     void unquickmap_page();
 
     PageDirectoryEntry* quickmap_pd(PageDirectory&, size_t pdpt_index);
@@ -227,12 +277,17 @@ private:
     PageTableEntry* pte(PageDirectory&, VirtualAddress);
     PageTableEntry* ensure_pte(PageDirectory&, VirtualAddress);
     void release_pte(PageDirectory&, VirtualAddress, bool);
+    PageDirectoryEntry* ensure_huge_pde(PageDirectory&, VirtualAddress);
+    bool release_huge_pde(PageDirectory&, VirtualAddress);
+    void split_huge_pde(PageDirectory&, PageDirectoryEntry&, VirtualAddress);
 
     RefPtr<PageDirectory> m_kernel_page_directory;
 
     RefPtr<PhysicalPage> m_shared_zero_page;
     RefPtr<PhysicalPage> m_lazy_committed_page;
 
+    size_t m_fault_around_pages { 16 };
+
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_user_physical_pages { 0 };
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_user_physical_pages_used { 0 };
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_user_physical_pages_committed { 0 };
@@ -240,6 +295,17 @@ private:
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_super_physical_pages { 0 };
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_super_physical_pages_used { 0 };
 
+    PhysicalAddress m_zeroed_pages[zeroed_page_pool_size];
+    size_t m_zeroed_page_count { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_zeroed_page_pool_hits { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_zeroed_page_pool_misses { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_zero_fault_latency_histogram[zero_fault_latency_bucket_count] {};
+
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_tlb_flush_ipis { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_full_tlb_flushes { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_batched_tlb_flushes { 0 };
+    Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_syscall_tlb_flush_ipis[Syscall::Function::__Count] {};
+
     NonnullRefPtrVector<PhysicalRegion> m_user_physical_regions;
     NonnullRefPtrVector<PhysicalRegion> m_super_physical_regions;
 
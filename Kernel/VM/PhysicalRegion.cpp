@@ -29,7 +29,6 @@
 #include <AK/RefPtr.h>
 #include <AK/Vector.h>
 #include <Kernel/Assertions.h>
-#include <Kernel/Random.h>
 #include <Kernel/VM/PhysicalPage.h>
 #include <Kernel/VM/PhysicalRegion.h>
 
@@ -59,133 +58,197 @@ unsigned PhysicalRegion::finalize_capacity()
     VERIFY(!m_pages);
 
     m_pages = (m_upper.get() - m_lower.get()) / PAGE_SIZE;
-    m_bitmap.grow(m_pages, false);
 
+    constexpr FlatPtr largest_block_size = PAGE_SIZE << max_order;
+    m_base = PhysicalAddress(m_lower.get() & ~(largest_block_size - 1));
+    m_first_offset = (m_lower.get() - m_base.get()) / PAGE_SIZE;
+
+    auto end_offset = m_first_offset + m_pages;
+    for (size_t order = 0; order <= max_order; ++order) {
+        // NOTE: Bitmap's searches work on whole 32-bit words, so pad the bitmaps to that.
+        size_t block_count = ceil_div(end_offset, (size_t)1 << order);
+        m_free_blocks[order].grow(max(round_up_to_power_of_two(block_count, 32), 32u), false);
+    }
+
+    free_range(m_first_offset, m_pages);
     return size();
 }
 
-NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
+size_t PhysicalRegion::order_for_page_count(size_t count)
 {
-    VERIFY(m_pages);
-    VERIFY(m_used != m_pages);
-
-    NonnullRefPtrVector<PhysicalPage> physical_pages;
-    physical_pages.ensure_capacity(count);
-
-    auto first_contiguous_page = find_contiguous_free_pages(count, physical_alignment);
+    size_t order = 0;
+    while (((size_t)1 << order) < count)
+        ++order;
+    return order;
+}
 
-    for (size_t index = 0; index < count; index++)
-        physical_pages.append(PhysicalPage::create(m_lower.offset(PAGE_SIZE * (index + first_contiguous_page)), supervisor));
-    return physical_pages;
+size_t PhysicalRegion::offset_for(PhysicalAddress paddr) const
+{
+    VERIFY(paddr >= m_lower);
+    auto offset = (paddr.get() - m_base.get()) / PAGE_SIZE;
+    VERIFY(offset < m_first_offset + m_pages);
+    return offset;
 }
 
-unsigned PhysicalRegion::find_contiguous_free_pages(size_t count, size_t physical_alignment)
+PhysicalAddress PhysicalRegion::address_for(size_t offset) const
 {
-    VERIFY(count != 0);
-    VERIFY(physical_alignment % PAGE_SIZE == 0);
-    // search from the last page we allocated
-    auto range = find_and_allocate_contiguous_range(count, physical_alignment / PAGE_SIZE);
-    VERIFY(range.has_value());
-    return range.value();
+    return m_base.offset(offset * PAGE_SIZE);
 }
 
-Optional<unsigned> PhysicalRegion::find_one_free_page()
+Optional<size_t> PhysicalRegion::allocate_block(size_t order)
 {
-    if (m_used == m_pages) {
-        // We know we don't have any free pages, no need to check the bitmap
-        // Check if we can draw one from the return queue
-        if (m_recently_returned.size() > 0) {
-            u8 index = get_fast_random<u8>() % m_recently_returned.size();
-            Checked<FlatPtr> local_offset = m_recently_returned[index].get();
-            local_offset -= m_lower.get();
-            m_recently_returned.remove(index);
-            VERIFY(!local_offset.has_overflow());
-            VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
-            return local_offset.value() / PAGE_SIZE;
-        }
-        return {};
-    }
-    auto free_index = m_bitmap.find_one_anywhere_unset(m_free_hint);
-    if (!free_index.has_value())
+    size_t found_order = order;
+    while (found_order <= max_order && m_free_block_count[found_order] == 0)
+        ++found_order;
+    if (found_order > max_order)
         return {};
 
-    auto page_index = free_index.value();
-    m_bitmap.set(page_index, true);
-    m_used++;
-    m_free_hint = free_index.value() + 1; // Just a guess
-    if (m_free_hint >= m_bitmap.size())
-        m_free_hint = 0;
-    return page_index;
+    auto& free_blocks = m_free_blocks[found_order];
+    auto index = free_blocks.find_one_anywhere_set(m_free_block_hint[found_order]);
+    VERIFY(index.has_value());
+    free_blocks.set(index.value(), false);
+    --m_free_block_count[found_order];
+    m_free_block_hint[found_order] = index.value();
+
+    // Split the block, putting the upper halves back until it has the size we want
+    size_t offset = index.value() << found_order;
+    while (found_order > order) {
+        --found_order;
+        size_t upper_half = (offset >> found_order) + 1;
+        m_free_blocks[found_order].set(upper_half, true);
+        ++m_free_block_count[found_order];
+        if (upper_half < m_free_block_hint[found_order])
+            m_free_block_hint[found_order] = upper_half;
+    }
+    return offset;
 }
 
-Optional<unsigned> PhysicalRegion::find_and_allocate_contiguous_range(size_t count, unsigned alignment)
+Optional<size_t> PhysicalRegion::allocate_adjacent_largest_blocks(size_t block_count, size_t physical_alignment)
 {
-    VERIFY(count != 0);
-    size_t found_pages_count = 0;
-    // TODO: Improve how we deal with alignment != 1
-    auto first_index = m_bitmap.find_longest_range_of_unset_bits(count + alignment - 1, found_pages_count);
-    if (!first_index.has_value())
+    if (m_free_block_count[max_order] < block_count)
         return {};
 
-    auto page = first_index.value();
-    if (alignment != 1) {
-        auto lower_page = m_lower.get() / PAGE_SIZE;
-        page = ((lower_page + page + alignment - 1) & ~(alignment - 1)) - lower_page;
-    }
-    if (found_pages_count >= count) {
-        m_bitmap.set_range<true>(page, count);
-        m_used += count;
-        m_free_hint = first_index.value() + count + 1; // Just a guess
-        if (m_free_hint >= m_bitmap.size())
-            m_free_hint = 0;
-        return page;
+    // There are few blocks of the largest order, so just look for a long enough run of them.
+    auto& free_blocks = m_free_blocks[max_order];
+    size_t run_start = 0;
+    size_t run_length = 0;
+    for (size_t index = 0; index < free_blocks.size(); ++index) {
+        if (!free_blocks.get(index)) {
+            run_length = 0;
+            continue;
+        }
+        if (run_length == 0) {
+            if (address_for(index << max_order).get() % physical_alignment)
+                continue;
+            run_start = index;
+        }
+        if (++run_length < block_count)
+            continue;
+
+        for (size_t block = run_start; block < run_start + block_count; ++block)
+            free_blocks.set(block, false);
+        m_free_block_count[max_order] -= block_count;
+        return run_start << max_order;
     }
     return {};
 }
 
-RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
+void PhysicalRegion::free_block(size_t offset, size_t order)
 {
-    VERIFY(m_pages);
+    VERIFY(!(offset & ((1u << order) - 1)));
+
+    while (order < max_order) {
+        size_t buddy_index = (offset >> order) ^ 1;
+        auto& free_blocks = m_free_blocks[order];
+        if (buddy_index >= free_blocks.size() || !free_blocks.get(buddy_index))
+            break;
+        free_blocks.set(buddy_index, false);
+        --m_free_block_count[order];
+        offset &= ~((size_t)1 << order);
+        ++order;
+    }
 
-    auto free_index = find_one_free_page();
-    if (!free_index.has_value())
-        return nullptr;
+    size_t index = offset >> order;
+    VERIFY(!m_free_blocks[order].get(index));
+    m_free_blocks[order].set(index, true);
+    ++m_free_block_count[order];
+    if (index < m_free_block_hint[order])
+        m_free_block_hint[order] = index;
+}
 
-    return PhysicalPage::create(m_lower.offset(free_index.value() * PAGE_SIZE), supervisor);
+void PhysicalRegion::free_range(size_t offset, size_t count)
+{
+    // Hand the range back as the largest naturally aligned blocks that fit
+    while (count) {
+        size_t order = 0;
+        while (order < max_order && !(offset & ((size_t)1 << order)) && ((size_t)2 << order) <= count)
+            ++order;
+        free_block(offset, order);
+        offset += (size_t)1 << order;
+        count -= (size_t)1 << order;
+    }
 }
 
-void PhysicalRegion::free_page_at(PhysicalAddress addr)
+NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
 {
     VERIFY(m_pages);
+    VERIFY(count != 0);
+    VERIFY(physical_alignment % PAGE_SIZE == 0);
 
-    if (m_used == 0) {
-        VERIFY_NOT_REACHED();
+    // Blocks are aligned to their size, so asking for a large enough block
+    // takes care of the alignment as well.
+    auto order = max(order_for_page_count(count), order_for_page_count(physical_alignment / PAGE_SIZE));
+    Optional<size_t> offset;
+    size_t block_pages;
+    if (order > max_order) {
+        constexpr size_t largest_block_pages = (size_t)1 << max_order;
+        size_t block_count = ceil_div(count, largest_block_pages);
+        offset = allocate_adjacent_largest_blocks(block_count, physical_alignment);
+        block_pages = block_count * largest_block_pages;
+    } else {
+        offset = allocate_block(order);
+        block_pages = (size_t)1 << order;
     }
+    if (!offset.has_value())
+        return {};
 
-    Checked<FlatPtr> local_offset = addr.get();
-    local_offset -= m_lower.get();
-    VERIFY(!local_offset.has_overflow());
-    VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
+    if (block_pages > count)
+        free_range(offset.value() + count, block_pages - count);
+    m_used += count;
 
-    auto page = local_offset.value() / PAGE_SIZE;
-    m_bitmap.set(page, false);
-    m_free_hint = page; // We know we can find one here for sure
-    m_used--;
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    physical_pages.ensure_capacity(count);
+    for (size_t index = 0; index < count; index++)
+        physical_pages.append(PhysicalPage::create(address_for(offset.value() + index), supervisor));
+    return physical_pages;
 }
 
-void PhysicalRegion::return_page(const PhysicalPage& page)
+Optional<PhysicalAddress> PhysicalRegion::take_free_page_address()
 {
-    auto returned_count = m_recently_returned.size();
-    if (returned_count >= m_recently_returned.capacity()) {
-        // Return queue is full, pick a random entry and free that page
-        // and replace the entry with this page
-        auto& entry = m_recently_returned[get_fast_random<u8>()];
-        free_page_at(entry);
-        entry = page.paddr();
-    } else {
-        // Still filling the return queue, just append it
-        m_recently_returned.append(page.paddr());
-    }
+    VERIFY(m_pages);
+
+    auto offset = allocate_block(0);
+    if (!offset.has_value())
+        return {};
+    ++m_used;
+    return address_for(offset.value());
+}
+
+RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
+{
+    auto paddr = take_free_page_address();
+    if (!paddr.has_value())
+        return nullptr;
+    return PhysicalPage::create(paddr.value(), supervisor);
+}
+
+void PhysicalRegion::return_page_address(PhysicalAddress paddr)
+{
+    VERIFY(m_pages);
+    VERIFY(m_used);
+
+    free_block(offset_for(paddr), 0);
+    --m_used;
 }
 
 }
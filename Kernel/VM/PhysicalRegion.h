@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <AK/Array.h>
 #include <AK/Bitmap.h>
 #include <AK/NonnullRefPtrVector.h>
 #include <AK/Optional.h>
@@ -47,19 +48,35 @@ public:
     PhysicalAddress lower() const { return m_lower; }
     PhysicalAddress upper() const { return m_upper; }
     unsigned size() const { return m_pages; }
-    unsigned used() const { return m_used - m_recently_returned.size(); }
-    unsigned free() const { return m_pages - m_used + m_recently_returned.size(); }
-    bool contains(const PhysicalPage& page) const { return page.paddr() >= m_lower && page.paddr() <= m_upper; }
+    unsigned used() const { return m_used; }
+    unsigned free() const { return m_pages - m_used; }
+    bool contains(const PhysicalPage& page) const { return contains(page.paddr()); }
+    bool contains(PhysicalAddress paddr) const { return paddr >= m_lower && paddr <= m_upper; }
 
     RefPtr<PhysicalPage> take_free_page(bool supervisor);
     NonnullRefPtrVector<PhysicalPage> take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment = PAGE_SIZE);
-    void return_page(const PhysicalPage& page);
+    Optional<PhysicalAddress> take_free_page_address();
+    void return_page(const PhysicalPage& page) { return_page_address(page.paddr()); }
+    void return_page_address(PhysicalAddress);
 
 private:
-    unsigned find_contiguous_free_pages(size_t count, size_t physical_alignment = PAGE_SIZE);
-    Optional<unsigned> find_and_allocate_contiguous_range(size_t count, unsigned alignment = 1);
-    Optional<unsigned> find_one_free_page();
-    void free_page_at(PhysicalAddress addr);
+    // Free memory is kept as power-of-two sized blocks of pages, each block
+    // aligned to its own size in physical memory. For every order there is
+    // a bitmap with one bit per block telling whether that block is free
+    // (and not part of a larger free block). Allocation splits the smallest
+    // free block that fits, freeing coalesces with the buddy block as long
+    // as it is free as well.
+    static constexpr size_t max_order = 10;
+
+    static size_t order_for_page_count(size_t);
+
+    Optional<size_t> allocate_block(size_t order);
+    // Requests larger than the largest block take a run of adjacent largest blocks.
+    Optional<size_t> allocate_adjacent_largest_blocks(size_t block_count, size_t physical_alignment);
+    void free_block(size_t offset, size_t order);
+    void free_range(size_t offset, size_t count);
+    size_t offset_for(PhysicalAddress) const;
+    PhysicalAddress address_for(size_t offset) const;
 
     PhysicalRegion(PhysicalAddress lower, PhysicalAddress upper);
 
@@ -67,9 +84,15 @@ private:
     PhysicalAddress m_upper;
     unsigned m_pages { 0 };
     unsigned m_used { 0 };
-    Bitmap m_bitmap;
-    size_t m_free_hint { 0 };
-    Vector<PhysicalAddress, 256> m_recently_returned;
+
+    // Block offsets are counted in pages from m_base, which is m_lower
+    // rounded down to the largest block size, so that buddy blocks are
+    // naturally aligned in physical memory.
+    PhysicalAddress m_base;
+    size_t m_first_offset { 0 };
+    Array<Bitmap, max_order + 1> m_free_blocks;
+    Array<size_t, max_order + 1> m_free_block_count {};
+    Array<size_t, max_order + 1> m_free_block_hint {};
 };
 
 }
@@ -28,9 +28,12 @@
 #include <AK/StringView.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/FileSystem/InodePageCache.h>
+#include <Kernel/KBuffer.h>
 #include <Kernel/Panic.h>
 #include <Kernel/Process.h>
 #include <Kernel/Thread.h>
+#include <Kernel/Time/TimeManagement.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/PageDirectory.h>
@@ -110,6 +113,7 @@ OwnPtr<Region> Region::clone(Process& new_owner)
         region->set_mmap(m_mmap);
         region->set_shared(m_shared);
         region->set_syscall_region(is_syscall_region());
+        region->set_huge_pages(m_huge_pages);
         return region;
     }
 
@@ -134,6 +138,7 @@ OwnPtr<Region> Region::clone(Process& new_owner)
     }
     clone_region->set_syscall_region(is_syscall_region());
     clone_region->set_mmap(m_mmap);
+    clone_region->set_huge_pages(m_huge_pages);
     return clone_region;
 }
 
@@ -286,6 +291,60 @@ bool Region::map_individual_page_impl(size_t page_index)
     return true;
 }
 
+bool Region::can_map_huge_page(size_t page_index) const
+{
+    constexpr size_t huge_page_count = HUGE_PAGE_SIZE / PAGE_SIZE;
+    if (!m_huge_pages || !m_cacheable || (!is_readable() && !is_writable()))
+        return false;
+    if (vaddr_from_page_index(page_index).get() & (HUGE_PAGE_SIZE - 1))
+        return false;
+    if (page_index + huge_page_count > page_count())
+        return false;
+
+    // All of it has to be one naturally aligned run of physical memory
+    // that we'd map with the very same permissions page by page.
+    auto* first_page = physical_page(page_index);
+    if (!first_page || (first_page->paddr().get() & (HUGE_PAGE_SIZE - 1)))
+        return false;
+    for (size_t i = 0; i < huge_page_count; ++i) {
+        auto* page = physical_page(page_index + i);
+        if (!page || page->paddr() != first_page->paddr().offset(i * PAGE_SIZE))
+            return false;
+        if (page->is_shared_zero_page() || page->is_lazy_committed_page() || should_cow(page_index + i))
+            return false;
+    }
+    return true;
+}
+
+bool Region::map_huge_page_impl(size_t page_index)
+{
+    VERIFY(m_page_directory->get_lock().own_lock());
+    auto page_vaddr = vaddr_from_page_index(page_index);
+
+    bool user_allowed = page_vaddr.get() >= 0x00800000 && is_user_address(page_vaddr);
+    if (is_mmap() && !user_allowed) {
+        PANIC("About to map mmap'ed page at a kernel address");
+    }
+
+    auto* pde = MM.ensure_huge_pde(*m_page_directory, page_vaddr);
+    if (!pde) {
+        for (size_t i = 0; i < HUGE_PAGE_SIZE / PAGE_SIZE; ++i) {
+            if (!map_individual_page_impl(page_index + i))
+                return false;
+        }
+        return true;
+    }
+    pde->clear();
+    pde->set_page_table_base(physical_page(page_index)->paddr().get());
+    pde->set_huge(true);
+    pde->set_present(true);
+    pde->set_writable(is_writable());
+    if (Processor::current().has_feature(CPUFeature::NX))
+        pde->set_execute_disabled(!is_executable());
+    pde->set_user_allowed(user_allowed);
+    return true;
+}
+
 bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
 {
     bool success = true;
@@ -297,6 +356,14 @@ bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
     ScopedSpinLock page_lock(m_page_directory->get_lock());
     size_t index = page_index;
     while (index < page_index + page_count) {
+        if (index + HUGE_PAGE_SIZE / PAGE_SIZE <= page_index + page_count && can_map_huge_page(index)) {
+            if (!map_huge_page_impl(index)) {
+                success = false;
+                break;
+            }
+            index += HUGE_PAGE_SIZE / PAGE_SIZE;
+            continue;
+        }
         if (!map_individual_page_impl(index)) {
             success = false;
             break;
@@ -366,6 +433,10 @@ void Region::unmap(ShouldDeallocateVirtualMemoryRange deallocate_range)
     size_t count = page_count();
     for (size_t i = 0; i < count; ++i) {
         auto vaddr = vaddr_from_page_index(i);
+        if (!(vaddr.get() & (HUGE_PAGE_SIZE - 1)) && i + HUGE_PAGE_SIZE / PAGE_SIZE <= count && MM.release_huge_pde(*m_page_directory, vaddr)) {
+            i += HUGE_PAGE_SIZE / PAGE_SIZE - 1;
+            continue;
+        }
         MM.release_pte(*m_page_directory, vaddr, i == count - 1);
     }
     MM.flush_tlb(m_page_directory, vaddr(), page_count());
@@ -398,6 +469,12 @@ bool Region::map(PageDirectory& page_directory, ShouldFlushTLB should_flush_tlb)
     set_page_directory(page_directory);
     size_t page_index = 0;
     while (page_index < page_count()) {
+        if (can_map_huge_page(page_index)) {
+            if (!map_huge_page_impl(page_index))
+                break;
+            page_index += HUGE_PAGE_SIZE / PAGE_SIZE;
+            continue;
+        }
         if (!map_individual_page_impl(page_index))
             break;
         ++page_index;
@@ -489,6 +566,19 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
     if (current_thread != nullptr)
         current_thread->did_zero_fault();
 
+    auto fault_start_time = TimeManagement::the().monotonic_time(TimePrecision::Precise);
+
+    if (m_huge_pages) {
+        if (auto first_huge_page_index = try_populate_huge_page(page_index_in_region); first_huge_page_index.has_value()) {
+            if (!remap_vmobject_page_range(first_huge_page_index.value(), HUGE_PAGE_SIZE / PAGE_SIZE)) {
+                dmesgln("MM: handle_zero_fault was unable to map a large page");
+                return PageFaultResponse::OutOfMemory;
+            }
+            MM.record_zero_fault_latency(TimeManagement::the().monotonic_time(TimePrecision::Precise) - fault_start_time);
+            return PageFaultResponse::Continue;
+        }
+    }
+
     if (page_slot->is_lazy_committed_page()) {
         page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
         dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED COMMITTED {}", page_slot->paddr());
@@ -505,9 +595,27 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
         dmesgln("MM: handle_zero_fault was unable to allocate a page table to map {}", page_slot);
         return PageFaultResponse::OutOfMemory;
     }
+    MM.record_zero_fault_latency(TimeManagement::the().monotonic_time(TimePrecision::Precise) - fault_start_time);
     return PageFaultResponse::Continue;
 }
 
+Optional<size_t> Region::try_populate_huge_page(size_t page_index_in_region)
+{
+    constexpr size_t huge_page_count = HUGE_PAGE_SIZE / PAGE_SIZE;
+    auto huge_page_vaddr = VirtualAddress(vaddr_from_page_index(page_index_in_region).get() & ~(HUGE_PAGE_SIZE - 1));
+    if (huge_page_vaddr < vaddr())
+        return {};
+    auto first_page_index = page_index_from_address(huge_page_vaddr);
+    if (first_page_index + huge_page_count > page_count())
+        return {};
+
+    auto first_page_index_in_vmobject = translate_to_vmobject_page(first_page_index);
+    if (!static_cast<AnonymousVMObject&>(vmobject()).populate_huge_page(first_page_index_in_vmobject))
+        return {};
+    dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED LARGE PAGE {}", physical_page(first_page_index)->paddr());
+    return first_page_index_in_vmobject;
+}
+
 PageFaultResponse Region::handle_cow_fault(size_t page_index_in_region)
 {
     VERIFY_INTERRUPTS_DISABLED();
@@ -556,46 +664,105 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, Scoped
     if (current_thread)
         current_thread->did_inode_fault();
 
-    u8 page_buffer[PAGE_SIZE];
     auto& inode = inode_vmobject.inode();
 
-    // Reading the page may block, so release the MM lock temporarily
+    // Reading the pages may block, so release the MM lock temporarily
     mm_lock.unlock();
-    auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer);
-    auto nread = inode.read_bytes(page_index_in_vmobject * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
+
+    // Fault in a whole window of pages around the faulting one, clamped to this
+    // region and the file, so sequential access doesn't fault on every page.
+    size_t fault_around_pages = MM.fault_around_pages();
+    size_t file_size = inode.size();
+    size_t file_page_count = page_round_up(file_size) / PAGE_SIZE;
+    size_t window_start = max(page_index_in_vmobject & ~(fault_around_pages - 1), first_page_index());
+    size_t window_end = min(window_start + fault_around_pages, first_page_index() + page_count());
+    window_end = max(min(window_end, file_page_count), page_index_in_vmobject + 1);
+    size_t window_page_count = window_end - window_start;
+
+    auto* page_cache = inode.page_cache();
+    if (page_cache && inode_vmobject.is_shared_inode()) {
+        // Shared mappings use the page cache pages directly, so they stay coherent with read() and write().
+        auto cached_pages = page_cache->pages_for_shared_mapping(window_start, window_end);
+        mm_lock.lock();
+        if (cached_pages[page_index_in_vmobject - window_start]) {
+            for (size_t i = 0; i < window_page_count; ++i) {
+                auto& physical_page_entry = inode_vmobject.physical_pages()[window_start + i];
+                if (physical_page_entry.is_null() && cached_pages[i])
+                    physical_page_entry = move(cached_pages[i]);
+            }
+            if (!remap_vmobject_page_range(window_start, window_page_count))
+                return PageFaultResponse::OutOfMemory;
+            return PageFaultResponse::Continue;
+        }
+        mm_lock.unlock();
+    }
+
+    // Read the whole window with a single call. If we can't get a buffer that big,
+    // fall back to reading just the faulting page.
+    u8 page_buffer[PAGE_SIZE];
+    u8* read_buffer = page_buffer;
+    OwnPtr<KBuffer> window_buffer;
+    if (window_page_count > 1)
+        window_buffer = KBuffer::try_create_with_size(window_page_count * PAGE_SIZE, Region::Access::Read | Region::Access::Write, "Inode fault-around");
+    if (window_buffer) {
+        read_buffer = window_buffer->data();
+    } else {
+        window_start = page_index_in_vmobject;
+        window_page_count = 1;
+    }
+
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(read_buffer);
+    ssize_t nread;
+    if (page_cache)
+        nread = page_cache->read_bytes(window_start * PAGE_SIZE, window_page_count * PAGE_SIZE, buffer);
+    else
+        nread = inode.read_bytes(window_start * PAGE_SIZE, window_page_count * PAGE_SIZE, buffer, nullptr);
     mm_lock.lock();
 
     if (nread < 0) {
         dmesgln("MM: handle_inode_fault had error ({}) while reading!", nread);
         return PageFaultResponse::ShouldCrash;
     }
-    if (nread < PAGE_SIZE) {
-        // If we read less than a page, zero out the rest to avoid leaking uninitialized data.
-        memset(page_buffer + nread, 0, PAGE_SIZE - nread);
+    if ((size_t)nread < window_page_count * PAGE_SIZE) {
+        // If we read less than we asked for, zero out the rest to avoid leaking uninitialized data.
+        memset(read_buffer + nread, 0, window_page_count * PAGE_SIZE - nread);
     }
 
-    vmobject_physical_page_entry = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
-    if (vmobject_physical_page_entry.is_null()) {
-        dmesgln("MM: handle_inode_fault was unable to allocate a physical page");
-        return PageFaultResponse::OutOfMemory;
-    }
+    size_t faulting_page_in_window = page_index_in_vmobject - window_start;
+    for (size_t i = 0; i < window_page_count; ++i) {
+        auto& physical_page_entry = inode_vmobject.physical_pages()[window_start + i];
+        if (!physical_page_entry.is_null())
+            continue;
+        // Only bring in neighbouring pages that actually have file data in them.
+        if (i != faulting_page_in_window && i * PAGE_SIZE >= (size_t)nread)
+            continue;
+
+        physical_page_entry = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+        if (physical_page_entry.is_null()) {
+            if (i != faulting_page_in_window)
+                continue;
+            dmesgln("MM: handle_inode_fault was unable to allocate a physical page");
+            return PageFaultResponse::OutOfMemory;
+        }
 
-    u8* dest_ptr = MM.quickmap_page(*vmobject_physical_page_entry);
-    {
-        void* fault_at;
-        if (!safe_memcpy(dest_ptr, page_buffer, PAGE_SIZE, fault_at)) {
-            if ((u8*)fault_at >= dest_ptr && (u8*)fault_at <= dest_ptr + PAGE_SIZE)
-                dbgln("      >> inode fault: error copying data to {}/{}, failed at {}",
-                    vmobject_physical_page_entry->paddr(),
-                    VirtualAddress(dest_ptr),
-                    VirtualAddress(fault_at));
-            else
-                VERIFY_NOT_REACHED();
+        u8* dest_ptr = MM.quickmap_page(*physical_page_entry);
+        {
+            void* fault_at;
+            if (!safe_memcpy(dest_ptr, read_buffer + i * PAGE_SIZE, PAGE_SIZE, fault_at)) {
+                if ((u8*)fault_at >= dest_ptr && (u8*)fault_at <= dest_ptr + PAGE_SIZE)
+                    dbgln("      >> inode fault: error copying data to {}/{}, failed at {}",
+                        physical_page_entry->paddr(),
+                        VirtualAddress(dest_ptr),
+                        VirtualAddress(fault_at));
+                else
+                    VERIFY_NOT_REACHED();
+            }
         }
+        MM.unquickmap_page();
     }
-    MM.unquickmap_page();
 
-    remap_vmobject_page(page_index_in_vmobject);
+    if (!remap_vmobject_page_range(window_start, window_page_count))
+        return PageFaultResponse::OutOfMemory;
     return PageFaultResponse::Continue;
 }
 
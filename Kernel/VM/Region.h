@@ -106,6 +106,11 @@ public:
     bool is_mmap() const { return m_mmap; }
     void set_mmap(bool mmap) { m_mmap = mmap; }
 
+    // Whether suitably aligned 2 MiB stretches of this region may be backed
+    // by one large page each, instead of 512 small ones.
+    bool wants_huge_pages() const { return m_huge_pages; }
+    void set_huge_pages(bool huge_pages) { m_huge_pages = huge_pages; }
+
     bool is_user() const { return !is_kernel(); }
     bool is_kernel() const { return vaddr().get() < 0x00800000 || vaddr().get() >= 0xc0000000; }
 
@@ -271,6 +276,9 @@ private:
     PageFaultResponse handle_zero_fault(size_t page_index);
 
     bool map_individual_page_impl(size_t page_index);
+    bool can_map_huge_page(size_t page_index) const;
+    bool map_huge_page_impl(size_t page_index);
+    Optional<size_t> try_populate_huge_page(size_t page_index);
 
     void register_purgeable_page_ranges();
     void unregister_purgeable_page_ranges();
@@ -286,6 +294,7 @@ private:
     bool m_stack : 1 { false };
     bool m_mmap : 1 { false };
     bool m_syscall_region : 1 { false };
+    bool m_huge_pages : 1 { false };
     WeakPtr<Process> m_owner;
 };
 
@@ -70,6 +70,7 @@ Region& Space::allocate_split_region(const Region& source_region, const Range& r
     region.set_syscall_region(source_region.is_syscall_region());
     region.set_mmap(source_region.is_mmap());
     region.set_stack(source_region.is_stack());
+    region.set_huge_pages(source_region.wants_huge_pages());
     size_t page_offset_in_source_region = (offset_in_vmobject - source_region.offset_in_vmobject()) / PAGE_SIZE;
     for (size_t i = 0; i < region.page_count(); ++i) {
         if (source_region.should_cow(page_offset_in_source_region + i))
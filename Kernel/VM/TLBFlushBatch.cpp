@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Arch/i386/CPU.h>
+#include <Kernel/Thread.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageDirectory.h>
+#include <Kernel/VM/TLBFlushBatch.h>
+
+namespace Kernel {
+
+TLBFlushBatch::TLBFlushBatch(PageDirectory& page_directory)
+    : m_page_directory(page_directory)
+{
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread);
+    m_previous_batch = current_thread->tlb_flush_batch();
+    current_thread->set_tlb_flush_batch(this);
+}
+
+TLBFlushBatch::~TLBFlushBatch()
+{
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread->tlb_flush_batch() == this);
+    current_thread->set_tlb_flush_batch(m_previous_batch);
+    flush();
+}
+
+bool TLBFlushBatch::try_add(const PageDirectory& page_directory, VirtualAddress vaddr, size_t page_count)
+{
+    // Kernel mappings are shared by everyone, keep flushing those eagerly.
+    if (&page_directory != m_page_directory.ptr() || !is_user_address(vaddr))
+        return false;
+
+    {
+        ScopedCritical critical;
+        if (read_cr3() == page_directory.cr3())
+            Processor::flush_tlb_local(vaddr, page_count);
+    }
+
+    auto end = vaddr.get() + page_count * PAGE_SIZE;
+    if (m_start == m_end) {
+        m_start = vaddr.get();
+        m_end = end;
+    } else {
+        m_start = min(m_start, vaddr.get());
+        m_end = max(m_end, end);
+    }
+    return true;
+}
+
+void TLBFlushBatch::keep_alive_until_flushed(const PageDirectory& page_directory, RefPtr<PhysicalPage> page_table)
+{
+    if (&page_directory == m_page_directory.ptr())
+        m_released_page_tables.append(move(page_table));
+}
+
+void TLBFlushBatch::flush()
+{
+    if (m_start != m_end) {
+        auto vaddr = VirtualAddress(m_start);
+        auto page_count = (m_end - m_start) / PAGE_SIZE;
+        m_start = m_end = 0;
+        MemoryManager::flush_tlb_now(m_page_directory.ptr(), vaddr, page_count);
+    }
+    m_released_page_tables.clear();
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Noncopyable.h>
+#include <AK/RefPtr.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+#include <Kernel/Forward.h>
+#include <Kernel/VirtualAddress.h>
+
+namespace Kernel {
+
+// Gathers the TLB invalidations of an operation that changes several parts of an
+// address space (e.g. splitting a region and remapping the pieces) and sends the other
+// processors a single shootdown for all of them when it goes out of scope.
+// Our own TLB is still flushed right away.
+//
+// NOTE: Other processors may keep using stale entries until the batch is flushed,
+//       so physical pages unmapped under a batch must not be freed before that.
+//       Page tables that become empty are kept alive by the batch itself.
+class TLBFlushBatch {
+    AK_MAKE_NONCOPYABLE(TLBFlushBatch);
+    AK_MAKE_NONMOVABLE(TLBFlushBatch);
+
+public:
+    explicit TLBFlushBatch(PageDirectory&);
+    ~TLBFlushBatch();
+
+    bool try_add(const PageDirectory&, VirtualAddress, size_t page_count);
+    void keep_alive_until_flushed(const PageDirectory&, RefPtr<PhysicalPage>);
+    void flush();
+
+private:
+    RefPtr<PageDirectory> m_page_directory;
+    TLBFlushBatch* m_previous_batch { nullptr };
+    FlatPtr m_start { 0 };
+    FlatPtr m_end { 0 };
+    Vector<RefPtr<PhysicalPage>> m_released_page_tables;
+};
+
+}
@@ -10,6 +10,7 @@ set(WAITQUEUE_DEBUG ON)
 set(MULTIPROCESSOR_DEBUG ON)
 set(ACPI_DEBUG ON)
 set(PAGE_FAULT_DEBUG ON)
+set(PAGE_CACHE_DEBUG ON)
 set(CONTEXT_SWITCH_DEBUG ON)
 set(SMP_DEBUG ON)
 set(BXVGA_DEBUG ON)
@@ -22,8 +23,10 @@ set(IOAPIC_DEBUG ON)
 set(IRQ_DEBUG ON)
 set(INTERRUPT_DEBUG ON)
 set(E1000_DEBUG ON)
+set(EPOLL_DEBUG ON)
 set(IPV4_SOCKET_DEBUG ON)
 set(LOCAL_SOCKET_DEBUG ON)
+set(LOOPBACK_DEBUG ON)
 set(SOCKET_DEBUG ON)
 set(TCP_SOCKET_DEBUG ON)
 set(PCI_DEBUG ON)
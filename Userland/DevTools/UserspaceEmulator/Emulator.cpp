@@ -46,6 +46,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/select.h>
@@ -500,6 +501,22 @@ u32 Emulator::virt_syscall(u32 function, u32 arg1, u32 arg2, u32 arg3)
         return virt$listen(arg1, arg2);
     case SC_select:
         return virt$select(arg1);
+    case SC_epoll_create:
+        return virt$epoll_create(arg1);
+    case SC_epoll_ctl:
+        return virt$epoll_ctl(arg1);
+    case SC_epoll_wait:
+        return virt$epoll_wait(arg1);
+    case SC_sendfile:
+        return virt$sendfile(arg1);
+    case SC_readv:
+        return virt$readv(arg1, arg2, arg3);
+    case SC_writev:
+        return virt$writev(arg1, arg2, arg3);
+    case SC_preadv:
+        return virt$preadv(arg1);
+    case SC_pwritev:
+        return virt$pwritev(arg1);
     case SC_recvmsg:
         return virt$recvmsg(arg1, arg2, arg3);
     case SC_sendmsg:
@@ -907,6 +924,72 @@ int Emulator::virt$select(FlatPtr params_addr)
     return rc;
 }
 
+int Emulator::virt$epoll_create(int flags)
+{
+    return syscall(SC_epoll_create, flags);
+}
+
+int Emulator::virt$epoll_ctl(FlatPtr params_addr)
+{
+    Syscall::SC_epoll_ctl_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+
+    epoll_event event {};
+    if (params.op != EPOLL_CTL_DEL)
+        mmu().copy_from_vm(&event, (FlatPtr)params.event, sizeof(event));
+
+    params.event = &event;
+    return syscall(SC_epoll_ctl, &params);
+}
+
+int Emulator::virt$epoll_wait(FlatPtr params_addr)
+{
+    Syscall::SC_epoll_wait_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+
+    if (params.maxevents <= 0)
+        return -EINVAL;
+
+    auto* guest_events = params.events;
+    Vector<epoll_event> events;
+    events.resize(params.maxevents);
+    params.events = events.data();
+
+    struct timespec timeout;
+    if (params.timeout) {
+        mmu().copy_from_vm(&timeout, (FlatPtr)params.timeout, sizeof(timeout));
+        params.timeout = &timeout;
+    }
+    u32 sigmask;
+    if (params.sigmask) {
+        mmu().copy_from_vm(&sigmask, (FlatPtr)params.sigmask, sizeof(sigmask));
+        params.sigmask = &sigmask;
+    }
+
+    int rc = syscall(SC_epoll_wait, &params);
+    if (rc > 0)
+        mmu().copy_to_vm((FlatPtr)guest_events, events.data(), rc * sizeof(epoll_event));
+    return rc;
+}
+
+int Emulator::virt$sendfile(FlatPtr params_addr)
+{
+    Syscall::SC_sendfile_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+
+    auto* guest_offset = params.offset;
+    ssize_t offset = 0;
+    if (guest_offset) {
+        mmu().copy_from_vm(&offset, (FlatPtr)guest_offset, sizeof(offset));
+        params.offset = &offset;
+    }
+
+    int rc = syscall(SC_sendfile, &params);
+    if (rc >= 0 && guest_offset)
+        mmu().copy_to_vm((FlatPtr)guest_offset, &offset, sizeof(offset));
+    return rc;
+}
+
 int Emulator::virt$getsockopt(FlatPtr params_addr)
 {
     Syscall::SC_getsockopt_params params;
@@ -1207,6 +1290,88 @@ u32 Emulator::virt$read(int fd, FlatPtr buffer, ssize_t size)
     return nread;
 }
 
+int Emulator::do_vectored_read(int fd, FlatPtr iov, int iov_count, Optional<off_t> offset)
+{
+    if (iov_count < 0)
+        return -EINVAL;
+
+    Vector<iovec> guest_vecs;
+    guest_vecs.resize(iov_count);
+    mmu().copy_from_vm(guest_vecs.data(), iov, iov_count * sizeof(iovec));
+
+    Vector<ByteBuffer> host_buffers;
+    Vector<iovec> host_vecs;
+    for (auto& vec : guest_vecs) {
+        host_buffers.append(ByteBuffer::create_uninitialized(vec.iov_len));
+        host_vecs.append({ host_buffers.last().data(), vec.iov_len });
+    }
+
+    int rc;
+    if (offset.has_value()) {
+        Syscall::SC_preadv_params params { fd, host_vecs.data(), iov_count, offset.value() };
+        rc = syscall(SC_preadv, &params);
+    } else {
+        rc = syscall(SC_readv, fd, host_vecs.data(), iov_count);
+    }
+    if (rc < 0)
+        return rc;
+
+    size_t remaining = rc;
+    for (size_t i = 0; i < guest_vecs.size() && remaining; ++i) {
+        size_t nbytes = min(remaining, guest_vecs[i].iov_len);
+        mmu().copy_to_vm((FlatPtr)guest_vecs[i].iov_base, host_buffers[i].data(), nbytes);
+        remaining -= nbytes;
+    }
+    return rc;
+}
+
+int Emulator::do_vectored_write(int fd, FlatPtr iov, int iov_count, Optional<off_t> offset)
+{
+    if (iov_count < 0)
+        return -EINVAL;
+
+    Vector<iovec> guest_vecs;
+    guest_vecs.resize(iov_count);
+    mmu().copy_from_vm(guest_vecs.data(), iov, iov_count * sizeof(iovec));
+
+    Vector<ByteBuffer> host_buffers;
+    Vector<iovec> host_vecs;
+    for (auto& vec : guest_vecs) {
+        host_buffers.append(mmu().copy_buffer_from_vm((FlatPtr)vec.iov_base, vec.iov_len));
+        host_vecs.append({ host_buffers.last().data(), vec.iov_len });
+    }
+
+    if (offset.has_value()) {
+        Syscall::SC_pwritev_params params { fd, host_vecs.data(), iov_count, offset.value() };
+        return syscall(SC_pwritev, &params);
+    }
+    return syscall(SC_writev, fd, host_vecs.data(), iov_count);
+}
+
+int Emulator::virt$readv(int fd, FlatPtr iov, int iov_count)
+{
+    return do_vectored_read(fd, iov, iov_count, {});
+}
+
+int Emulator::virt$writev(int fd, FlatPtr iov, int iov_count)
+{
+    return do_vectored_write(fd, iov, iov_count, {});
+}
+
+int Emulator::virt$preadv(FlatPtr params_addr)
+{
+    Syscall::SC_preadv_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+    return do_vectored_read(params.fd, (FlatPtr)params.iov, params.iov_count, params.offset);
+}
+
+int Emulator::virt$pwritev(FlatPtr params_addr)
+{
+    Syscall::SC_pwritev_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+    return do_vectored_write(params.fd, (FlatPtr)params.iov, params.iov_count, params.offset);
+}
+
 void Emulator::virt$exit(int status)
 {
     reportln("\n=={}==  \033[33;1mSyscall: exit({})\033[0m, shutting down!", getpid(), status);
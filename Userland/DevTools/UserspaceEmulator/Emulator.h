@@ -117,6 +117,12 @@ private:
     int virt$setgid(gid_t);
     u32 virt$read(int, FlatPtr, ssize_t);
     u32 virt$write(int, FlatPtr, ssize_t);
+    int virt$readv(int, FlatPtr, int);
+    int virt$writev(int, FlatPtr, int);
+    int virt$preadv(FlatPtr);
+    int virt$pwritev(FlatPtr);
+    int do_vectored_read(int fd, FlatPtr iov, int iov_count, Optional<off_t> offset);
+    int do_vectored_write(int fd, FlatPtr iov, int iov_count, Optional<off_t> offset);
     u32 virt$mprotect(FlatPtr, size_t, int);
     u32 virt$madvise(FlatPtr, size_t, int);
     u32 virt$open(u32);
@@ -147,6 +153,10 @@ private:
     int virt$getsockopt(FlatPtr);
     int virt$setsockopt(FlatPtr);
     int virt$select(FlatPtr);
+    int virt$epoll_create(int flags);
+    int virt$epoll_ctl(FlatPtr);
+    int virt$epoll_wait(FlatPtr);
+    int virt$sendfile(FlatPtr);
     int virt$get_stack_bounds(FlatPtr, FlatPtr);
     int virt$accept(int sockfd, FlatPtr address, FlatPtr address_length);
     int virt$bind(int sockfd, FlatPtr address, socklen_t address_length);
@@ -24,6 +24,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Atomic.h>
 #include <AK/Debug.h>
 #include <AK/InlineLinkedList.h>
 #include <AK/LogStream.h>
@@ -55,6 +56,9 @@ static LibThread::Lock& malloc_lock()
 
 constexpr size_t number_of_chunked_blocks_to_keep_around_per_size_class = 4;
 constexpr size_t number_of_big_blocks_to_keep_around_per_size_class = 8;
+constexpr size_t number_of_chunks_to_cache_per_thread_per_size_class = 16;
+constexpr size_t number_of_chunks_to_move_per_thread_cache_refill = number_of_chunks_to_cache_per_thread_per_size_class / 2;
+constexpr size_t largest_thread_cached_chunk_size = 1016;
 
 static bool s_log_malloc = false;
 static bool s_scrub_malloc = true;
@@ -100,6 +104,11 @@ struct MallocStats {
     size_t number_of_freed_full_blocks;
     size_t number_of_keeps;
     size_t number_of_frees;
+
+    size_t number_of_thread_cache_hits;
+    size_t number_of_thread_cache_refills;
+    size_t number_of_thread_cache_frees;
+    size_t number_of_thread_cache_flushes;
 };
 static MallocStats g_malloc_stats = {};
 
@@ -135,6 +144,32 @@ static inline BigAllocator (&big_allocators())[1]
     return reinterpret_cast<BigAllocator(&)[1]>(g_big_allocators_storage);
 }
 
+// Every thread keeps a few free chunks of the smaller size classes around,
+// so that most malloc() and free() calls don't need to take the malloc lock.
+// Chunks move between the thread cache and their blocks in batches.
+struct ThreadChunkCache {
+    size_t count;
+    void* chunks[number_of_chunks_to_cache_per_thread_per_size_class];
+};
+
+static constexpr size_t compute_number_of_thread_cached_size_classes()
+{
+    size_t count = 0;
+    while (size_classes[count] && size_classes[count] <= largest_thread_cached_chunk_size)
+        ++count;
+    return count;
+}
+static constexpr size_t number_of_thread_cached_size_classes = compute_number_of_thread_cached_size_classes();
+
+#ifndef NO_TLS
+static __thread ThreadChunkCache t_chunk_caches[number_of_thread_cached_size_classes];
+#endif
+
+static inline size_t size_class_index(const Allocator& allocator)
+{
+    return &allocator - &allocators()[0];
+}
+
 static Allocator* allocator_for_size(size_t size, size_t& good_size)
 {
     for (size_t i = 0; size_classes[i]; ++i) {
@@ -176,65 +211,18 @@ enum class CallerWillInitializeMemory {
     Yes,
 };
 
-static void* malloc_impl(size_t size, CallerWillInitializeMemory caller_will_initialize_memory)
+static void* allocate_chunk(Allocator& allocator, size_t good_size)
 {
-    LOCKER(malloc_lock());
-
-    if (s_log_malloc)
-        dbgln("LibC: malloc({})", size);
-
-    if (!size)
-        return nullptr;
-
-    g_malloc_stats.number_of_malloc_calls++;
-
-    size_t good_size;
-    auto* allocator = allocator_for_size(size, good_size);
-
-    if (!allocator) {
-        size_t real_size = round_up_to_power_of_two(sizeof(BigAllocationBlock) + size, ChunkedBlock::block_size);
-#ifdef RECYCLE_BIG_ALLOCATIONS
-        if (auto* allocator = big_allocator_for_size(real_size)) {
-            if (!allocator->blocks.is_empty()) {
-                g_malloc_stats.number_of_big_allocator_hits++;
-                auto* block = allocator->blocks.take_last();
-                int rc = madvise(block, real_size, MADV_SET_NONVOLATILE);
-                bool this_block_was_purged = rc == 1;
-                if (rc < 0) {
-                    perror("madvise");
-                    VERIFY_NOT_REACHED();
-                }
-                if (mprotect(block, real_size, PROT_READ | PROT_WRITE) < 0) {
-                    perror("mprotect");
-                    VERIFY_NOT_REACHED();
-                }
-                if (this_block_was_purged) {
-                    g_malloc_stats.number_of_big_allocator_purge_hits++;
-                    new (block) BigAllocationBlock(real_size);
-                }
-
-                ue_notify_malloc(&block->m_slot[0], size);
-                return &block->m_slot[0];
-            }
-        }
-#endif
-        g_malloc_stats.number_of_big_allocs++;
-        auto* block = (BigAllocationBlock*)os_alloc(real_size, "malloc: BigAllocationBlock");
-        new (block) BigAllocationBlock(real_size);
-        ue_notify_malloc(&block->m_slot[0], size);
-        return &block->m_slot[0];
-    }
-
     ChunkedBlock* block = nullptr;
 
-    for (block = allocator->usable_blocks.head(); block; block = block->next()) {
+    for (block = allocator.usable_blocks.head(); block; block = block->next()) {
         if (block->free_chunks())
             break;
     }
 
-    if (!block && allocator->empty_block_count) {
+    if (!block && allocator.empty_block_count) {
         g_malloc_stats.number_of_empty_block_hits++;
-        block = allocator->empty_blocks[--allocator->empty_block_count];
+        block = allocator.empty_blocks[--allocator.empty_block_count];
         int rc = madvise(block, ChunkedBlock::block_size, MADV_SET_NONVOLATILE);
         bool this_block_was_purged = rc == 1;
         if (rc < 0) {
@@ -250,7 +238,7 @@ static void* malloc_impl(size_t size, CallerWillInitializeMemory caller_will_ini
             g_malloc_stats.number_of_empty_block_purge_hits++;
             new (block) ChunkedBlock(good_size);
         }
-        allocator->usable_blocks.append(block);
+        allocator.usable_blocks.append(block);
     }
 
     if (!block) {
@@ -259,8 +247,8 @@ static void* malloc_impl(size_t size, CallerWillInitializeMemory caller_will_ini
         snprintf(buffer, sizeof(buffer), "malloc: ChunkedBlock(%zu)", good_size);
         block = (ChunkedBlock*)os_alloc(ChunkedBlock::block_size, buffer);
         new (block) ChunkedBlock(good_size);
-        allocator->usable_blocks.append(block);
-        ++allocator->block_count;
+        allocator.usable_blocks.append(block);
+        ++allocator.block_count;
     }
 
     --block->m_free_chunks;
@@ -270,64 +258,99 @@ static void* malloc_impl(size_t size, CallerWillInitializeMemory caller_will_ini
     if (block->is_full()) {
         g_malloc_stats.number_of_blocks_full++;
         dbgln_if(MALLOC_DEBUG, "Block {:p} is now full in size class {}", block, good_size);
-        allocator->usable_blocks.remove(block);
-        allocator->full_blocks.append(block);
+        allocator.usable_blocks.remove(block);
+        allocator.full_blocks.append(block);
     }
     dbgln_if(MALLOC_DEBUG, "LibC: allocated {:p} (chunk in block {:p}, size {})", ptr, block, block->bytes_per_chunk());
-
-    if (s_scrub_malloc && caller_will_initialize_memory == CallerWillInitializeMemory::No)
-        memset(ptr, MALLOC_SCRUB_BYTE, block->m_size);
-
-    ue_notify_malloc(ptr, size);
     return ptr;
 }
 
-static void free_impl(void* ptr)
+static void* malloc_impl(size_t size, CallerWillInitializeMemory caller_will_initialize_memory)
 {
-    ScopedValueRollback rollback(errno);
+    if (s_log_malloc)
+        dbgln("LibC: malloc({})", size);
 
-    if (!ptr)
-        return;
+    if (!size)
+        return nullptr;
 
-    g_malloc_stats.number_of_free_calls++;
+    // These counters are bumped before we know whether we need the lock at all.
+    AK::atomic_fetch_add(&g_malloc_stats.number_of_malloc_calls, (size_t)1, AK::memory_order_relaxed);
 
-    LOCKER(malloc_lock());
+    size_t good_size;
+    auto* allocator = allocator_for_size(size, good_size);
 
-    void* block_base = (void*)((FlatPtr)ptr & ChunkedBlock::ChunkedBlock::block_mask);
-    size_t magic = *(size_t*)block_base;
+#ifndef NO_TLS
+    if (allocator && size_class_index(*allocator) < number_of_thread_cached_size_classes) {
+        auto& cache = t_chunk_caches[size_class_index(*allocator)];
+        if (cache.count) {
+            AK::atomic_fetch_add(&g_malloc_stats.number_of_thread_cache_hits, (size_t)1, AK::memory_order_relaxed);
+            void* ptr = cache.chunks[--cache.count];
+            if (s_scrub_malloc && caller_will_initialize_memory == CallerWillInitializeMemory::No)
+                memset(ptr, MALLOC_SCRUB_BYTE, good_size);
+            ue_notify_malloc(ptr, size);
+            return ptr;
+        }
+    }
+#endif
 
-    if (magic == MAGIC_BIGALLOC_HEADER) {
-        auto* block = (BigAllocationBlock*)block_base;
+    LOCKER(malloc_lock());
+
+    if (!allocator) {
+        size_t real_size = round_up_to_power_of_two(sizeof(BigAllocationBlock) + size, ChunkedBlock::block_size);
 #ifdef RECYCLE_BIG_ALLOCATIONS
-        if (auto* allocator = big_allocator_for_size(block->m_size)) {
-            if (allocator->blocks.size() < number_of_big_blocks_to_keep_around_per_size_class) {
-                g_malloc_stats.number_of_big_allocator_keeps++;
-                allocator->blocks.append(block);
-                size_t this_block_size = block->m_size;
-                if (mprotect(block, this_block_size, PROT_NONE) < 0) {
-                    perror("mprotect");
+        if (auto* allocator = big_allocator_for_size(real_size)) {
+            if (!allocator->blocks.is_empty()) {
+                g_malloc_stats.number_of_big_allocator_hits++;
+                auto* block = allocator->blocks.take_last();
+                int rc = madvise(block, real_size, MADV_SET_NONVOLATILE);
+                bool this_block_was_purged = rc == 1;
+                if (rc < 0) {
+                    perror("madvise");
                     VERIFY_NOT_REACHED();
                 }
-                if (madvise(block, this_block_size, MADV_SET_VOLATILE) != 0) {
-                    perror("madvise");
+                if (mprotect(block, real_size, PROT_READ | PROT_WRITE) < 0) {
+                    perror("mprotect");
                     VERIFY_NOT_REACHED();
                 }
-                return;
+                if (this_block_was_purged) {
+                    g_malloc_stats.number_of_big_allocator_purge_hits++;
+                    new (block) BigAllocationBlock(real_size);
+                }
+
+                ue_notify_malloc(&block->m_slot[0], size);
+                return &block->m_slot[0];
             }
         }
 #endif
-        g_malloc_stats.number_of_big_allocator_frees++;
-        os_free(block, block->m_size);
-        return;
+        g_malloc_stats.number_of_big_allocs++;
+        auto* block = (BigAllocationBlock*)os_alloc(real_size, "malloc: BigAllocationBlock");
+        new (block) BigAllocationBlock(real_size);
+        ue_notify_malloc(&block->m_slot[0], size);
+        return &block->m_slot[0];
     }
 
-    assert(magic == MAGIC_PAGE_HEADER);
-    auto* block = (ChunkedBlock*)block_base;
+#ifndef NO_TLS
+    if (size_class_index(*allocator) < number_of_thread_cached_size_classes) {
+        // Grab a few more chunks for the thread cache while we hold the lock anyway
+        auto& cache = t_chunk_caches[size_class_index(*allocator)];
+        g_malloc_stats.number_of_thread_cache_refills++;
+        while (cache.count < number_of_chunks_to_move_per_thread_cache_refill)
+            cache.chunks[cache.count++] = allocate_chunk(*allocator, good_size);
+    }
+#endif
 
-    dbgln_if(MALLOC_DEBUG, "LibC: freeing {:p} in allocator {:p} (size={}, used={})", ptr, block, block->bytes_per_chunk(), block->used_chunks());
+    void* ptr = allocate_chunk(*allocator, good_size);
+
+    if (s_scrub_malloc && caller_will_initialize_memory == CallerWillInitializeMemory::No)
+        memset(ptr, MALLOC_SCRUB_BYTE, good_size);
+
+    ue_notify_malloc(ptr, size);
+    return ptr;
+}
 
-    if (s_scrub_free)
-        memset(ptr, FREE_SCRUB_BYTE, block->bytes_per_chunk());
+static void free_chunk(ChunkedBlock* block, void* ptr)
+{
+    dbgln_if(MALLOC_DEBUG, "LibC: freeing {:p} in allocator {:p} (size={}, used={})", ptr, block, block->bytes_per_chunk(), block->used_chunks());
 
     auto* entry = (FreelistEntry*)ptr;
     entry->next = block->m_freelist;
@@ -364,6 +387,98 @@ static void free_impl(void* ptr)
     }
 }
 
+#ifndef NO_TLS
+static void flush_thread_chunk_cache(ThreadChunkCache& cache, size_t count_to_keep)
+{
+    if (cache.count <= count_to_keep)
+        return;
+    g_malloc_stats.number_of_thread_cache_flushes++;
+    while (cache.count > count_to_keep) {
+        void* ptr = cache.chunks[--cache.count];
+        auto* block = (ChunkedBlock*)((FlatPtr)ptr & ChunkedBlock::block_mask);
+        free_chunk(block, ptr);
+    }
+}
+#endif
+
+static void free_impl(void* ptr)
+{
+    ScopedValueRollback rollback(errno);
+
+    if (!ptr)
+        return;
+
+    AK::atomic_fetch_add(&g_malloc_stats.number_of_free_calls, (size_t)1, AK::memory_order_relaxed);
+
+    void* block_base = (void*)((FlatPtr)ptr & ChunkedBlock::ChunkedBlock::block_mask);
+    size_t magic = *(size_t*)block_base;
+
+    // NOTE: The header of a block can't change while one of its chunks is
+    //       still allocated, so we can look at it without holding the lock.
+    if (magic == MAGIC_PAGE_HEADER && s_scrub_free)
+        memset(ptr, FREE_SCRUB_BYTE, ((ChunkedBlock*)block_base)->bytes_per_chunk());
+
+#ifndef NO_TLS
+    if (magic == MAGIC_PAGE_HEADER) {
+        auto* block = (ChunkedBlock*)block_base;
+        size_t good_size;
+        auto* allocator = allocator_for_size(block->m_size, good_size);
+        if (size_class_index(*allocator) < number_of_thread_cached_size_classes) {
+            auto& cache = t_chunk_caches[size_class_index(*allocator)];
+            if (cache.count == number_of_chunks_to_cache_per_thread_per_size_class) {
+                LOCKER(malloc_lock());
+                flush_thread_chunk_cache(cache, number_of_chunks_to_cache_per_thread_per_size_class - number_of_chunks_to_move_per_thread_cache_refill);
+            } else {
+                AK::atomic_fetch_add(&g_malloc_stats.number_of_thread_cache_frees, (size_t)1, AK::memory_order_relaxed);
+            }
+            cache.chunks[cache.count++] = ptr;
+            return;
+        }
+    }
+#endif
+
+    LOCKER(malloc_lock());
+
+    if (magic == MAGIC_BIGALLOC_HEADER) {
+        auto* block = (BigAllocationBlock*)block_base;
+#ifdef RECYCLE_BIG_ALLOCATIONS
+        if (auto* allocator = big_allocator_for_size(block->m_size)) {
+            if (allocator->blocks.size() < number_of_big_blocks_to_keep_around_per_size_class) {
+                g_malloc_stats.number_of_big_allocator_keeps++;
+                allocator->blocks.append(block);
+                size_t this_block_size = block->m_size;
+                if (mprotect(block, this_block_size, PROT_NONE) < 0) {
+                    perror("mprotect");
+                    VERIFY_NOT_REACHED();
+                }
+                if (madvise(block, this_block_size, MADV_SET_VOLATILE) != 0) {
+                    perror("madvise");
+                    VERIFY_NOT_REACHED();
+                }
+                return;
+            }
+        }
+#endif
+        g_malloc_stats.number_of_big_allocator_frees++;
+        os_free(block, block->m_size);
+        return;
+    }
+
+    assert(magic == MAGIC_PAGE_HEADER);
+    free_chunk((ChunkedBlock*)block_base, ptr);
+}
+
+void __malloc_thread_exit()
+{
+    // Give the chunks cached by this thread back to their blocks, nobody
+    // else would ever be able to use them again.
+#ifndef NO_TLS
+    LOCKER(malloc_lock());
+    for (auto& cache : t_chunk_caches)
+        flush_thread_chunk_cache(cache, 0);
+#endif
+}
+
 [[gnu::flatten]] void* malloc(size_t size)
 {
     void* ptr = malloc_impl(size, CallerWillInitializeMemory::No);
@@ -476,5 +591,10 @@ void serenity_dump_malloc_stats()
     dbgln("full block frees: {}", g_malloc_stats.number_of_freed_full_blocks);
     dbgln("number of keeps: {}", g_malloc_stats.number_of_keeps);
     dbgln("number of frees: {}", g_malloc_stats.number_of_frees);
+    dbgln();
+    dbgln("thread cache hits: {}", g_malloc_stats.number_of_thread_cache_hits);
+    dbgln("thread cache refills: {}", g_malloc_stats.number_of_thread_cache_refills);
+    dbgln("thread cache frees: {}", g_malloc_stats.number_of_thread_cache_frees);
+    dbgln("thread cache flushes: {}", g_malloc_stats.number_of_thread_cache_flushes);
 }
 }
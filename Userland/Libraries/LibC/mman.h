@@ -49,6 +49,8 @@
 #define MADV_SET_VOLATILE 0x100
 #define MADV_SET_NONVOLATILE 0x200
 #define MADV_GET_VOLATILE 0x400
+#define MADV_HUGEPAGE 0x800
+#define MADV_NOHUGEPAGE 0x1000
 
 __BEGIN_DECLS
 
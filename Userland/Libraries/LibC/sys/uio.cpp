@@ -41,4 +41,18 @@ ssize_t readv(int fd, const struct iovec* iov, int iov_count)
     int rc = syscall(SC_readv, fd, iov, iov_count);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
+
+ssize_t pwritev(int fd, const struct iovec* iov, int iov_count, off_t offset)
+{
+    Syscall::SC_pwritev_params params { fd, iov, iov_count, offset };
+    int rc = syscall(SC_pwritev, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+ssize_t preadv(int fd, const struct iovec* iov, int iov_count, off_t offset)
+{
+    Syscall::SC_preadv_params params { fd, iov, iov_count, offset };
+    int rc = syscall(SC_preadv, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
 }
@@ -38,5 +38,7 @@ struct iovec {
 
 ssize_t writev(int fd, const struct iovec*, int iov_count);
 ssize_t readv(int fd, const struct iovec*, int iov_count);
+ssize_t pwritev(int fd, const struct iovec*, int iov_count, off_t offset);
+ssize_t preadv(int fd, const struct iovec*, int iov_count, off_t offset);
 
 __END_DECLS
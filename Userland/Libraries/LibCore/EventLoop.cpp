@@ -55,6 +55,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __serenity__
+#    include <sys/epoll.h>
+#endif
+
 namespace Core {
 
 class RPCClient;
@@ -79,8 +83,67 @@ static EventLoop* s_main_event_loop;
 static Vector<EventLoop*>* s_event_loop_stack;
 static NeverDestroyed<IDAllocator> s_id_allocator;
 static HashMap<int, NonnullOwnPtr<EventLoopTimer>>* s_timers;
-static HashTable<Notifier*>* s_notifiers;
+static HashMap<int, Vector<Notifier*, 1>>* s_notifiers;
 int EventLoop::s_wake_pipe_fds[2];
+
+#ifdef __serenity__
+// The notifiers are kept in an epoll interest set which is only updated when
+// notifiers change, instead of rebuilding fd sets for select() on every wait.
+static int s_epoll_fd = -1;
+
+static void update_epoll_interest(int fd)
+{
+    if (s_epoll_fd < 0)
+        return;
+
+    u32 events = 0;
+    if (auto notifiers = s_notifiers->get(fd); notifiers.has_value()) {
+        for (auto* notifier : notifiers.value()) {
+            if (notifier->event_mask() & Notifier::Read)
+                events |= EPOLLIN;
+            if (notifier->event_mask() & Notifier::Write)
+                events |= EPOLLOUT;
+            if (notifier->event_mask() & Notifier::Exceptional)
+                VERIFY_NOT_REACHED();
+        }
+    }
+
+    if (!events) {
+        // The fd may already have been closed, which is fine.
+        epoll_ctl(s_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(s_epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0)
+        return;
+    if (errno != ENOENT || epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("EventLoop: epoll_ctl");
+        VERIFY_NOT_REACHED();
+    }
+}
+
+static void create_epoll_fd(int wake_pipe_fd)
+{
+    VERIFY(s_epoll_fd < 0);
+    s_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (s_epoll_fd < 0) {
+        perror("EventLoop: epoll_create1");
+        VERIFY_NOT_REACHED();
+    }
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = wake_pipe_fd;
+    int rc = epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, event.data.fd, &event);
+    VERIFY(rc == 0);
+
+    for (auto& it : *s_notifiers)
+        update_epoll_interest(it.key);
+}
+#endif
 static RefPtr<LocalServer> s_rpc_server;
 HashMap<int, RefPtr<RPCClient>> s_rpc_clients;
 
@@ -282,7 +345,7 @@ EventLoop::EventLoop()
     if (!s_event_loop_stack) {
         s_event_loop_stack = new Vector<EventLoop*>;
         s_timers = new HashMap<int, NonnullOwnPtr<EventLoopTimer>>;
-        s_notifiers = new HashTable<Notifier*>;
+        s_notifiers = new HashMap<int, Vector<Notifier*, 1>>;
     }
 
     if (!s_main_event_loop) {
@@ -299,6 +362,10 @@ EventLoop::EventLoop()
         VERIFY(rc == 0);
         s_event_loop_stack->append(this);
 
+#ifdef __serenity__
+        create_epoll_fd(s_wake_pipe_fds[0]);
+#endif
+
 #ifdef __serenity__
         if (!s_rpc_server) {
             if (!start_rpc_server())
@@ -386,6 +453,7 @@ private:
 int EventLoop::exec()
 {
     EventLoopPusher pusher(*this);
+    TemporaryChange change(m_is_running, true);
     for (;;) {
         if (m_exit_requested)
             return m_exit_code;
@@ -600,6 +668,13 @@ void EventLoop::notify_forked(ForkEvent event)
         s_event_loop_stack->clear();
         s_timers->clear();
         s_notifiers->clear();
+#ifdef __serenity__
+        // The epoll interest set is shared with the parent, so we need our own.
+        if (s_epoll_fd >= 0) {
+            close(s_epoll_fd);
+            s_epoll_fd = -1;
+        }
+#endif
         if (auto* info = signals_info<false>()) {
             info->signal_handlers.clear();
             info->next_signal_id = 0;
@@ -617,6 +692,10 @@ void EventLoop::notify_forked(ForkEvent event)
 
 void EventLoop::wait_for_event(WaitMode mode)
 {
+#ifdef __serenity__
+    epoll_event ready_events[32];
+retry:
+#else
     fd_set rfds;
     fd_set wfds;
 retry:
@@ -633,14 +712,17 @@ retry:
     int max_fd_added = -1;
     add_fd_to_set(s_wake_pipe_fds[0], rfds);
     max_fd = max(max_fd, max_fd_added);
-    for (auto& notifier : *s_notifiers) {
-        if (notifier->event_mask() & Notifier::Read)
-            add_fd_to_set(notifier->fd(), rfds);
-        if (notifier->event_mask() & Notifier::Write)
-            add_fd_to_set(notifier->fd(), wfds);
-        if (notifier->event_mask() & Notifier::Exceptional)
-            VERIFY_NOT_REACHED();
+    for (auto& it : *s_notifiers) {
+        for (auto* notifier : it.value) {
+            if (notifier->event_mask() & Notifier::Read)
+                add_fd_to_set(notifier->fd(), rfds);
+            if (notifier->event_mask() & Notifier::Write)
+                add_fd_to_set(notifier->fd(), wfds);
+            if (notifier->event_mask() & Notifier::Exceptional)
+                VERIFY_NOT_REACHED();
+        }
     }
+#endif
 
     bool queued_events_is_empty;
     {
@@ -669,7 +751,13 @@ retry:
     }
 
 try_select_again:
+#ifdef __serenity__
+    // Round up, so we don't spin until a timer that's less than a millisecond away expires.
+    int timeout_ms = should_wait_forever ? -1 : timeout.tv_sec * 1000 + (timeout.tv_usec + 999) / 1000;
+    int marked_fd_count = epoll_wait(s_epoll_fd, ready_events, array_size(ready_events), timeout_ms);
+#else
     int marked_fd_count = select(max_fd + 1, &rfds, &wfds, nullptr, should_wait_forever ? nullptr : &timeout);
+#endif
     if (marked_fd_count < 0) {
         int saved_errno = errno;
         if (saved_errno == EINTR) {
@@ -683,7 +771,16 @@ try_select_again:
         // Blow up, similar to Core::safe_syscall.
         VERIFY_NOT_REACHED();
     }
-    if (FD_ISSET(s_wake_pipe_fds[0], &rfds)) {
+#ifdef __serenity__
+    bool wake_pipe_is_readable = false;
+    for (int i = 0; i < marked_fd_count; ++i) {
+        if (ready_events[i].data.fd == s_wake_pipe_fds[0])
+            wake_pipe_is_readable = true;
+    }
+#else
+    bool wake_pipe_is_readable = FD_ISSET(s_wake_pipe_fds[0], &rfds);
+#endif
+    if (wake_pipe_is_readable) {
         int wake_events[8];
         auto nread = read(s_wake_pipe_fds[0], wake_events, sizeof(wake_events));
         if (nread < 0) {
@@ -736,16 +833,37 @@ try_select_again:
     if (!marked_fd_count)
         return;
 
-    for (auto& notifier : *s_notifiers) {
-        if (FD_ISSET(notifier->fd(), &rfds)) {
-            if (notifier->event_mask() & Notifier::Event::Read)
-                post_event(*notifier, make<NotifierReadEvent>(notifier->fd()));
+#ifdef __serenity__
+    for (int i = 0; i < marked_fd_count; ++i) {
+        auto& ready_event = ready_events[i];
+        auto notifiers = s_notifiers->get(ready_event.data.fd);
+        if (!notifiers.has_value())
+            continue;
+        for (auto* notifier : notifiers.value()) {
+            if (ready_event.events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                if (notifier->event_mask() & Notifier::Event::Read)
+                    post_event(*notifier, make<NotifierReadEvent>(notifier->fd()));
+            }
+            if (ready_event.events & EPOLLOUT) {
+                if (notifier->event_mask() & Notifier::Event::Write)
+                    post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
+            }
         }
-        if (FD_ISSET(notifier->fd(), &wfds)) {
-            if (notifier->event_mask() & Notifier::Event::Write)
-                post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
+    }
+#else
+    for (auto& it : *s_notifiers) {
+        for (auto* notifier : it.value) {
+            if (FD_ISSET(notifier->fd(), &rfds)) {
+                if (notifier->event_mask() & Notifier::Event::Read)
+                    post_event(*notifier, make<NotifierReadEvent>(notifier->fd()));
+            }
+            if (FD_ISSET(notifier->fd(), &wfds)) {
+                if (notifier->event_mask() & Notifier::Event::Write)
+                    post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
+            }
         }
     }
+#endif
 }
 
 bool EventLoopTimer::has_expired(const timeval& now) const
@@ -808,12 +926,37 @@ bool EventLoop::unregister_timer(int timer_id)
 
 void EventLoop::register_notifier(Badge<Notifier>, Notifier& notifier)
 {
-    s_notifiers->set(&notifier);
+    auto& notifiers = s_notifiers->ensure(notifier.fd());
+    if (notifiers.contains_slow(&notifier))
+        return;
+    notifiers.append(&notifier);
+#ifdef __serenity__
+    update_epoll_interest(notifier.fd());
+#endif
 }
 
 void EventLoop::unregister_notifier(Badge<Notifier>, Notifier& notifier)
 {
-    s_notifiers->remove(&notifier);
+    auto it = s_notifiers->find(notifier.fd());
+    if (it == s_notifiers->end())
+        return;
+    it->value.remove_first_matching([&](auto* entry) { return entry == &notifier; });
+    if (it->value.is_empty())
+        s_notifiers->remove(it);
+#ifdef __serenity__
+    update_epoll_interest(notifier.fd());
+#endif
+}
+
+void EventLoop::did_change_notifier_event_mask(Badge<Notifier>, Notifier& notifier)
+{
+#ifdef __serenity__
+    auto notifiers = s_notifiers->get(notifier.fd());
+    if (notifiers.has_value() && notifiers.value().contains_slow(&notifier))
+        update_epoll_interest(notifier.fd());
+#else
+    (void)notifier;
+#endif
 }
 
 void EventLoop::wake()
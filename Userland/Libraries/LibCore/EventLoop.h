@@ -62,11 +62,15 @@ public:
 
     bool was_exit_requested() const { return m_exit_requested; }
 
+    // Whether exec() is going to process events posted to this loop.
+    bool is_running() const { return m_is_running && !m_exit_requested; }
+
     static int register_timer(Object&, int milliseconds, bool should_reload, TimerShouldFireWhenNotVisible);
     static bool unregister_timer(int timer_id);
 
     static void register_notifier(Badge<Notifier>, Notifier&);
     static void unregister_notifier(Badge<Notifier>, Notifier&);
+    static void did_change_notifier_event_mask(Badge<Notifier>, Notifier&);
 
     void quit(int);
     void unquit();
@@ -110,6 +114,7 @@ private:
     Vector<QueuedEvent, 64> m_queued_events;
     static pid_t s_pid;
 
+    bool m_is_running { false };
     bool m_exit_requested { false };
     int m_exit_code { 0 };
 
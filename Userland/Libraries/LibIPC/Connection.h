@@ -27,20 +27,29 @@
 #pragma once
 
 #include <AK/ByteBuffer.h>
+#include <AK/HashMap.h>
+#include <AK/HashTable.h>
+#include <AK/MemoryStream.h>
 #include <AK/NonnullOwnPtrVector.h>
+#include <AK/ScopeGuard.h>
 #include <LibCore/Event.h>
 #include <LibCore/EventLoop.h>
 #include <LibCore/LocalSocket.h>
 #include <LibCore/Notifier.h>
 #include <LibCore/SyscallUtils.h>
 #include <LibCore/Timer.h>
+#include <LibIPC/Decoder.h>
+#include <LibIPC/Encoder.h>
 #include <LibIPC/Message.h>
+#include <LibIPC/SharedRing.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace IPC {
@@ -61,6 +70,16 @@ public:
         };
     }
 
+    virtual ~Connection() override
+    {
+        // A flush deferred to the event loop never runs if the loop was told to quit in the
+        // same iteration, so send whatever was posted before that. If this fails, shutdown()
+        // must not call die() on a half-destroyed object.
+        m_is_being_destroyed = true;
+        if (!m_outgoing_bytes.is_empty() && m_socket->is_open())
+            flush_outgoing_messages();
+    }
+
     template<typename MessageType>
     OwnPtr<MessageType> wait_for_specific_message()
     {
@@ -68,23 +87,166 @@ public:
     }
 
     void post_message(const Message& message)
+    {
+        send_message(message, 0);
+    }
+
+    // Moves the message bytes in both directions into a pair of shared memory rings.
+    // The socket is then only used for passing file descriptors and for waking up a
+    // peer that went idle, so busy peers can talk without making any syscalls.
+    // Waiting on a ring uses futex(), so both processes need the "thread" promise,
+    // and the peer has to opt in with set_accepts_shared_memory_transport().
+    bool enable_shared_memory_transport(size_t ring_capacity = SharedRing::default_capacity)
+    {
+#ifdef __serenity__
+        if (!m_socket->is_open() || m_send_ring || m_receive_ring || m_pending_receive_ring)
+            return false;
+
+        auto send_ring = SharedRing::try_create(ring_capacity);
+        auto receive_ring = SharedRing::try_create(ring_capacity);
+        if (!send_ring || !receive_ring)
+            return false;
+
+        MessageBuffer buffer;
+        Encoder stream(buffer);
+        stream << transport_magic << (i32)TransportMessageID::UseSharedRings;
+        encode(stream, send_ring->anonymous_buffer());
+        encode(stream, receive_ring->anonymous_buffer());
+        if (!send_message_buffer(buffer, 0) || !flush_outgoing_messages())
+            return false;
+
+        // Everything we send from now on goes through the ring. The peer keeps using the
+        // socket until it has seen our request, and tells us when it has switched over.
+        m_send_ring = move(send_ring);
+        m_pending_receive_ring = move(receive_ring);
+        return true;
+#else
+        (void)ring_capacity;
+        return false;
+#endif
+    }
+
+    // A peer asking for shared rings when we haven't opted in is disconnected.
+    void set_accepts_shared_memory_transport(bool accepts) { m_accepts_shared_memory_transport = accepts; }
+
+    template<typename RequestType, typename... Args>
+    OwnPtr<typename RequestType::ResponseType> send_sync(Args&&... args)
+    {
+        auto response = send_sync_but_allow_failure<RequestType>(forward<Args>(args)...);
+        VERIFY(response);
+        return response;
+    }
+
+    template<typename RequestType, typename... Args>
+    OwnPtr<typename RequestType::ResponseType> send_sync_but_allow_failure(Args&&... args)
+    {
+        auto request_id = post_request<RequestType>(forward<Args>(args)...);
+        return wait_for_response<typename RequestType::ResponseType>(request_id);
+    }
+
+    // Sends a request without waiting for the response, so that several requests can be
+    // in flight at once. Pass the returned ID to wait_for_response() to collect it.
+    template<typename RequestType, typename... Args>
+    u32 post_request(Args&&... args)
+    {
+        auto request_id = allocate_request_id();
+        m_pending_request_ids.set(request_id);
+        send_message(RequestType(forward<Args>(args)...), request_id);
+        return request_id;
+    }
+
+    template<typename ResponseType>
+    OwnPtr<ResponseType> wait_for_response(u32 request_id)
+    {
+        flush_outgoing_messages();
+        for (;;) {
+            for (size_t i = 0; i < m_unprocessed_messages.size(); ++i) {
+                auto& message = m_unprocessed_messages[i];
+                if (message.request_id() != request_id || message.endpoint_magic() != PeerEndpoint::static_magic())
+                    continue;
+                m_pending_request_ids.remove(request_id);
+                if (message.message_id() != ResponseType::static_message_id())
+                    return {};
+                return m_unprocessed_messages.take(i).template release_nonnull<ResponseType>();
+            }
+            if (!wait_for_incoming_messages())
+                break;
+        }
+        m_pending_request_ids.remove(request_id);
+        return {};
+    }
+
+    // Sends a request and calls back with the response once it arrives, from the event loop.
+    template<typename RequestType, typename... Args>
+    void async_request(Function<void(const typename RequestType::ResponseType&)> callback, Args&&... args)
+    {
+        using ResponseType = typename RequestType::ResponseType;
+        auto request_id = allocate_request_id();
+        m_response_callbacks.set(request_id, [callback = move(callback)](const Message& response) {
+            if (response.message_id() == ResponseType::static_message_id())
+                callback(static_cast<const ResponseType&>(response));
+        });
+        send_message(RequestType(forward<Args>(args)...), request_id);
+    }
+
+    virtual void may_have_become_unresponsive() { }
+    virtual void did_become_responsive() { }
+
+    // Sends whatever is still waiting to be flushed before hanging up, so call this
+    // rather than just dropping the connection if the last messages matter.
+    void shutdown()
+    {
+        if (m_socket->is_open())
+            flush_outgoing_messages();
+        if (m_send_ring)
+            m_send_ring->close();
+        if (m_receive_ring)
+            m_receive_ring->close();
+        m_notifier->close();
+        m_socket->close();
+        if (!m_is_being_destroyed)
+            die();
+    }
+
+    virtual void die() { }
+
+protected:
+    Core::LocalSocket& socket() { return *m_socket; }
+
+    bool send_message(const Message& message, u32 request_id)
     {
         // NOTE: If this connection is being shut down, but has not yet been destroyed,
         //       the socket will be closed. Don't try to send more messages.
         if (!m_socket->is_open())
-            return;
+            return false;
 
         auto buffer = message.encode();
-        // Prepend the message size.
-        uint32_t message_size = buffer.data.size();
-        buffer.data.prepend(reinterpret_cast<const u8*>(&message_size), sizeof(message_size));
+        if (!send_message_buffer(buffer, request_id))
+            return false;
+
+        m_responsiveness_timer->start();
+        return true;
+    }
+
+    u32 allocate_request_id()
+    {
+        // Zero means "not a request", so skip it when wrapping around.
+        if (++m_next_request_id == 0)
+            ++m_next_request_id;
+        return m_next_request_id;
+    }
 
+    bool send_message_buffer(MessageBuffer& buffer, u32 request_id)
+    {
 #ifdef __serenity__
+        // File descriptors travel separately from the message bytes, so they are
+        // queued up on the socket before the message that refers to them is sent.
         for (int fd : buffer.fds) {
             auto rc = sendfd(m_socket->fd(), fd);
             if (rc < 0) {
                 perror("sendfd");
                 shutdown();
+                return false;
             }
         }
 #else
@@ -92,65 +254,127 @@ public:
             warnln("fd passing is not supported on this platform, sorry :(");
 #endif
 
-        size_t total_nwritten = 0;
-        while (total_nwritten < buffer.data.size()) {
-            auto nwritten = write(m_socket->fd(), buffer.data.data() + total_nwritten, buffer.data.size() - total_nwritten);
+        // Messages posted during one event loop iteration are coalesced and sent with a single write.
+        // Without a running event loop the deferred flush might never happen, so send right away.
+        MessageHeader header { (u32)buffer.data.size(), request_id };
+        m_outgoing_bytes.append(reinterpret_cast<const u8*>(&header), sizeof(header));
+        m_outgoing_bytes.append(buffer.data.data(), buffer.data.size());
+        if (m_outgoing_bytes.size() >= max_coalesced_bytes || !Core::EventLoop::current().is_running())
+            return flush_outgoing_messages();
+
+        if (!m_flush_scheduled) {
+            m_flush_scheduled = true;
+            deferred_invoke([this](auto&) {
+                flush_outgoing_messages();
+            });
+        }
+        return true;
+    }
+
+    bool flush_outgoing_messages()
+    {
+        m_flush_scheduled = false;
+        if (m_outgoing_bytes.is_empty())
+            return true;
+
+        // Take the bytes first, since failing below calls shutdown(), which flushes again.
+        auto outgoing_bytes = move(m_outgoing_bytes);
+        ScopeGuard reuse_outgoing_bytes = [&] {
+            if (!m_outgoing_bytes.is_empty())
+                return;
+            outgoing_bytes.clear_with_capacity();
+            m_outgoing_bytes = move(outgoing_bytes);
+        };
+        if (!m_socket->is_open())
+            return false;
+
+        ReadonlyBytes bytes = outgoing_bytes.span();
+        if (m_send_ring)
+            return write_to_send_ring(bytes);
+
+        while (!bytes.is_empty()) {
+            auto nwritten = write(m_socket->fd(), bytes.data(), bytes.size());
             if (nwritten < 0) {
                 switch (errno) {
                 case EPIPE:
                     dbgln("{}::post_message: Disconnected from peer", *this);
                     shutdown();
-                    return;
+                    return false;
                 case EAGAIN:
                     dbgln("{}::post_message: Peer buffer overflowed", *this);
                     shutdown();
-                    return;
+                    return false;
                 default:
                     perror("Connection::post_message write");
                     shutdown();
-                    return;
+                    return false;
                 }
             }
-            total_nwritten += nwritten;
+            bytes = bytes.slice(nwritten);
         }
-
-        m_responsiveness_timer->start();
+        return true;
     }
 
-    template<typename RequestType, typename... Args>
-    OwnPtr<typename RequestType::ResponseType> send_sync(Args&&... args)
+    bool write_to_send_ring(ReadonlyBytes bytes)
     {
-        post_message(RequestType(forward<Args>(args)...));
-        auto response = wait_for_specific_endpoint_message<typename RequestType::ResponseType, PeerEndpoint>();
-        VERIFY(response);
-        return response;
+        for (;;) {
+            auto nwritten = m_send_ring->write(bytes);
+            if (!nwritten.has_value()) {
+                dbgln("{}::post_message: Shared ring is corrupted", *this);
+                shutdown();
+                return false;
+            }
+            bytes = bytes.slice(nwritten.value());
+            if (bytes.is_empty())
+                break;
+
+            // The ring is full, so make sure the peer is draining it before we wait for room.
+            if (!wake_peer())
+                return false;
+            if (m_send_ring->is_closed()) {
+                dbgln("{}::post_message: Disconnected from peer", *this);
+                shutdown();
+                return false;
+            }
+            if (fcntl(m_socket->fd(), F_GETFL) & O_NONBLOCK) {
+                dbgln("{}::post_message: Peer buffer overflowed", *this);
+                shutdown();
+                return false;
+            }
+            m_send_ring->wait_for_space(ring_wait_timeout_ms);
+            // If the peer has died without closing the ring, ringing the doorbell will tell us.
+            if (!ring_doorbell())
+                return false;
+        }
+        return wake_peer();
     }
 
-    template<typename RequestType, typename... Args>
-    OwnPtr<typename RequestType::ResponseType> send_sync_but_allow_failure(Args&&... args)
+    bool wake_peer()
     {
-        post_message(RequestType(forward<Args>(args)...));
-        return wait_for_specific_endpoint_message<typename RequestType::ResponseType, PeerEndpoint>();
+        if (!m_send_ring->wake_consumer())
+            return true;
+        return ring_doorbell();
     }
 
-    virtual void may_have_become_unresponsive() { }
-    virtual void did_become_responsive() { }
-
-    void shutdown()
+    bool ring_doorbell()
     {
-        m_notifier->close();
-        m_socket->close();
-        die();
+        // Once the shared rings are in use, any bytes on the socket are just doorbells.
+        u8 doorbell = 0;
+        if (send(m_socket->fd(), &doorbell, sizeof(doorbell), MSG_DONTWAIT) < 0 && errno != EAGAIN) {
+            if (errno == EPIPE)
+                dbgln("{}::post_message: Disconnected from peer", *this);
+            else
+                perror("Connection::post_message send");
+            shutdown();
+            return false;
+        }
+        return true;
     }
 
-    virtual void die() { }
-
-protected:
-    Core::LocalSocket& socket() { return *m_socket; }
-
     template<typename MessageType, typename Endpoint>
     OwnPtr<MessageType> wait_for_specific_endpoint_message()
     {
+        flush_outgoing_messages();
         for (;;) {
             // Double check we don't already have the event waiting for us.
             // Otherwise we might end up blocked for a while for no reason.
@@ -162,26 +386,37 @@ protected:
                     return m_unprocessed_messages.take(i).template release_nonnull<MessageType>();
             }
 
-            if (!m_socket->is_open())
-                break;
-            fd_set rfds;
-            FD_ZERO(&rfds);
-            FD_SET(m_socket->fd(), &rfds);
-            int rc = Core::safe_syscall(select, m_socket->fd() + 1, &rfds, nullptr, nullptr, nullptr);
-            if (rc < 0) {
-                perror("select");
-            }
-            VERIFY(rc > 0);
-            VERIFY(FD_ISSET(m_socket->fd(), &rfds));
-            if (!drain_messages_from_peer())
+            if (!wait_for_incoming_messages())
                 break;
         }
         return {};
     }
 
+    bool wait_for_incoming_messages()
+    {
+        if (!m_socket->is_open())
+            return false;
+        if (m_receive_ring) {
+            m_receive_ring->wait_for_data(ring_wait_timeout_ms);
+            return drain_messages_from_peer();
+        }
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(m_socket->fd(), &rfds);
+        int rc = Core::safe_syscall(select, m_socket->fd() + 1, &rfds, nullptr, nullptr, nullptr);
+        if (rc < 0) {
+            perror("select");
+        }
+        VERIFY(rc > 0);
+        VERIFY(FD_ISSET(m_socket->fd(), &rfds));
+        return drain_messages_from_peer();
+    }
+
     bool drain_messages_from_peer()
     {
-        Vector<u8> bytes;
+        // Messages decoded from these bytes may borrow from them, so they share ownership.
+        auto received_bytes = ReceivedBytes::create({});
+        auto& bytes = received_bytes->bytes();
 
         if (!m_unprocessed_bytes.is_empty()) {
             bytes.append(m_unprocessed_bytes.data(), m_unprocessed_bytes.size());
@@ -204,9 +439,14 @@ protected:
                 }
                 return false;
             }
-            bytes.append(buffer, nread);
+            // Once the peer has switched to the shared ring, it only writes doorbells to the socket.
+            if (!m_receive_ring)
+                bytes.append(buffer, nread);
         }
 
+        if (m_receive_ring && !read_from_receive_ring(bytes))
+            return false;
+
         if (!bytes.is_empty()) {
             m_responsiveness_timer->stop();
             did_become_responsive();
@@ -214,15 +454,37 @@ protected:
 
         size_t index = 0;
         uint32_t message_size = 0;
-        for (; index + sizeof(message_size) < bytes.size(); index += message_size) {
-            message_size = *reinterpret_cast<uint32_t*>(bytes.data() + index);
-            if (message_size == 0 || bytes.size() - index - sizeof(uint32_t) < message_size)
+        for (; index + sizeof(MessageHeader) < bytes.size(); index += message_size) {
+            MessageHeader header;
+            memcpy(&header, bytes.data() + index, sizeof(header));
+            message_size = header.size;
+            if (message_size == 0 || bytes.size() - index - sizeof(MessageHeader) < message_size)
                 break;
-            index += sizeof(message_size);
+            index += sizeof(MessageHeader);
             auto remaining_bytes = ReadonlyBytes { bytes.data() + index, bytes.size() - index };
+            if (is_transport_message(remaining_bytes)) {
+                bool was_using_receive_ring = m_receive_ring;
+                if (!handle_transport_message(remaining_bytes.trim(message_size))) {
+                    dbgln("{}::drain_messages_from_peer: Bad transport message", *this);
+                    shutdown();
+                    return false;
+                }
+                if (!was_using_receive_ring && m_receive_ring) {
+                    // Anything after this message on the socket is a doorbell. The messages that
+                    // follow it are waiting in the ring, and get picked up once we're done here.
+                    // (Appending them to this buffer could move messages that borrow from it.)
+                    index = bytes.size();
+                    break;
+                }
+                continue;
+            }
             if (auto message = LocalEndpoint::decode_message(remaining_bytes, m_socket->fd())) {
+                message->set_request_id(header.request_id);
+                message->set_received_bytes(received_bytes);
                 m_unprocessed_messages.append(message.release_nonnull());
             } else if (auto message = PeerEndpoint::decode_message(remaining_bytes, m_socket->fd())) {
+                message->set_request_id(header.request_id);
+                message->set_received_bytes(received_bytes);
                 m_unprocessed_messages.append(message.release_nonnull());
             } else {
                 dbgln("Failed to parse a message");
@@ -248,20 +510,142 @@ protected:
                 handle_messages();
             });
         }
+
+        // Let the peer know it has to ring the doorbell before we go back to sleeping on the socket.
+        if (m_receive_ring && !m_receive_ring->prepare_for_idle()) {
+            deferred_invoke([this](auto&) {
+                drain_messages_from_peer();
+            });
+        }
         return true;
     }
 
+    bool read_from_receive_ring(Vector<u8>& bytes)
+    {
+        for (;;) {
+            size_t old_size = bytes.size();
+            bytes.resize(old_size + ring_read_chunk_size);
+            auto nread = m_receive_ring->read(bytes.span().slice(old_size));
+            if (!nread.has_value()) {
+                dbgln("{}::drain_messages_from_peer: Shared ring is corrupted", *this);
+                shutdown();
+                return false;
+            }
+            bytes.shrink(old_size + nread.value(), true);
+            if (nread.value() < ring_read_chunk_size)
+                return true;
+        }
+    }
+
+    static bool is_transport_message(ReadonlyBytes bytes)
+    {
+        i32 magic = 0;
+        if (bytes.size() < sizeof(magic))
+            return false;
+        memcpy(&magic, bytes.data(), sizeof(magic));
+        return magic == transport_magic;
+    }
+
+    bool handle_transport_message(ReadonlyBytes bytes)
+    {
+        InputMemoryStream stream { bytes };
+        Decoder decoder { stream, m_socket->fd() };
+        i32 magic = 0;
+        i32 message_id = 0;
+        if (!decoder.decode(magic) || !decoder.decode(message_id))
+            return false;
+
+        switch ((TransportMessageID)message_id) {
+        case TransportMessageID::UseSharedRings: {
+            if (!m_accepts_shared_memory_transport)
+                return false;
+            if (m_send_ring || m_receive_ring || m_pending_receive_ring)
+                return false;
+            Core::AnonymousBuffer peer_send_buffer;
+            Core::AnonymousBuffer peer_receive_buffer;
+            if (!decode(decoder, peer_send_buffer) || !decode(decoder, peer_receive_buffer))
+                return false;
+            auto receive_ring = SharedRing::try_attach(move(peer_send_buffer));
+            auto send_ring = SharedRing::try_attach(move(peer_receive_buffer));
+            if (!receive_ring || !send_ring)
+                return false;
+
+            // This is the last message we send over the socket.
+            MessageBuffer buffer;
+            Encoder reply(buffer);
+            reply << transport_magic << (i32)TransportMessageID::DidUseSharedRings;
+            if (!send_message_buffer(buffer, 0) || !flush_outgoing_messages())
+                return false;
+            m_send_ring = move(send_ring);
+            m_receive_ring = move(receive_ring);
+            return true;
+        }
+        case TransportMessageID::DidUseSharedRings:
+            if (!m_pending_receive_ring)
+                return false;
+            m_receive_ring = move(m_pending_receive_ring);
+            return true;
+        }
+        return false;
+    }
+
     void handle_messages()
     {
-        auto messages = move(m_unprocessed_messages);
-        for (auto& message : messages) {
-            if (message.endpoint_magic() == LocalEndpoint::static_magic())
-                if (auto response = m_local_endpoint.handle(message))
-                    post_message(*response);
+        // Handlers may call wait_for_response() for a message that arrived in the same batch,
+        // so each message is only taken out of m_unprocessed_messages right before dispatch.
+        for (;;) {
+            size_t i = 0;
+            while (i < m_unprocessed_messages.size() && is_awaited_response(m_unprocessed_messages[i]))
+                ++i;
+            if (i == m_unprocessed_messages.size())
+                break;
+            auto message = m_unprocessed_messages.take(i);
+            if (message->endpoint_magic() == LocalEndpoint::static_magic()) {
+                // The response goes out tagged with the ID of the request it answers.
+                if (auto response = m_local_endpoint.handle(*message))
+                    send_message(*response, message->request_id());
+                continue;
+            }
+            if (message->request_id() == 0)
+                continue;
+            if (auto it = m_response_callbacks.find(message->request_id()); it != m_response_callbacks.end()) {
+                auto callback = move(it->value);
+                m_response_callbacks.remove(it);
+                callback(*message);
+            }
         }
     }
 
 protected:
+    // Someone is going to ask for this response with wait_for_response(), so it stays queued.
+    bool is_awaited_response(const Message& message) const
+    {
+        if (message.endpoint_magic() == LocalEndpoint::static_magic() || message.request_id() == 0)
+            return false;
+        if (m_response_callbacks.contains(message.request_id()))
+            return false;
+        return m_pending_request_ids.contains(message.request_id());
+    }
+
+    struct MessageHeader {
+        u32 size;
+        u32 request_id;
+    };
+
+    // Messages that control the connection itself rather than belonging to either endpoint.
+    static constexpr i32 transport_magic = 0x474e4952;
+    enum class TransportMessageID : i32 {
+        UseSharedRings = 1,
+        DidUseSharedRings = 2,
+    };
+
+    // How long to sleep on a shared ring before checking whether the peer has gone away.
+    static constexpr int ring_wait_timeout_ms = 250;
+    static constexpr size_t ring_read_chunk_size = 4096;
+
+    // Flush early instead of letting a burst of messages pile up in memory.
+    static constexpr size_t max_coalesced_bytes = 64 * KiB;
+
     LocalEndpoint& m_local_endpoint;
     NonnullRefPtr<Core::LocalSocket> m_socket;
     RefPtr<Core::Timer> m_responsiveness_timer;
@@ -269,6 +653,19 @@ protected:
     RefPtr<Core::Notifier> m_notifier;
     NonnullOwnPtrVector<Message> m_unprocessed_messages;
     ByteBuffer m_unprocessed_bytes;
+
+    Vector<u8> m_outgoing_bytes;
+    bool m_flush_scheduled { false };
+    bool m_is_being_destroyed { false };
+
+    u32 m_next_request_id { 0 };
+    HashTable<u32> m_pending_request_ids;
+    HashMap<u32, Function<void(const Message&)>> m_response_callbacks;
+
+    OwnPtr<SharedRing> m_send_ring;
+    OwnPtr<SharedRing> m_receive_ring;
+    OwnPtr<SharedRing> m_pending_receive_ring;
+    bool m_accepts_shared_memory_transport { false };
 };
 
 }
@@ -136,6 +136,36 @@ bool Decoder::decode(ByteBuffer& value)
     return !m_stream.handle_any_error();
 }
 
+bool Decoder::decode(StringView& value)
+{
+    ReadonlyBytes bytes;
+    if (!decode(bytes))
+        return false;
+    if (bytes.data() == nullptr) {
+        value = {};
+        return true;
+    }
+    value = StringView { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+    return true;
+}
+
+bool Decoder::decode(ReadonlyBytes& value)
+{
+    i32 length = 0;
+    m_stream >> length;
+    if (m_stream.handle_any_error())
+        return false;
+    if (length < 0) {
+        value = {};
+        return true;
+    }
+    if (static_cast<size_t>(length) > m_stream.remaining())
+        return false;
+    value = m_stream.bytes().slice(m_stream.offset(), length);
+    m_stream.discard_or_error(length);
+    return true;
+}
+
 bool Decoder::decode(URL& value)
 {
     String string;
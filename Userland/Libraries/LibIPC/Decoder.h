@@ -27,6 +27,7 @@
 #pragma once
 
 #include <AK/Forward.h>
+#include <AK/MemoryStream.h>
 #include <AK/NumericLimits.h>
 #include <AK/StdLibExtras.h>
 #include <AK/String.h>
@@ -62,6 +63,10 @@ public:
     bool decode(float&);
     bool decode(String&);
     bool decode(ByteBuffer&);
+    // These borrow from the message buffer instead of copying, so they're only valid
+    // for as long as the decoded message is alive.
+    bool decode(StringView&);
+    bool decode(ReadonlyBytes&);
     bool decode(URL&);
     bool decode(Dictionary&);
     bool decode(File&);
@@ -98,6 +103,8 @@ public:
         u64 size;
         if (!decode(size) || size > NumericLimits<i32>::max())
             return false;
+        // Every element takes up at least one byte, which keeps a bogus size from making us allocate a lot.
+        vector.ensure_capacity(vector.size() + min(size, (u64)m_stream.remaining()));
         for (size_t i = 0; i < size; ++i) {
             T value;
             if (!decode(value))
@@ -27,6 +27,8 @@
 #pragma once
 
 #include <AK/Function.h>
+#include <AK/RefCounted.h>
+#include <AK/RefPtr.h>
 #include <AK/Vector.h>
 
 namespace IPC {
@@ -36,6 +38,23 @@ struct MessageBuffer {
     Vector<int> fds;
 };
 
+// The bytes a batch of incoming messages was decoded from. Messages with
+// StringView or ReadonlyBytes parameters point into it, so they keep it alive.
+class ReceivedBytes : public RefCounted<ReceivedBytes> {
+public:
+    static NonnullRefPtr<ReceivedBytes> create(Vector<u8>&& bytes) { return adopt(*new ReceivedBytes(move(bytes))); }
+
+    Vector<u8>& bytes() { return m_bytes; }
+
+private:
+    explicit ReceivedBytes(Vector<u8>&& bytes)
+        : m_bytes(move(bytes))
+    {
+    }
+
+    Vector<u8> m_bytes;
+};
+
 class Message {
 public:
     virtual ~Message();
@@ -45,8 +64,18 @@ public:
     virtual const char* message_name() const = 0;
     virtual MessageBuffer encode() const = 0;
 
+    // Non-zero for requests made with Connection::post_request() and for their responses.
+    u32 request_id() const { return m_request_id; }
+    void set_request_id(u32 request_id) { m_request_id = request_id; }
+
+    void set_received_bytes(NonnullRefPtr<ReceivedBytes> received_bytes) { m_received_bytes = move(received_bytes); }
+
 protected:
     Message();
+
+private:
+    u32 m_request_id { 0 };
+    RefPtr<ReceivedBytes> m_received_bytes;
 };
 
 }
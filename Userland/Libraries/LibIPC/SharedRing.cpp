@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LibIPC/SharedRing.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__serenity__)
+#    include <serenity.h>
+#elif defined(__linux__)
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#else
+#    include <unistd.h>
+#endif
+
+namespace IPC {
+
+static constexpr u32 shared_ring_magic = 0x474e4952; // "RING"
+static constexpr size_t header_size = 256;
+
+// The producer and consumer each get their own cache line for the fields they write.
+struct SharedRing::Header {
+    u32 magic;
+    u32 capacity;
+    alignas(64) Atomic<u32> write_position;
+    Atomic<u32> producer_state;
+    alignas(64) Atomic<u32> read_position;
+    Atomic<u32> consumer_state;
+    alignas(64) Atomic<u32> closed;
+};
+
+static constexpr bool is_power_of_two(size_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static void futex_wait(Atomic<u32>& word, u32 expected, int timeout_ms)
+{
+    timespec timeout { timeout_ms / 1000, (timeout_ms % 1000) * 1'000'000 };
+#if defined(__serenity__)
+    futex(const_cast<u32*>(word.ptr()), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#elif defined(__linux__)
+    syscall(SYS_futex, word.ptr(), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#else
+    (void)word;
+    (void)expected;
+    nanosleep(&timeout, nullptr);
+#endif
+}
+
+static void futex_wake(Atomic<u32>& word)
+{
+#if defined(__serenity__)
+    futex(const_cast<u32*>(word.ptr()), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#elif defined(__linux__)
+    syscall(SYS_futex, word.ptr(), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+OwnPtr<SharedRing> SharedRing::try_create(size_t capacity)
+{
+    static_assert(sizeof(Header) <= header_size);
+    VERIFY(is_power_of_two(capacity));
+    VERIFY(capacity <= NumericLimits<i32>::max());
+    auto buffer = Core::AnonymousBuffer::create_with_size(header_size + capacity);
+    if (!buffer.is_valid())
+        return {};
+    // The buffer is freshly zeroed, so the positions and states are already where they should be.
+    auto* header = buffer.data<u8>();
+    reinterpret_cast<Header*>(header)->magic = shared_ring_magic;
+    reinterpret_cast<Header*>(header)->capacity = capacity;
+    return adopt_own(*new SharedRing(move(buffer), capacity));
+}
+
+OwnPtr<SharedRing> SharedRing::try_attach(Core::AnonymousBuffer buffer)
+{
+    if (!buffer.is_valid() || buffer.size() <= header_size)
+        return {};
+    auto& header = *reinterpret_cast<const Header*>(buffer.data<u8>());
+    size_t capacity = header.capacity;
+    if (header.magic != shared_ring_magic || !is_power_of_two(capacity) || capacity != buffer.size() - header_size)
+        return {};
+    return adopt_own(*new SharedRing(move(buffer), capacity));
+}
+
+SharedRing::SharedRing(Core::AnonymousBuffer buffer, size_t capacity)
+    : m_buffer(move(buffer))
+    , m_capacity(capacity)
+{
+}
+
+SharedRing::Header& SharedRing::header()
+{
+    return *reinterpret_cast<Header*>(m_buffer.data<u8>());
+}
+
+const SharedRing::Header& SharedRing::header() const
+{
+    return *reinterpret_cast<const Header*>(m_buffer.data<u8>());
+}
+
+u8* SharedRing::data()
+{
+    return m_buffer.data<u8>() + header_size;
+}
+
+bool SharedRing::is_empty() const
+{
+    return header().write_position.load() == header().read_position.load();
+}
+
+bool SharedRing::is_closed() const
+{
+    return header().closed.load(AK::memory_order_relaxed);
+}
+
+Optional<size_t> SharedRing::write(ReadonlyBytes bytes)
+{
+    auto& header = this->header();
+    u32 write_position = header.write_position.load(AK::memory_order_relaxed);
+    u32 used = write_position - header.read_position.load(AK::memory_order_acquire);
+    if (used > m_capacity)
+        return {};
+
+    size_t count = min(bytes.size(), m_capacity - used);
+    size_t offset = write_position & (m_capacity - 1);
+    size_t first_chunk = min(count, m_capacity - offset);
+    memcpy(data() + offset, bytes.data(), first_chunk);
+    memcpy(data(), bytes.data() + first_chunk, count - first_chunk);
+
+    // Sequentially consistent, so this orders against the consumer announcing that it's idle.
+    header.write_position.store(write_position + count);
+    return count;
+}
+
+void SharedRing::wait_for_space(int timeout_ms)
+{
+    auto& header = this->header();
+    header.producer_state.store(Waiting);
+    u32 used = header.write_position.load() - header.read_position.load();
+    if (used == m_capacity && !is_closed())
+        futex_wait(header.producer_state, Waiting, timeout_ms);
+    header.producer_state.store(Busy);
+}
+
+bool SharedRing::wake_consumer()
+{
+    auto& header = this->header();
+    if (header.consumer_state.load() == Busy)
+        return false;
+    auto state = header.consumer_state.exchange(Busy);
+    if (state == Waiting)
+        futex_wake(header.consumer_state);
+    return state == Idle;
+}
+
+Optional<size_t> SharedRing::read(Bytes bytes)
+{
+    auto& header = this->header();
+    u32 read_position = header.read_position.load(AK::memory_order_relaxed);
+    u32 available = header.write_position.load(AK::memory_order_acquire) - read_position;
+    if (available > m_capacity)
+        return {};
+
+    size_t count = min(bytes.size(), (size_t)available);
+    size_t offset = read_position & (m_capacity - 1);
+    size_t first_chunk = min(count, m_capacity - offset);
+    memcpy(bytes.data(), data() + offset, first_chunk);
+    memcpy(bytes.data() + first_chunk, data(), count - first_chunk);
+
+    header.read_position.store(read_position + count);
+    if (count != 0 && header.producer_state.load() == Waiting && header.producer_state.exchange(Busy) == Waiting)
+        futex_wake(header.producer_state);
+    return count;
+}
+
+void SharedRing::wait_for_data(int timeout_ms)
+{
+    auto& header = this->header();
+    header.consumer_state.store(Waiting);
+    if (is_empty() && !is_closed())
+        futex_wait(header.consumer_state, Waiting, timeout_ms);
+    header.consumer_state.store(Busy);
+}
+
+bool SharedRing::prepare_for_idle()
+{
+    auto& header = this->header();
+    header.consumer_state.store(Idle);
+    if (is_empty())
+        return true;
+    header.consumer_state.store(Busy);
+    return false;
+}
+
+void SharedRing::close()
+{
+    auto& header = this->header();
+    header.closed.store(true);
+    header.producer_state.store(Busy);
+    header.consumer_state.store(Busy);
+    futex_wake(header.producer_state);
+    futex_wake(header.consumer_state);
+}
+
+}
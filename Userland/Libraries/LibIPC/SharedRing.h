@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/Noncopyable.h>
+#include <AK/Optional.h>
+#include <AK/OwnPtr.h>
+#include <AK/Span.h>
+#include <AK/Types.h>
+#include <LibCore/AnonymousBuffer.h>
+
+namespace IPC {
+
+// A single-producer, single-consumer byte ring living in shared memory.
+// The positions are free-running 32-bit counters, so the capacity must be a power of two.
+// Neither side trusts the other: a peer that scribbles over the positions makes
+// read() and write() fail instead of making us touch memory outside the ring.
+class SharedRing {
+    AK_MAKE_NONCOPYABLE(SharedRing);
+    AK_MAKE_NONMOVABLE(SharedRing);
+
+public:
+    static constexpr size_t default_capacity = 256 * KiB;
+
+    static OwnPtr<SharedRing> try_create(size_t capacity = default_capacity);
+    static OwnPtr<SharedRing> try_attach(Core::AnonymousBuffer);
+
+    const Core::AnonymousBuffer& anonymous_buffer() const { return m_buffer; }
+    size_t capacity() const { return m_capacity; }
+
+    bool is_empty() const;
+    bool is_closed() const;
+
+    // Producer side. Returns how many bytes were written, or an empty Optional if the ring is corrupted.
+    Optional<size_t> write(ReadonlyBytes);
+    // Sleeps until the consumer has made room or the timeout expires.
+    void wait_for_space(int timeout_ms);
+    // Call after writing. Wakes a consumer blocked in wait_for_data(), and returns true
+    // if the consumer went idle in its event loop and needs to be poked through the socket.
+    [[nodiscard]] bool wake_consumer();
+
+    // Consumer side. Returns how many bytes were read, or an empty Optional if the ring is corrupted.
+    Optional<size_t> read(Bytes);
+    // Sleeps until the producer has written something or the timeout expires.
+    void wait_for_data(int timeout_ms);
+    // Announces that the consumer is going back to its event loop. Returns false if
+    // data arrived in the meantime, in which case the caller should keep reading.
+    [[nodiscard]] bool prepare_for_idle();
+
+    // Either side can close the ring, which wakes up everyone waiting on it.
+    void close();
+
+private:
+    enum State : u32 {
+        Busy = 0,
+        Idle = 1,
+        Waiting = 2,
+    };
+
+    struct Header;
+
+    SharedRing(Core::AnonymousBuffer, size_t capacity);
+
+    Header& header();
+    const Header& header() const;
+    u8* data();
+
+    Core::AnonymousBuffer m_buffer;
+    size_t m_capacity { 0 };
+};
+
+}
@@ -37,7 +37,9 @@
 #include <LibCore/FileStream.h>
 #include <LibCore/MimeData.h>
 #include <LibHTTP/HttpRequest.h>
+#include <errno.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -127,12 +129,10 @@ void Client::handle_request(ReadonlyBytes raw_request)
         return;
     }
 
-    Core::InputFileStream stream { file };
-
-    send_response(stream, request, Core::guess_mime_type_based_on_filename(real_path));
+    send_file_response(file, request, Core::guess_mime_type_based_on_filename(real_path));
 }
 
-void Client::send_response(InputStream& response, const HTTP::HttpRequest& request, const String& content_type)
+void Client::send_response_header(const HTTP::HttpRequest& request, const String& content_type)
 {
     StringBuilder builder;
     builder.append("HTTP/1.0 200 OK\r\n");
@@ -146,7 +146,42 @@ void Client::send_response(InputStream& response, const HTTP::HttpRequest& reque
 
     m_socket->write(builder.to_string());
     log_response(200, request);
+}
+
+void Client::send_file_response(Core::File& file, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(request, content_type);
+
+    // Let the kernel move the file's cached pages straight into the socket,
+    // instead of copying every byte through our buffer and back.
+    for (;;) {
+        auto nsent = sendfile(m_socket->fd(), file.fd(), nullptr, 64 * KiB);
+        if (nsent > 0)
+            continue;
+        if (nsent == 0)
+            return;
+        if (errno == EINTR)
+            continue;
+        if (errno != EINVAL) {
+            perror("sendfile");
+            return;
+        }
+        // The file can't be sent directly, so fall back to copying it.
+        break;
+    }
 
+    Core::InputFileStream stream { file };
+    send_response_body(stream);
+}
+
+void Client::send_response(InputStream& response, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(request, content_type);
+    send_response_body(response);
+}
+
+void Client::send_response_body(InputStream& response)
+{
     char buffer[PAGE_SIZE];
     do {
         auto size = response.read({ buffer, sizeof(buffer) });
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+static int wait_for_events(int epoll_fd, epoll_event& event)
+{
+    return epoll_wait(epoll_fd, &event, 1, 0);
+}
+
+static bool expect_event_count(const char* what, int epoll_fd, int expected_count, u64 expected_data = 0)
+{
+    epoll_event event {};
+    int count = wait_for_events(epoll_fd, event);
+    if (count != expected_count) {
+        printf("FAIL: %s: got %d events, expected %d\n", what, count, expected_count);
+        return false;
+    }
+    if (count > 0 && (event.data.u64 != expected_data || !(event.events & EPOLLIN))) {
+        printf("FAIL: %s: unexpected event %#x with data %llu\n", what, event.events, (unsigned long long)event.data.u64);
+        return false;
+    }
+    return true;
+}
+
+static bool test_mode(const char* name, u32 mode_flags, int expected_count_after_first_wait)
+{
+    int pipefds[2];
+    if (pipe(pipefds) < 0) {
+        perror("pipe");
+        return false;
+    }
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return false;
+    }
+
+    epoll_event event {};
+    event.events = EPOLLIN | mode_flags;
+    event.data.u64 = 1234;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pipefds[0], &event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+
+    printf("Testing %s...\n", name);
+    if (!expect_event_count("empty pipe", epoll_fd, 0))
+        return false;
+
+    write(pipefds[1], "x", 1);
+    if (!expect_event_count("after write", epoll_fd, 1, 1234))
+        return false;
+    // Level-triggered keeps reporting the unread data, edge-triggered and one-shot don't.
+    if (!expect_event_count("without reading", epoll_fd, expected_count_after_first_wait, 1234))
+        return false;
+
+    if (!(mode_flags & EPOLLONESHOT)) {
+        // A new edge is reported again in both modes.
+        write(pipefds[1], "y", 1);
+        if (!expect_event_count("after second write", epoll_fd, 1, 1234))
+            return false;
+    }
+
+    char buffer[2];
+    read(pipefds[0], buffer, sizeof(buffer));
+    if (!expect_event_count("after draining", epoll_fd, 0))
+        return false;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, pipefds[0], nullptr) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    write(pipefds[1], "z", 1);
+    if (!expect_event_count("after removal", epoll_fd, 0))
+        return false;
+
+    close(epoll_fd);
+    close(pipefds[0]);
+    close(pipefds[1]);
+    return true;
+}
+
+int main(int, char**)
+{
+    if (!test_mode("level-triggered", 0, 1))
+        return 1;
+    if (!test_mode("edge-triggered", EPOLLET, 0))
+        return 1;
+    if (!test_mode("one-shot", EPOLLONESHOT, 0))
+        return 1;
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// Times random reads all over a big anonymous mapping, once backed by small
+// pages and once with MADV_HUGEPAGE, to show what large pages do for the TLB.
+
+static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+static constexpr size_t mapping_size = 64 * 1024 * 1024;
+static constexpr size_t access_count = 16 * 1024 * 1024;
+
+// Keeps the compiler from dropping the reads.
+static volatile uint32_t s_sink;
+
+static double seconds_since(const timespec& start)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static uint8_t* map_aligned(size_t size)
+{
+#ifdef __serenity__
+    void* ptr = serenity_mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0, huge_page_size, "huge-page-tlb-benchmark");
+    if (ptr == MAP_FAILED)
+        return nullptr;
+    return (uint8_t*)ptr;
+#else
+    // Over-allocate and leak the slack, this is a benchmark.
+    void* ptr = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ptr == MAP_FAILED)
+        return nullptr;
+    return (uint8_t*)(((uintptr_t)ptr + huge_page_size - 1) & ~(uintptr_t)(huge_page_size - 1));
+#endif
+}
+
+static bool run(bool use_huge_pages, double& populate_seconds, double& access_seconds)
+{
+    auto* data = map_aligned(mapping_size);
+    if (!data) {
+        perror("mmap");
+        return false;
+    }
+    if (use_huge_pages && madvise(data, mapping_size, MADV_HUGEPAGE) < 0) {
+        perror("madvise");
+        return false;
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t offset = 0; offset < mapping_size; offset += 4096)
+        data[offset] = (uint8_t)offset;
+    populate_seconds = seconds_since(start);
+
+    // Touch a different page on nearly every access so the TLB can't keep up.
+    auto* words = (const uint32_t*)data;
+    size_t word_count = mapping_size / sizeof(uint32_t);
+    uint32_t state = 2463534242u;
+    uint32_t sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < access_count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        sum += words[state % word_count];
+    }
+    access_seconds = seconds_since(start);
+
+    s_sink = sum;
+    munmap(data, mapping_size);
+    return true;
+}
+
+int main()
+{
+    double small_populate_seconds = 0;
+    double small_access_seconds = 0;
+    double huge_populate_seconds = 0;
+    double huge_access_seconds = 0;
+    if (!run(false, small_populate_seconds, small_access_seconds) || !run(true, huge_populate_seconds, huge_access_seconds)) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    printf("small pages: populated %zu MiB in %.3f s, %zu random reads in %.3f s (%.1f ns each)\n",
+        mapping_size / (1024 * 1024), small_populate_seconds, access_count, small_access_seconds, small_access_seconds * 1e9 / access_count);
+    printf("large pages: populated %zu MiB in %.3f s, %zu random reads in %.3f s (%.1f ns each)\n",
+        mapping_size / (1024 * 1024), huge_populate_seconds, access_count, huge_access_seconds, huge_access_seconds * 1e9 / access_count);
+    printf("PASS: random reads were %.2fx as fast with large pages\n", small_access_seconds / huge_access_seconds);
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures the round-trip latency of small messages and the bulk throughput of
+// a local socket connection, the two things IPC-heavy services care about.
+
+static constexpr int round_trips = 20000;
+static constexpr size_t message_size = 64;
+static constexpr size_t bulk_size = 64 * 1024 * 1024;
+static constexpr size_t chunk_size = 64 * 1024;
+static constexpr int socket_buffer_size = 1024 * 1024;
+// What the kernel gives anyone who isn't the superuser at most.
+static constexpr int unprivileged_socket_buffer_size = 256 * 1024;
+
+static int expected_socket_buffer_size()
+{
+    return getuid() == 0 ? socket_buffer_size : unprivileged_socket_buffer_size;
+}
+
+static bool check_socket_buffer_size(int fd, int option, const char* name)
+{
+    int actual_size = 0;
+    socklen_t actual_size_length = sizeof(actual_size);
+    if (getsockopt(fd, SOL_SOCKET, option, &actual_size, &actual_size_length) < 0) {
+        perror("getsockopt");
+        return false;
+    }
+    if (actual_size != expected_socket_buffer_size()) {
+        printf("FAIL: %s is %d, expected %d\n", name, actual_size, expected_socket_buffer_size());
+        return false;
+    }
+    return true;
+}
+
+static double seconds_since(const timespec& start)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static bool read_exactly(int fd, void* buffer, size_t size)
+{
+    size_t nread = 0;
+    while (nread < size) {
+        ssize_t rc = read(fd, (char*)buffer + nread, size - nread);
+        if (rc <= 0)
+            return false;
+        nread += rc;
+    }
+    return true;
+}
+
+static bool write_exactly(int fd, const void* buffer, size_t size)
+{
+    size_t nwritten = 0;
+    while (nwritten < size) {
+        ssize_t rc = write(fd, (const char*)buffer + nwritten, size - nwritten);
+        if (rc <= 0)
+            return false;
+        nwritten += rc;
+    }
+    return true;
+}
+
+static void run_server(int listen_fd)
+{
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+        perror("accept");
+        exit(1);
+    }
+    // This was set on the listening socket before listen().
+    if (!check_socket_buffer_size(fd, SO_RCVBUF, "SO_RCVBUF"))
+        exit(1);
+
+    char message[message_size];
+    for (int i = 0; i < round_trips; ++i) {
+        if (!read_exactly(fd, message, sizeof(message)) || !write_exactly(fd, message, sizeof(message)))
+            exit(1);
+    }
+
+    static char buffer[chunk_size];
+    size_t received = 0;
+    for (;;) {
+        ssize_t nread = read(fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            exit(1);
+        }
+        if (nread == 0)
+            break;
+        received += nread;
+    }
+    close(fd);
+    exit(received == bulk_size ? 0 : 1);
+}
+
+int main()
+{
+    int listen_fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_un address {};
+    address.sun_family = AF_LOCAL;
+    snprintf(address.sun_path, sizeof(address.sun_path), "/tmp/local-socket-ipc-benchmark.%d", getpid());
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    int size = socket_buffer_size;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+        perror("setsockopt");
+        return 1;
+    }
+    if (listen(listen_fd, 1) < 0) {
+        perror("listen");
+        return 1;
+    }
+
+    pid_t server = fork();
+    if (server < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (server == 0)
+        run_server(listen_fd);
+    close(listen_fd);
+
+    int fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0) {
+        perror("setsockopt");
+        return 1;
+    }
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        return 1;
+    }
+    unlink(address.sun_path);
+
+    if (!check_socket_buffer_size(fd, SO_SNDBUF, "SO_SNDBUF"))
+        return 1;
+
+    char message[message_size];
+    memset(message, 'x', sizeof(message));
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < round_trips; ++i) {
+        if (!write_exactly(fd, message, sizeof(message)) || !read_exactly(fd, message, sizeof(message))) {
+            printf("FAIL: round trip %d failed\n", i);
+            return 1;
+        }
+    }
+    double round_trip_seconds = seconds_since(start);
+
+    static char buffer[chunk_size];
+    memset(buffer, 'y', sizeof(buffer));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t offset = 0; offset < bulk_size; offset += chunk_size) {
+        if (!write_exactly(fd, buffer, chunk_size)) {
+            printf("FAIL: bulk write failed at offset %zu\n", offset);
+            return 1;
+        }
+    }
+    close(fd);
+
+    int status = 0;
+    waitpid(server, &status, 0);
+    double bulk_seconds = seconds_since(start);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL: server did not receive everything\n");
+        return 1;
+    }
+
+    printf("PASS: %d round trips of %zu bytes in %.3f s (%.1f us each)\n", round_trips, message_size, round_trip_seconds, round_trip_seconds * 1e6 / round_trips);
+    printf("PASS: %zu MiB in %.3f s (%.1f MiB/s)\n", bulk_size / (1024 * 1024), bulk_seconds, (bulk_size / (1024.0 * 1024.0)) / bulk_seconds);
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Hands a buffer much larger than the TCP send buffer to a single blocking
+// send() while the receiver isn't reading yet. The send() has to wait for
+// the receiver to make room instead of failing with EAGAIN, and it has to
+// report the whole buffer as sent.
+
+static constexpr size_t total_size = 8 * 1024 * 1024;
+static constexpr size_t chunk_size = 64 * 1024;
+
+static unsigned char pattern_byte(size_t offset)
+{
+    return (unsigned char)((offset * 13) ^ (offset >> 9));
+}
+
+static void run_sender(in_port_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = port;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+
+    auto* buffer = (unsigned char*)malloc(total_size);
+    if (!buffer) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < total_size; ++i)
+        buffer[i] = pattern_byte(i);
+
+    ssize_t nsent = send(fd, buffer, total_size, 0);
+    if (nsent < 0) {
+        perror("send");
+        exit(1);
+    }
+    if ((size_t)nsent != total_size) {
+        printf("FAIL: send() returned %zd instead of %zu\n", nsent, total_size);
+        exit(1);
+    }
+    close(fd);
+    exit(0);
+}
+
+int main()
+{
+    // A send() that never wakes up again should fail the test rather than hang it.
+    alarm(60);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    if (listen(listen_fd, 1) < 0) {
+        perror("listen");
+        return 1;
+    }
+    socklen_t address_size = sizeof(address);
+    if (getsockname(listen_fd, (sockaddr*)&address, &address_size) < 0) {
+        perror("getsockname");
+        return 1;
+    }
+
+    pid_t sender = fork();
+    if (sender < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (sender == 0) {
+        close(listen_fd);
+        run_sender(address.sin_port);
+    }
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+        perror("accept");
+        return 1;
+    }
+
+    // Let the sender fill up both the send buffer and our receive window first.
+    sleep(1);
+
+    static unsigned char buffer[chunk_size];
+    size_t received = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t nread = read(fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            ok = false;
+            break;
+        }
+        if (nread == 0)
+            break;
+        for (ssize_t i = 0; i < nread && ok; ++i) {
+            if (buffer[i] != pattern_byte(received + i)) {
+                printf("FAIL: mismatch at offset %zu\n", received + i);
+                ok = false;
+            }
+        }
+        if (!ok)
+            break;
+        received += nread;
+    }
+
+    close(fd);
+    close(listen_fd);
+    int status = 0;
+    waitpid(sender, &status, 0);
+
+    if (!ok)
+        return 1;
+    if (received != total_size || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL: received %zu of %zu bytes\n", received, total_size);
+        return 1;
+    }
+
+    printf("PASS: a single blocking send() of %zu MiB went through\n", total_size / (1024 * 1024));
+    return 0;
+}
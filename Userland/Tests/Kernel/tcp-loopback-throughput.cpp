@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Pushes a known byte pattern through a TCP connection over the loopback
+// adapter, checks that it arrives intact and in order, and reports the
+// throughput so that regressions in the TCP send path are easy to spot.
+
+static constexpr size_t total_size = 64 * 1024 * 1024;
+static constexpr size_t chunk_size = 64 * 1024;
+
+static unsigned char pattern_byte(size_t offset)
+{
+    return (unsigned char)((offset * 7) ^ (offset >> 11));
+}
+
+static void run_sender(in_port_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = port;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+
+    static unsigned char buffer[chunk_size];
+    for (size_t offset = 0; offset < total_size;) {
+        size_t length = chunk_size;
+        for (size_t i = 0; i < length; ++i)
+            buffer[i] = pattern_byte(offset + i);
+        size_t nwritten = 0;
+        while (nwritten < length) {
+            ssize_t rc = write(fd, buffer + nwritten, length - nwritten);
+            if (rc < 0) {
+                perror("write");
+                exit(1);
+            }
+            nwritten += rc;
+        }
+        offset += length;
+    }
+    close(fd);
+    exit(0);
+}
+
+int main()
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    if (listen(listen_fd, 1) < 0) {
+        perror("listen");
+        return 1;
+    }
+    socklen_t address_size = sizeof(address);
+    if (getsockname(listen_fd, (sockaddr*)&address, &address_size) < 0) {
+        perror("getsockname");
+        return 1;
+    }
+
+    pid_t sender = fork();
+    if (sender < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (sender == 0) {
+        close(listen_fd);
+        run_sender(address.sin_port);
+    }
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+        perror("accept");
+        return 1;
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    static unsigned char buffer[chunk_size];
+    size_t received = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t nread = read(fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            ok = false;
+            break;
+        }
+        if (nread == 0)
+            break;
+        for (ssize_t i = 0; i < nread && ok; ++i) {
+            if (buffer[i] != pattern_byte(received + i)) {
+                printf("FAIL: mismatch at offset %zu\n", received + i);
+                ok = false;
+            }
+        }
+        if (!ok)
+            break;
+        received += nread;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    close(fd);
+    close(listen_fd);
+    int status = 0;
+    waitpid(sender, &status, 0);
+
+    if (!ok)
+        return 1;
+    if (received != total_size || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL: received %zu of %zu bytes\n", received, total_size);
+        return 1;
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("PASS: %zu MiB over loopback in %.3f s (%.1f MiB/s)\n", total_size / (1024 * 1024), seconds, (total_size / (1024.0 * 1024.0)) / seconds);
+    return 0;
+}
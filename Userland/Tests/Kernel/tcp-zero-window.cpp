@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <LibCore/File.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Lets a TCP receiver sit on a full receive buffer until its window is
+// closed, checks that the sender keeps probing the zero window instead of
+// going quiet, and then drains the connection and checks the data.
+
+static constexpr size_t total_size = 4 * 1024 * 1024;
+static constexpr size_t chunk_size = 64 * 1024;
+
+static unsigned char pattern_byte(size_t offset)
+{
+    return (unsigned char)((offset * 11) ^ (offset >> 10));
+}
+
+static void run_sender(in_port_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = port;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+
+    static unsigned char buffer[chunk_size];
+    for (size_t offset = 0; offset < total_size; offset += chunk_size) {
+        for (size_t i = 0; i < chunk_size; ++i)
+            buffer[i] = pattern_byte(offset + i);
+        size_t nwritten = 0;
+        while (nwritten < chunk_size) {
+            ssize_t rc = write(fd, buffer + nwritten, chunk_size - nwritten);
+            if (rc < 0) {
+                perror("write");
+                exit(1);
+            }
+            nwritten += rc;
+        }
+    }
+    close(fd);
+    exit(0);
+}
+
+static Optional<u32> window_probes_sent_from(in_port_t local_port)
+{
+    auto file = Core::File::construct("/proc/net/tcp");
+    if (!file->open(Core::IODevice::ReadOnly)) {
+        fprintf(stderr, "Error: %s\n", file->error_string());
+        return {};
+    }
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_array())
+        return {};
+    Optional<u32> window_probes;
+    json.value().as_array().for_each([&](auto& value) {
+        auto& socket_object = value.as_object();
+        if (socket_object.get("local_port").to_u32() == ntohs(local_port))
+            window_probes = socket_object.get("window_probes").to_u32();
+    });
+    return window_probes;
+}
+
+int main()
+{
+    // A connection that stalls for good should fail the test rather than hang it.
+    alarm(60);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    if (listen(listen_fd, 1) < 0) {
+        perror("listen");
+        return 1;
+    }
+    socklen_t address_size = sizeof(address);
+    if (getsockname(listen_fd, (sockaddr*)&address, &address_size) < 0) {
+        perror("getsockname");
+        return 1;
+    }
+
+    pid_t sender = fork();
+    if (sender < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (sender == 0) {
+        close(listen_fd);
+        run_sender(address.sin_port);
+    }
+
+    sockaddr_in sender_address {};
+    socklen_t sender_address_size = sizeof(sender_address);
+    int fd = accept(listen_fd, (sockaddr*)&sender_address, &sender_address_size);
+    if (fd < 0) {
+        perror("accept");
+        return 1;
+    }
+
+    // Don't read anything for a while, so that our window closes and stays closed
+    // for several of the sender's probe intervals.
+    sleep(3);
+
+    auto window_probes = window_probes_sent_from(sender_address.sin_port);
+    if (!window_probes.has_value()) {
+        printf("FAIL: couldn't find the sending socket in /proc/net/tcp\n");
+        return 1;
+    }
+    if (window_probes.value() == 0) {
+        printf("FAIL: the sender didn't probe our zero window\n");
+        return 1;
+    }
+
+    static unsigned char buffer[chunk_size];
+    size_t received = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t nread = read(fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            ok = false;
+            break;
+        }
+        if (nread == 0)
+            break;
+        for (ssize_t i = 0; i < nread && ok; ++i) {
+            if (buffer[i] != pattern_byte(received + i)) {
+                printf("FAIL: mismatch at offset %zu\n", received + i);
+                ok = false;
+            }
+        }
+        if (!ok)
+            break;
+        received += nread;
+    }
+
+    close(fd);
+    close(listen_fd);
+    int status = 0;
+    waitpid(sender, &status, 0);
+
+    if (!ok)
+        return 1;
+    if (received != total_size || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL: received %zu of %zu bytes\n", received, total_size);
+        return 1;
+    }
+
+    printf("PASS: drained %zu MiB after %u window probes\n", total_size / (1024 * 1024), window_probes.value());
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Vector.h>
+#include <LibCore/ElapsedTimer.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t NUM_ITERATIONS = 200000;
+const size_t WORKING_SET_SIZE = 64;
+const size_t allocation_sizes[] = { 8, 16, 24, 48, 64, 100, 128, 200, 256, 500, 1000, 2000 };
+
+struct ThreadData {
+    pthread_t thread;
+    u32 seed;
+    bool failed;
+
+    u32 next_random()
+    {
+        // xorshift32, rand() isn't thread safe and we don't want to benchmark a lock
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+};
+
+static void* run_thread(void* arg)
+{
+    auto& data = *static_cast<ThreadData*>(arg);
+    struct Allocation {
+        unsigned char* ptr;
+        size_t size;
+        unsigned char pattern;
+    };
+    Allocation working_set[WORKING_SET_SIZE] {};
+
+    for (size_t i = 0; i < NUM_ITERATIONS; ++i) {
+        auto& slot = working_set[data.next_random() % WORKING_SET_SIZE];
+        if (slot.ptr) {
+            // Make sure nobody else scribbled over our memory while we had it
+            for (size_t j = 0; j < slot.size; ++j) {
+                if (slot.ptr[j] != slot.pattern) {
+                    data.failed = true;
+                    return nullptr;
+                }
+            }
+            free(slot.ptr);
+        }
+        slot.size = allocation_sizes[data.next_random() % (sizeof(allocation_sizes) / sizeof(allocation_sizes[0]))];
+        slot.pattern = (unsigned char)i;
+        slot.ptr = static_cast<unsigned char*>(malloc(slot.size));
+        memset(slot.ptr, slot.pattern, slot.size);
+    }
+
+    for (auto& slot : working_set)
+        free(slot.ptr);
+    return nullptr;
+}
+
+static bool run_benchmark(size_t thread_count)
+{
+    Vector<ThreadData> threads;
+    threads.resize(thread_count);
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads[i].seed = i + 1;
+        threads[i].failed = false;
+        if (pthread_create(&threads[i].thread, nullptr, run_thread, &threads[i]) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+    }
+
+    bool failed = false;
+    for (auto& thread : threads) {
+        pthread_join(thread.thread, nullptr);
+        failed |= thread.failed;
+    }
+    auto elapsed = max(timer.elapsed(), 1);
+
+    if (failed) {
+        printf("\x1b[01;35mTests failed: memory corruption with %zu threads\n", thread_count);
+        return false;
+    }
+
+    // Every iteration does one malloc() and (except for the first few) one free()
+    auto operations = thread_count * NUM_ITERATIONS * 2;
+    printf("threads=%zu time=%dms ops_per_second=%llu\n", thread_count, elapsed, (unsigned long long)operations * 1000 / elapsed);
+    return true;
+}
+
+int main()
+{
+    for (size_t thread_count : { 1, 2, 4, 8 }) {
+        if (!run_benchmark(thread_count))
+            return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
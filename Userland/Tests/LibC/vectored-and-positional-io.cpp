@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static void test_pwrite_and_pread_leave_the_offset_alone(int fd)
+{
+    assert(pwrite(fd, "hello friends", 13, 0) == 13);
+    assert(lseek(fd, 0, SEEK_CUR) == 0);
+
+    char buffer[8] {};
+    assert(pread(fd, buffer, 7, 6) == 7);
+    assert(!memcmp(buffer, "friends", 7));
+    assert(lseek(fd, 0, SEEK_CUR) == 0);
+}
+
+static void test_vectored_io(int fd)
+{
+    char header[] = "HDR:";
+    char payload[] = "payload";
+    iovec write_vecs[] = {
+        { header, 4 },
+        { payload, 7 },
+    };
+    assert(pwritev(fd, write_vecs, 2, 100) == 11);
+
+    char read_header[4] {};
+    char read_payload[7] {};
+    iovec read_vecs[] = {
+        { read_header, sizeof(read_header) },
+        { read_payload, sizeof(read_payload) },
+    };
+    assert(preadv(fd, read_vecs, 2, 100) == 11);
+    assert(!memcmp(read_header, "HDR:", 4));
+    assert(!memcmp(read_payload, "payload", 7));
+
+    // A short read at the end of the file stops filling the vectors.
+    memset(read_payload, 0, sizeof(read_payload));
+    assert(preadv(fd, read_vecs, 2, 105) == 6);
+    assert(!memcmp(read_header, "aylo", 4));
+    assert(!memcmp(read_payload, "ad", 2));
+
+    assert(lseek(fd, 100, SEEK_SET) == 100);
+    assert(readv(fd, read_vecs, 2) == 11);
+    assert(lseek(fd, 0, SEEK_CUR) == 111);
+}
+
+static void test_positional_io_on_a_pipe_fails()
+{
+    int pipefds[2];
+    assert(pipe(pipefds) == 0);
+    char buffer[1];
+    assert(pread(pipefds[0], buffer, 1, 0) < 0);
+    assert(pwrite(pipefds[1], "x", 1, 0) < 0);
+    close(pipefds[0]);
+    close(pipefds[1]);
+}
+
+int main()
+{
+    char path[] = "/tmp/vectored-io.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+
+    test_pwrite_and_pread_leave_the_offset_alone(fd);
+    test_vectored_io(fd);
+    test_positional_io_on_a_pipe_fails();
+
+    close(fd);
+    printf("PASS\n");
+    return 0;
+}
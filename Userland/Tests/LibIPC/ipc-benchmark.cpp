@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Function.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/EventLoop.h>
+#include <LibCore/LocalServer.h>
+#include <LibIPC/ClientConnection.h>
+#include <LibIPC/ServerConnection.h>
+#include <Tests/LibIPC/BenchmarkClientEndpoint.h>
+#include <Tests/LibIPC/BenchmarkServerEndpoint.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Measures how fast LibIPC moves messages between two processes:
+// synchronous round trips, pipelined requests, coalesced one-way messages
+// and requests answered through callbacks.
+
+class BenchmarkClientConnection final
+    : public IPC::ClientConnection<BenchmarkClientEndpoint, BenchmarkServerEndpoint>
+    , public BenchmarkServerEndpoint {
+    C_OBJECT(BenchmarkClientConnection);
+
+public:
+    virtual void die() override { Core::EventLoop::current().quit(0); }
+
+private:
+    BenchmarkClientConnection(NonnullRefPtr<Core::LocalSocket> socket, int client_id)
+        : IPC::ClientConnection<BenchmarkClientEndpoint, BenchmarkServerEndpoint>(*this, move(socket), client_id)
+    {
+        set_accepts_shared_memory_transport(true);
+    }
+
+    virtual OwnPtr<Messages::BenchmarkServer::EchoResponse> handle(const Messages::BenchmarkServer::Echo& message) override
+    {
+        return make<Messages::BenchmarkServer::EchoResponse>(message.value());
+    }
+
+    virtual void handle(const Messages::BenchmarkServer::Notify&) override
+    {
+        ++m_notification_count;
+    }
+
+    virtual void handle(const Messages::BenchmarkServer::CountNotifications&) override
+    {
+        post_message(Messages::BenchmarkClient::DidCountNotifications(m_notification_count));
+        m_notification_count = 0;
+    }
+
+    i32 m_notification_count { 0 };
+};
+
+class BenchmarkServerConnection final
+    : public IPC::ServerConnection<BenchmarkClientEndpoint, BenchmarkServerEndpoint>
+    , public BenchmarkClientEndpoint {
+    C_OBJECT(BenchmarkServerConnection);
+
+public:
+    virtual void handshake() override { }
+
+private:
+    explicit BenchmarkServerConnection(const String& address)
+        : IPC::ServerConnection<BenchmarkClientEndpoint, BenchmarkServerEndpoint>(*this, address)
+    {
+    }
+
+    virtual void handle(const Messages::BenchmarkClient::DidCountNotifications&) override { }
+};
+
+static int run_server(const String& address)
+{
+    Core::EventLoop event_loop;
+    auto server = Core::LocalServer::construct();
+    if (!server->listen(address))
+        return 1;
+    RefPtr<BenchmarkClientConnection> client;
+    server->on_ready_to_accept = [&] {
+        auto client_socket = server->accept();
+        if (!client_socket)
+            return;
+        client = BenchmarkClientConnection::construct(client_socket.release_nonnull(), 1);
+    };
+    return event_loop.exec();
+}
+
+static void report(const char* name, int count, Core::ElapsedTimer& timer)
+{
+    auto elapsed = max(timer.elapsed(), 1);
+    printf("%-12s count=%d time=%dms per_second=%llu\n", name, count, elapsed, (unsigned long long)count * 1000 / elapsed);
+}
+
+static bool run_benchmarks(BenchmarkServerConnection& connection, int count, int window)
+{
+    Core::ElapsedTimer timer;
+
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        if (connection.send_sync<Messages::BenchmarkServer::Echo>(i)->value() != i)
+            return false;
+    }
+    report("sync", count, timer);
+
+    timer.start();
+    Vector<u32> request_ids;
+    for (int i = 0; i < count; i += window) {
+        int batch = min(window, count - i);
+        for (int j = 0; j < batch; ++j)
+            request_ids.append(connection.post_request<Messages::BenchmarkServer::Echo>(i + j));
+        for (int j = 0; j < batch; ++j) {
+            auto response = connection.wait_for_response<Messages::BenchmarkServer::EchoResponse>(request_ids[j]);
+            if (!response || response->value() != i + j)
+                return false;
+        }
+        request_ids.clear_with_capacity();
+    }
+    report("pipelined", count, timer);
+
+    timer.start();
+    for (int i = 0; i < count; ++i)
+        connection.post_message(Messages::BenchmarkServer::Notify(i));
+    connection.post_message(Messages::BenchmarkServer::CountNotifications());
+    auto notifications = connection.wait_for_specific_message<Messages::BenchmarkClient::DidCountNotifications>();
+    if (!notifications || notifications->count() != count)
+        return false;
+    report("async", count, timer);
+
+    timer.start();
+    Core::EventLoop callback_loop;
+    int requests = 0;
+    int responses = 0;
+    bool responses_match = true;
+    // Keep a window of requests in flight, since nothing reads the responses until the loop runs.
+    Function<void()> send_next_request = [&] {
+        int i = requests++;
+        connection.async_request<Messages::BenchmarkServer::Echo>([&, i](auto& response) {
+            responses_match &= response.value() == i;
+            if (++responses == count)
+                callback_loop.quit(0);
+            else if (requests < count)
+                send_next_request();
+        },
+            i);
+    };
+    for (int i = 0; i < min(window, count); ++i)
+        send_next_request();
+    callback_loop.exec();
+    if (responses != count || !responses_match)
+        return false;
+    report("callback", count, timer);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int count = 20000;
+    int window = 32;
+    bool use_shared_memory = false;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(count, "Number of messages per benchmark", "count", 'n', "count");
+    args_parser.add_option(window, "Number of pipelined requests in flight", "window", 'w', "window");
+    args_parser.add_option(use_shared_memory, "Use the shared memory ring transport", "shared-memory", 's');
+    args_parser.parse(argc, argv);
+
+    if (count <= 0 || window <= 0) {
+        warnln("Count and window must be positive");
+        return 1;
+    }
+
+    auto address = String::formatted("/tmp/ipc-benchmark.{}", getpid());
+    pid_t server_pid = fork();
+    if (server_pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (server_pid == 0)
+        return run_server(address);
+
+    while (access(address.characters(), F_OK) < 0)
+        usleep(1000);
+
+    bool success = false;
+    {
+        Core::EventLoop event_loop;
+        auto connection = BenchmarkServerConnection::construct(address);
+        if (use_shared_memory && !connection->enable_shared_memory_transport())
+            warnln("The shared memory transport isn't available, using the socket");
+        // Outgoing messages are only coalesced while an event loop is running.
+        connection->deferred_invoke([&](auto&) {
+            success = run_benchmarks(connection, count, window);
+            event_loop.quit(0);
+        });
+        event_loop.exec();
+    }
+    unlink(address.characters());
+
+    int status = 0;
+    waitpid(server_pid, &status, 0);
+
+    if (!success) {
+        printf("\x1b[01;35mTests failed: a response didn't match its request\n");
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Vector.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibIPC/SharedRing.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Pushes a patterned stream through a small IPC::SharedRing between two processes,
+// so the positions wrap many times and both sides end up sleeping on the futex.
+// Then checks that closing the ring wakes a consumer that is waiting for data.
+
+static constexpr size_t ring_capacity = 4096;
+static constexpr size_t total_bytes = 4 * MiB;
+// Long enough that a missed futex wakeup shows up as a slow wait instead of a lucky timeout.
+static constexpr int wait_timeout_ms = 5000;
+
+static u8 pattern_byte(size_t offset)
+{
+    return (offset * 7 + 3) & 0xff;
+}
+
+// Odd chunk sizes keep the reads and writes from lining up with the end of the ring.
+static size_t chunk_size(size_t iteration)
+{
+    return 1 + (iteration * 331) % 1531;
+}
+
+static bool timed_out(Core::ElapsedTimer& timer)
+{
+    return timer.elapsed() >= wait_timeout_ms;
+}
+
+static int run_consumer(Core::AnonymousBuffer buffer)
+{
+    auto ring = IPC::SharedRing::try_attach(move(buffer));
+    if (!ring) {
+        warnln("Consumer: Couldn't attach to the ring");
+        return 1;
+    }
+
+    Vector<u8> chunk;
+    chunk.resize(1531);
+    size_t offset = 0;
+    for (size_t iteration = 0; offset < total_bytes; ++iteration) {
+        auto count = ring->read(chunk.span().trim(chunk_size(iteration)));
+        if (!count.has_value()) {
+            warnln("Consumer: The ring is corrupted at offset {}", offset);
+            return 1;
+        }
+        for (size_t i = 0; i < count.value(); ++i) {
+            if (chunk[i] != pattern_byte(offset + i)) {
+                warnln("Consumer: Mismatch at offset {}", offset + i);
+                return 1;
+            }
+        }
+        offset += count.value();
+        if (count.value() == 0) {
+            Core::ElapsedTimer timer;
+            timer.start();
+            ring->wait_for_data(wait_timeout_ms);
+            if (timed_out(timer)) {
+                warnln("Consumer: Missed a wakeup at offset {}", offset);
+                return 1;
+            }
+        }
+    }
+
+    // Nothing else is coming, so only close() can end this wait early.
+    Core::ElapsedTimer timer;
+    timer.start();
+    while (!ring->is_closed() && !timed_out(timer))
+        ring->wait_for_data(wait_timeout_ms);
+    if (!ring->is_closed() || timed_out(timer)) {
+        warnln("Consumer: Closing the ring didn't wake us up");
+        return 1;
+    }
+    if (!ring->is_empty()) {
+        warnln("Consumer: Bytes left over after the end of the stream");
+        return 1;
+    }
+    return 0;
+}
+
+static bool run_producer(IPC::SharedRing& ring)
+{
+    Vector<u8> chunk;
+    chunk.resize(1531);
+    size_t offset = 0;
+    for (size_t iteration = 0; offset < total_bytes; ++iteration) {
+        size_t size = min(chunk_size(iteration), total_bytes - offset);
+        for (size_t i = 0; i < size; ++i)
+            chunk[i] = pattern_byte(offset + i);
+        size_t written = 0;
+        while (written < size) {
+            auto count = ring.write(chunk.span().slice(written, size - written));
+            if (!count.has_value()) {
+                warnln("Producer: The ring is corrupted at offset {}", offset + written);
+                return false;
+            }
+            written += count.value();
+            if (count.value() != 0) {
+                // The consumer never goes idle here, so there is no socket to poke.
+                (void)ring.wake_consumer();
+                continue;
+            }
+            Core::ElapsedTimer timer;
+            timer.start();
+            ring.wait_for_space(wait_timeout_ms);
+            if (timed_out(timer)) {
+                warnln("Producer: Missed a wakeup at offset {}", offset + written);
+                return false;
+            }
+        }
+        offset += size;
+    }
+
+    // Give the consumer time to drain the ring and go to sleep before we close it.
+    while (!ring.is_empty())
+        usleep(1000);
+    usleep(100000);
+    ring.close();
+    return true;
+}
+
+int main(int, char**)
+{
+    auto ring = IPC::SharedRing::try_create(ring_capacity);
+    if (!ring) {
+        warnln("Couldn't create the ring");
+        return 1;
+    }
+
+    pid_t consumer_pid = fork();
+    if (consumer_pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (consumer_pid == 0)
+        _exit(run_consumer(ring->anonymous_buffer()));
+
+    bool success = run_producer(*ring);
+    if (!success)
+        ring->close();
+
+    int status = 0;
+    waitpid(consumer_pid, &status, 0);
+    if (!success || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("\x1b[01;35mTests failed\n");
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
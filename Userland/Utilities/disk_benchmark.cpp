@@ -59,11 +59,11 @@ static Result average_result(const Vector<Result>& results)
 
 static void exit_with_usage(int rc)
 {
-    warnln("Usage: disk_benchmark [-h] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]");
+    warnln("Usage: disk_benchmark [-h] [-c] [-r] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]");
     exit(rc);
 }
 
-static Optional<Result> benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache);
+static Optional<Result> benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache, bool random_access);
 
 int main(int argc, char** argv)
 {
@@ -72,9 +72,10 @@ int main(int argc, char** argv)
     Vector<size_t> file_sizes;
     Vector<size_t> block_sizes;
     bool allow_cache = false;
+    bool random_access = false;
 
     int opt;
-    while ((opt = getopt(argc, argv, "chd:t:f:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "chrd:t:f:b:")) != -1) {
         switch (opt) {
         case 'h':
             exit_with_usage(0);
@@ -82,6 +83,9 @@ int main(int argc, char** argv)
         case 'c':
             allow_cache = true;
             break;
+        case 'r':
+            random_access = true;
+            break;
         case 'd':
             directory = optarg;
             break;
@@ -118,13 +122,13 @@ int main(int argc, char** argv)
             auto buffer = ByteBuffer::create_uninitialized(block_size);
             Vector<Result> results;
 
-            outln("Running: file_size={} block_size={}", file_size, block_size);
+            outln("Running: file_size={} block_size={} access={}", file_size, block_size, random_access ? "random" : "sequential");
             Core::ElapsedTimer timer;
             timer.start();
             while (timer.elapsed() < time_per_benchmark * 1000) {
                 out(".");
                 fflush(stdout);
-                auto result = benchmark(filename, file_size, block_size, buffer, allow_cache);
+                auto result = benchmark(filename, file_size, block_size, buffer, allow_cache, random_access);
                 if (!result.has_value())
                     return 1;
                 results.append(result.release_value());
@@ -140,7 +144,7 @@ int main(int argc, char** argv)
     return 0;
 }
 
-Optional<Result> benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache)
+Optional<Result> benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache, bool random_access)
 {
     int flags = O_CREAT | O_TRUNC | O_RDWR;
     if (!allow_cache)
@@ -159,13 +163,40 @@ Optional<Result> benchmark(const String& filename, int file_size, int block_size
             perror("unlink");
     });
 
+    // In random mode, every block of the file is still visited exactly once, just in a shuffled order.
+    Vector<off_t> offsets;
+    for (off_t offset = 0; offset < file_size; offset += block_size)
+        offsets.append(offset);
+    if (random_access) {
+        if (offsets.size() >= 2) {
+            for (size_t i = offsets.size() - 1; i > 0; --i)
+                swap(offsets[i], offsets[arc4random_uniform(i + 1)]);
+        }
+
+        // Lay the file out first so that random reads and writes hit allocated blocks.
+        if (ftruncate(fd, file_size) < 0) {
+            perror("ftruncate");
+            return {};
+        }
+    }
+
+    auto seek_if_random = [&](off_t offset) {
+        if (random_access && lseek(fd, offset, SEEK_SET) < 0) {
+            perror("lseek");
+            return false;
+        }
+        return true;
+    };
+
     Result result;
 
     Core::ElapsedTimer timer;
     timer.start();
 
     ssize_t total_written = 0;
-    for (ssize_t j = 0; j < file_size; j += block_size) {
+    for (auto offset : offsets) {
+        if (!seek_if_random(offset))
+            return {};
         auto nwritten = write(fd, buffer.data(), block_size);
         if (nwritten < 0) {
             perror("write");
@@ -183,7 +214,9 @@ Optional<Result> benchmark(const String& filename, int file_size, int block_size
 
     timer.start();
     ssize_t total_read = 0;
-    while (total_read < file_size) {
+    for (auto offset : offsets) {
+        if (!seek_if_random(offset))
+            return {};
         auto nread = read(fd, buffer.data(), block_size);
         if (nread < 0) {
             perror("read");
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/NonnullRefPtrVector.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/ProcessStatisticsReader.h>
+#include <LibThread/Thread.h>
+#include <getopt.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct BenchmarkResult {
+    u64 yields_per_second {};
+    u64 switches_per_second {};
+};
+
+static void exit_with_usage(int rc)
+{
+    warnln("Usage: scheduler_benchmark [-h] [-t time_per_benchmark] [-n thread_count1,thread_count2,...]");
+    exit(rc);
+}
+
+static u64 total_times_scheduled()
+{
+    auto all_processes = Core::ProcessStatisticsReader::get_all();
+    if (!all_processes.has_value())
+        return 0;
+    auto it = all_processes.value().find(getpid());
+    if (it == all_processes.value().end())
+        return 0;
+    u64 total = 0;
+    for (auto& thread : it->value.threads)
+        total += thread.times_scheduled;
+    return total;
+}
+
+static BenchmarkResult benchmark(size_t thread_count, int time_per_benchmark)
+{
+    Atomic<bool> should_stop { false };
+    Atomic<u64> total_yields { 0 };
+
+    NonnullRefPtrVector<LibThread::Thread> threads;
+    for (size_t i = 0; i < thread_count; i++) {
+        threads.append(LibThread::Thread::construct([&] {
+            u64 yields = 0;
+            while (!should_stop.load(AK::MemoryOrder::memory_order_relaxed)) {
+                sched_yield();
+                ++yields;
+            }
+            total_yields += yields;
+            return 0;
+        }));
+    }
+
+    auto times_scheduled_before = total_times_scheduled();
+    Core::ElapsedTimer timer;
+    timer.start();
+    for (auto& thread : threads)
+        thread.start();
+
+    sleep(time_per_benchmark);
+    auto times_scheduled_after = total_times_scheduled();
+    should_stop = true;
+    for (auto& thread : threads)
+        [[maybe_unused]] auto res = thread.join();
+    auto elapsed = max(timer.elapsed(), 1);
+
+    BenchmarkResult result;
+    result.yields_per_second = total_yields.load() * 1000 / elapsed;
+    result.switches_per_second = (times_scheduled_after - times_scheduled_before) * 1000 / elapsed;
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int time_per_benchmark = 5;
+    Vector<size_t> thread_counts;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ht:n:")) != -1) {
+        switch (opt) {
+        case 'h':
+            exit_with_usage(0);
+            break;
+        case 't':
+            time_per_benchmark = atoi(optarg);
+            break;
+        case 'n':
+            for (const auto& count : String(optarg).split(','))
+                thread_counts.append(atoi(count.characters()));
+            break;
+        default:
+            exit_with_usage(1);
+        }
+    }
+
+    // NOTE: Run this with the same number of threads as there are processors
+    //       (e.g. 1, 2, 4 and 8 CPUs in QEMU) to see how scheduling scales.
+    if (thread_counts.is_empty())
+        thread_counts = { 1, 2, 4, 8 };
+
+    if (time_per_benchmark <= 0)
+        exit_with_usage(1);
+
+    for (auto thread_count : thread_counts) {
+        if (thread_count == 0)
+            continue;
+        outln("Running: threads={} time={}s", thread_count, time_per_benchmark);
+        auto result = benchmark(thread_count, time_per_benchmark);
+        outln("Finished: threads={} yields_per_second={} switches_per_second={}", thread_count, result.yields_per_second, result.switches_per_second);
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ByteBuffer.h>
+#include <AK/ScopeGuard.h>
+#include <AK/String.h>
+#include <AK/Types.h>
+#include <LibCore/ElapsedTimer.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Measures how fast a file can be pushed into a TCP socket over the loopback
+// interface, once by copying it through a userspace buffer like WebServer used
+// to, and once with sendfile().
+
+static void exit_with_usage(int rc)
+{
+    warnln("Usage: sendfile_benchmark [-h] [-d directory] [-f file_size] [-n iterations]");
+    exit(rc);
+}
+
+static int connect_to_sink(pid_t& sink_pid)
+{
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t address_length = sizeof(address);
+    if (bind(server_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(server_fd, 1) < 0
+        || getsockname(server_fd, (sockaddr*)&address, &address_length) < 0) {
+        perror("bind/listen");
+        return -1;
+    }
+
+    sink_pid = fork();
+    if (sink_pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (sink_pid == 0) {
+        // The sink just throws away everything it receives.
+        int fd = accept(server_fd, nullptr, nullptr);
+        char buffer[PAGE_SIZE];
+        while (read(fd, buffer, sizeof(buffer)) > 0)
+            ;
+        _exit(0);
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        return -1;
+    }
+    close(server_fd);
+    return fd;
+}
+
+static bool send_by_copying(int socket_fd, int file_fd, size_t file_size)
+{
+    char buffer[PAGE_SIZE];
+    size_t total_sent = 0;
+    while (total_sent < file_size) {
+        auto nread = pread(file_fd, buffer, sizeof(buffer), total_sent);
+        if (nread <= 0) {
+            perror("pread");
+            return false;
+        }
+        if (write(socket_fd, buffer, nread) != nread) {
+            perror("write");
+            return false;
+        }
+        total_sent += nread;
+    }
+    return true;
+}
+
+static bool send_with_sendfile(int socket_fd, int file_fd, size_t file_size)
+{
+    off_t offset = 0;
+    while ((size_t)offset < file_size) {
+        auto nsent = sendfile(socket_fd, file_fd, &offset, file_size - offset);
+        if (nsent <= 0) {
+            perror("sendfile");
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool run(const char* name, bool (*send_file)(int, int, size_t), int file_fd, size_t file_size, int iterations)
+{
+    pid_t sink_pid;
+    int socket_fd = connect_to_sink(sink_pid);
+    if (socket_fd < 0)
+        return false;
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        if (!send_file(socket_fd, file_fd, file_size))
+            return false;
+    }
+    auto elapsed_ms = max(timer.elapsed(), 1);
+
+    close(socket_fd);
+    waitpid(sink_pid, nullptr, 0);
+
+    u64 total_bytes = (u64)file_size * iterations;
+    outln("{}: {} bytes in {}ms, {} KiB/s", name, total_bytes, elapsed_ms, total_bytes * 1000 / elapsed_ms / KiB);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    String directory = "/tmp";
+    size_t file_size = 1 * MiB;
+    int iterations = 32;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hd:f:n:")) != -1) {
+        switch (opt) {
+        case 'h':
+            exit_with_usage(0);
+            break;
+        case 'd':
+            directory = optarg;
+            break;
+        case 'f':
+            file_size = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            exit_with_usage(1);
+        }
+    }
+
+    if (!file_size || iterations <= 0)
+        exit_with_usage(1);
+
+    auto filename = String::formatted("{}/sendfile_benchmark.tmp", directory);
+    int file_fd = open(filename.characters(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (file_fd < 0) {
+        perror("open");
+        return 1;
+    }
+    auto file_cleanup = ScopeGuard([&] {
+        close(file_fd);
+        unlink(filename.characters());
+    });
+
+    auto contents = ByteBuffer::create_zeroed(file_size);
+    for (size_t i = 0; i < file_size; ++i)
+        contents[i] = i;
+    if (write(file_fd, contents.data(), file_size) != (ssize_t)file_size) {
+        perror("write");
+        return 1;
+    }
+
+    // Don't let a sink that went away kill us, we'll see the write error instead.
+    signal(SIGPIPE, SIG_IGN);
+
+    outln("Sending a {} byte file {} times over the loopback interface", file_size, iterations);
+    if (!run("read+write", send_by_copying, file_fd, file_size, iterations))
+        return 1;
+    if (!run("sendfile", send_with_sendfile, file_fd, file_size, iterations))
+        return 1;
+    return 0;
+}